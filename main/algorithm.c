@@ -16,18 +16,41 @@
  */
 
 #include "algorithm.h"
+#include "board.h"
 #include "lower_bound.h"
+#include "probe_cache.h"
+#include "shapes.h"
 #include "timer.h"
 #include "upper_bound.h"
 #include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
+/*
+ * Nodes between time limit checks at most, so that a fractional time limit
+ * is met whatever the nodes between heartbeats
+ */
+#define TIMER_NODES 1000
 
 typedef struct {
   int lb;
   state_t *state;
+  board_t *board;
 } node_t;
 
+typedef struct {
+  long n_seen;  // number of nodes eligible for probing in this iteration
+  long n_tried; // number of probes in this iteration
+  long n_miss;  // number of probes in a row without improvement
+} probe_stat_t;
+
 typedef struct {
   int pri;
   int src;
@@ -35,9 +58,59 @@ typedef struct {
   int q_src;
   int q_dst;
   int child_lb;
+  int record; // record of the child if stored, or -1
   state_t *child_state;
+  board_t *child_board;
 } branch_t;
 
+enum {
+  CHECK_EA,
+  CHECK_TB,
+  CHECK_IB,
+  CHECK_SA,
+  CHECK_SB,
+  CHECK_SD,
+  CHECK_LB,
+  N_CHECKS
+};
+
+static const char *check_names[N_CHECKS] = {"EA", "TB", "IB", "SA",
+                                            "SB", "SD", "LB"};
+
+/*
+ * Sequences of the checks compiled into the search with the checks as
+ * constants: the order of the rules, and two with Rule 4 (IB) and lower
+ * bounding up front, which prune the most per cycle on the benchmark
+ * instances. Any other sequence is read from check_seq by the search of
+ * ORDER_SORTED.
+ */
+#define N_ORDERS 3
+#define ORDER_SORTED N_ORDERS
+static const int check_orders[N_ORDERS][N_CHECKS] = {
+    {CHECK_EA, CHECK_TB, CHECK_IB, CHECK_SA, CHECK_SB, CHECK_SD, CHECK_LB},
+    {CHECK_IB, CHECK_LB, CHECK_TB, CHECK_EA, CHECK_SA, CHECK_SB, CHECK_SD},
+    {CHECK_LB, CHECK_IB, CHECK_TB, CHECK_EA, CHECK_SA, CHECK_SB, CHECK_SD}};
+
+typedef struct {
+  long n_evals;    // number of evaluations during calibration
+  long n_fires;    // number of evaluations that pruned the branch
+  uint64_t cycles; // time stamp cycles spent, timing overhead included
+} check_stat_t;
+
+/*
+ * Node of best-first or fringe search, kept as its parent and the relocation
+ * from it, from which its state and the history of its path are replayed
+ */
+typedef struct {
+  int parent;    // record of the parent, or -1 for the root
+  int g;         // number of relocations from the root
+  int lb;        // lower bound of the state
+  int f;         // g plus lb at first, then the least f of the children not
+                 // stored yet
+  bool expanded; // true if the children below f are stored
+  move_t move;   // relocation from the parent
+} record_t;
+
 static int compare_branch(const void *a, const void *b) {
   branch_t *x = (branch_t *)a;
   branch_t *y = (branch_t *)b;
@@ -46,146 +119,926 @@ static int compare_branch(const void *a, const void *b) {
                                     : x->q_src - y->q_src;
 }
 
+typedef bool (*search_fn)(solver_t *solver, int level, branch_t *branches);
+
+struct solver {
+  /*
+   * Parameters
+   */
+  int n_stacks;
+  int n_tiers;
+  int max_prio;
+  int probe_policy;
+  int probe_threshold;
+  bool lazy_order;
+  int engine;
+  long max_records;
+  int log_level;
+  logger_t *logger;
+  progress_fn progress;
+  void *progress_data;
+  const search_fn *searches;
+  long calibration_nodes;
+  const char *check_profile;
+
+  /*
+   * Temporary variables, kept between runs and grown on demand
+   */
+  instance_t *ranked;              // instance with priorities by rank
+  int *prios;                      // priorities by rank minus one
+  bool is_ranked;                  // true if searching ranked
+  int max_depth_cap;               // capacity of the per-level variables
+  int probe_cache_size;            // requested size of probe_cache
+  state_t *root_state;             // for initialization
+  state_t *probe_state;            // for probing
+  state_t *probe_temp_state;       // for probing
+  move_t *probe_path;              // for probing
+  int *array_s1;                   // for lower bounding
+  int *min_last_change_left;       // for Rule 3 (TC)
+  int *max_last_move_out_right;    // for Rule 4 (IB)
+  int *max_group_src_temp;         // for Rules 10 (SC)
+  int *max_group_src_right;        // for Rule 10 (SC)
+  int *max_group_dst_right;        // for Rule 11 (SD)
+  int *group_dst_first;            // for Rule 11 (SD)
+  long *group_dst_stamp;           // for Rule 11 (SD)
+  int *group_dst_next;             // for Rule 11 (SD)
+  int *dsts;                       // for branch-and-bound
+  int *child_lbs;                  // for branch-and-bound on small bays
+  move_t *path;                    // for branch-and-bound
+  move_t *progress_sol;            // for reporting ranked progress
+  node_t *hist;                    // for branch-and-bound
+  state_t *temp_state;             // for branch-and-bound
+  branch_t *pool;                  // for branch-and-bound
+  probe_stat_t (*probe_stat)[2];   // for adaptive probing
+  probe_cache_t *probe_cache;      // for caching heuristic outcomes
+  bool use_board;                  // true if the bays fit in a board
+  board_t root_board;              // for branch-and-bound on small bays
+  board_t out_board;               // for branch-and-bound on small bays
+  board_t *board_pool;             // for branch-and-bound on small bays
+  state_t **trail;                 // for replaying stored nodes
+  int *path_records;               // for replaying and recording nodes
+  int *chain;                      // for replaying stored nodes
+  board_t trail_board;             // for replaying stored nodes
+  record_t *records;               // for best-first and fringe search
+  int *open;                       // for best-first and fringe search
+  int *fringe;                     // for fringe search
+  long records_cap;                // capacity of records, and of open and
+                                   // fringe, twice that in fringe search
+
+  /*
+   * Order of the dominance checks
+   */
+  search_fn search;                  // searches[check_order]
+  int check_order;                   // index into check_orders, or
+                                     // ORDER_SORTED
+  int check_seq[N_CHECKS];           // sequence of the checks by calibration
+  bool calibrating;                  // true while timing the checks
+  check_stat_t check_stat[N_CHECKS]; // per check, timed on every branch
+  uint64_t check_overhead;           // cycles of timing nothing
+
+  /*
+   * Best-first search
+   */
+  int bound;          // depth bound, which is best_lb unless storing children
+  int collect_level;  // level of the stored node being searched, or -1
+  int collect_parent; // record of the stored node being searched
+  int collect_min;    // least f of its children to store or search
+  bool storing;       // true to store its children rather than search them
+  bool recording;     // true to record nodes with children cut in open
+  int trail_depth;    // number of levels replayed and still valid
+  long n_records;     // number of stored nodes
+  long n_open;        // number of stored nodes in open
+  long n_fringe;      // number of stored nodes in fringe
+
+  /*
+   * Report
+   */
+  int best_lb;
+  int best_ub;
+  move_t *best_sol;
+  double start_time; // wall-clock time when the run started
+  double end_time;   // wall-clock deadline of the run
+  double time_to_best_lb;
+  double time_to_best_ub;
+  long n_nodes;
+  long n_probe;
+  long n_probe_skip;
+  long n_cache_lookup;
+  long n_cache_hit;
+
+  /*
+   * Timer
+   */
+  long n_timer;
+  long timer_cycle;
+  long n_beat;          // nodes since the last heartbeat
+  long heartbeat_nodes; // nodes between heartbeats
+};
+
+/*
+ * Progress events, of which the periodic "running" ones are only reported at
+ * LOG_PROGRESS
+ */
+static void debug_info(solver_t *solver, char *status) {
+  if (solver->log_level == LOG_QUIET ||
+      (solver->log_level == LOG_NORMAL && strcmp(status, "running") == 0)) {
+    return;
+  }
+
+  log_event_t event;
+  event.status = status;
+  event.best_lb = solver->best_lb;
+  event.best_ub = solver->best_ub;
+  event.time_to_best_lb = solver->time_to_best_lb - solver->start_time;
+  event.time_to_best_ub = solver->time_to_best_ub - solver->start_time;
+  event.time = get_wall_time() - solver->start_time;
+  event.n_nodes = solver->n_nodes;
+  event.n_probe = solver->n_probe;
+  event.n_probe_skip = solver->n_probe_skip;
+  event.n_cache_lookup = solver->n_cache_lookup;
+  event.n_cache_hit = solver->n_cache_hit;
+
+  if (solver->logger != NULL) {
+    log_event(solver->logger, &event);
+  } else {
+    print_event(stdout, &event);
+    fflush(stdout);
+  }
+}
+
+/*
+ * Priorities by rank
+ *
+ * The arrays of the search indexed by priority have one entry per cell of
+ * the bay, so priorities beyond the number of cells are searched by rank,
+ * from 1 to the number of distinct ones, and mapped back in the moves
+ * reported.
+ */
+static int compare_prio(const void *a, const void *b) {
+  int x = *(const int *)a;
+  int y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+static int rank_prio(solver_t *solver, int p) {
+  int *found = bsearch(&p, solver->prios, solver->ranked->max_prio,
+                       sizeof(int), compare_prio);
+  return found != NULL ? (int)(found - solver->prios) + 1 : 0;
+}
+
+static instance_t *rank_instance(solver_t *solver, instance_t *inst) {
+  instance_t *ranked = solver->ranked;
+  int *prios = solver->prios;
+  int n = 0;
+  for (int s = 0; s < inst->n_stacks; s++) {
+    for (int t = 1; t <= inst->h[s]; t++) {
+      prios[n++] = inst->p[s][t];
+    }
+  }
+  qsort(prios, n, sizeof(int), compare_prio);
+  int n_distinct = 0;
+  for (int i = 0; i < n; i++) {
+    if (n_distinct == 0 || prios[n_distinct - 1] != prios[i]) {
+      prios[n_distinct++] = prios[i];
+    }
+  }
+
+  ranked->n_blocks = inst->n_blocks;
+  ranked->max_prio = n_distinct;
+  for (int s = 0; s < inst->n_stacks; s++) {
+    ranked->h[s] = inst->h[s];
+    for (int t = 1; t <= inst->n_tiers; t++) {
+      ranked->p[s][t] = t <= inst->h[s] ? rank_prio(solver, inst->p[s][t]) : 0;
+    }
+  }
+  return ranked;
+}
+
+static void unrank_moves(solver_t *solver, move_t *dst, const move_t *src,
+                         int len) {
+  for (int i = 0; i < len; i++) {
+    dst[i] = src[i];
+    dst[i].p = solver->prios[src[i].p - 1];
+  }
+}
+
+/*
+ * Progress callback, which returns true if the search should stop
+ */
+static bool notify(solver_t *solver, int type) {
+  if (solver->progress == NULL) {
+    return false;
+  }
+
+  progress_t progress;
+  progress.type = type;
+  progress.best_lb = solver->best_lb;
+  progress.best_ub = solver->best_ub;
+  progress.best_sol = solver->best_sol;
+  if (solver->is_ranked) {
+    unrank_moves(solver, solver->progress_sol, solver->best_sol,
+                 solver->best_ub);
+    progress.best_sol = solver->progress_sol;
+  }
+  progress.time = get_wall_time() - solver->start_time;
+  progress.n_nodes = solver->n_nodes;
+  return solver->progress(&progress, solver->progress_data);
+}
+
 /*
- * Temporary variables
+ * Adaptive probing
+ *
+ * A heuristic is always tried at a new depth and on the first eligible child
+ * of a node. Once it has missed probe_threshold times in a row at a depth, it
+ * is only tried on every 2^(n_miss / probe_threshold)-th eligible node there.
  */
-static state_t *root_state;          // for initialization
-static state_t *probe_state;         // for probing
-static int *array_s1;                // for lower bounding
-static int *min_last_change_left;    // for Rule 3 (TC)
-static int *max_last_move_out_right; // for Rule 4 (IB)
-static int *max_group_src_temp;      // for Rules 10 (SC)
-static int *max_group_src_right;     // for Rule 10 (SC)
-static int *max_group_dst_right;     // for Rule 11 (SD)
-static move_t *path;                 // for branch-and-bound
-static node_t *hist;                 // for branch-and-bound
-static state_t *temp_state;          // for branch-and-bound
-static branch_t *pool;               // for branch-and-bound
+static bool to_probe(solver_t *solver, int depth, int k, bool first) {
+  probe_stat_t *stat = &solver->probe_stat[depth][k];
+  stat->n_seen++;
+  if (solver->probe_policy == PROBE_ALWAYS || first || stat->n_tried == 0 ||
+      stat->n_miss < solver->probe_threshold) {
+    return true;
+  }
+  long shift = stat->n_miss / solver->probe_threshold;
+  return stat->n_seen % (1L << (shift < 16 ? shift : 16)) == 0;
+}
+
+static void record_probe(solver_t *solver, int depth, int k, bool hit) {
+  probe_stat_t *stat = &solver->probe_stat[depth][k];
+  stat->n_tried++;
+  stat->n_miss = hit ? 0 : stat->n_miss + 1;
+}
 
 /*
- * Parameters
+ * Probe cache
+ *
+ * The heuristics are deterministic, so the number of moves they need from a
+ * state is fixed, and a run capped at cap moves either achieves it or proves
+ * it to be larger than cap.
+ */
+static void update_probe_entry(probe_entry_t *entry, int k, int len, int cap,
+                               int new_len) {
+  if (new_len != INT_MAX) {
+    entry->min_len[k] = new_len - len;
+    entry->exact[k] = true;
+  } else if (!entry->exact[k] && entry->min_len[k] <= cap) {
+    entry->min_len[k] = cap + 1;
+  }
+}
+
+/*
+ * Estimate of the lower bound of a child from that of its parent, by which
+ * lower bounding prunes a branch before the child is built
  */
-static int n_stacks;
-static int n_tiers;
-static int max_prio;
+static inline __attribute__((always_inline)) int
+estimate_lb(state_t *curr_state, int curr_lb, int pn, int q_sn, int q_dn) {
+  return curr_lb - (pn > q_sn) + (pn > q_dn) -
+         (curr_lb > curr_state->n_bad && (pn <= q_sn || pn > q_dn));
+}
+
+/*
+ * Dominance checks
+ *
+ * Rules 2 (TB), 4 (IB), 7 (EA), 8 (SA), 9 (SB) and 11 (SD) and lower bounding
+ * are pure filters on a branch, so any order of them prunes the same branches
+ * and only changes how fast. During the first calibration_nodes nodes, all of
+ * them are evaluated and timed on every branch, then the search switches to
+ * them sorted by prunes per cycle. A recorded profile skips the calibration.
+ */
+static inline __attribute__((always_inline)) bool
+check(solver_t *solver, int c, state_t *curr_state, int level, int curr_lb,
+      int sn, int dn, int pn, int q_sn, int q_dn, int lv, int s_empty,
+      bool has_group_dst) {
+  move_t *path = solver->path;
+  switch (c) {
+  case CHECK_EA:
+    /*
+     * Check Rule 7 (EA)
+     */
+    return curr_state->h[dn] == 0 &&
+           dn != s_empty; // EA: choose the leftmost empty stack
+
+  case CHECK_TB:
+    /*
+     * Check Rule 2 (TB)
+     */
+    return curr_state->last_change_time[dn] <
+           lv; // TB: merge two relocations and perform earlier
+
+  case CHECK_IB: {
+    /*
+     * Check Rule 4 (IB)
+     *
+     * if exists s' > s such that last_move_out_time[s'] >
+     * max{last_change_time[sn], last_change_time[dn]}
+     *
+     * max_last_move_out_right[s] = max{last_move_out_time[s'] | s' > s}
+     */
+    int max_last_move_out = solver->max_last_move_out_right[sn];
+    return curr_state->last_change_time[sn] < max_last_move_out &&
+           curr_state->last_change_time[dn] <
+               max_last_move_out; // IB: perform (pn, sn, dn) before (*, s', *)
+  }
+
+  case CHECK_SA: {
+    /*
+     * Check Rule 8 (SA)
+     */
+    int k = curr_state->last_change_time[dn];
+    return curr_state->last_change_type[dn] == MOVE_OUT &&
+           path[k - 1].p == pn &&
+           curr_state->last_change_time[sn] <
+               k; // SA: merge two relocations and perform earlier
+  }
+
+  case CHECK_SB: {
+    /*
+     * Check Rule 9 (SB)
+     */
+    int k = curr_state->last_change_time[dn];
+    return curr_state->last_change_type[dn] == MOVE_OUT &&
+           path[k - 1].p == pn &&
+           curr_state->last_change_time[path[k - 1].d] ==
+               k; // SB: merge two relocations and perform later
+  }
+
+  case CHECK_SD:
+    /*
+     * Check Rule 11 (SD)
+     *
+     * if exists k > last_change_time[dn] such that pk = pn && dk > dn &&
+     * last_change_type[dk] == MOVE_IN
+     *
+     * max_group_dst_right[d] = max{k | pk == pn && dk > d &&
+     * last_change_type[dk] == MOVE_IN}
+     */
+    return has_group_dst &&
+           curr_state->last_change_time[dn] <
+               solver->max_group_dst_right[dn]; // SD: swap destination stacks
+                                                // of two relocations
+
+  default:
+    /*
+     * Lower bounding
+     */
+    return level + 1 + estimate_lb(curr_state, curr_lb, pn, q_sn, q_dn) >
+           solver->bound;
+  }
+}
 
 /*
- * Report
+ * Check if a branch is pruned by lower bounding alone, and so cut rather than
+ * dominated
  */
-static int best_lb;
-static int best_ub;
-static move_t *best_sol;
-static double start_time;
-static double end_time;
-static double time_to_best_lb;
-static double time_to_best_ub;
-static long n_nodes;
-static long n_probe;
+static bool cut_by_bound(solver_t *solver, state_t *curr_state, int level,
+                         int curr_lb, int sn, int dn, int pn, int q_sn,
+                         int q_dn, int lv, int s_empty, bool has_group_dst) {
+  for (int c = 0; c < N_CHECKS; c++) {
+    if (c != CHECK_LB &&
+        check(solver, c, curr_state, level, curr_lb, sn, dn, pn, q_sn, q_dn,
+              lv, s_empty, has_group_dst)) {
+      return false;
+    }
+  }
+  return check(solver, CHECK_LB, curr_state, level, curr_lb, sn, dn, pn, q_sn,
+               q_dn, lv, s_empty, has_group_dst);
+}
 
 /*
- * Timer
+ * Time stamp counter, or 0 where there is none, in which case every check
+ * costs the same and they are ranked by prunes alone
  */
-static long n_timer;
-static long timer_cycle;
+static inline uint64_t read_cycles(void) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __asm__ __volatile__("" ::: "memory");
+  uint64_t cycles = __rdtsc();
+  __asm__ __volatile__("" ::: "memory");
+  return cycles;
+#else
+  return 0;
+#endif
+}
 
-static void debug_info(char *status) {
-  fprintf(stdout,
-          "[%s] best_lb = %d @ %.3f / best_ub = %d @ %.3f / time = %.3f / "
-          "nodes = %ld / probe = %ld\n",
-          status, best_lb, time_to_best_lb - start_time, best_ub,
-          time_to_best_ub - start_time, get_time() - start_time, n_nodes,
-          n_probe);
-  fflush(stdout);
+static bool check_all(solver_t *solver, state_t *curr_state, int level,
+                      int curr_lb, int sn, int dn, int pn, int q_sn, int q_dn,
+                      int lv, int s_empty, bool has_group_dst) {
+  bool pruned = false;
+  for (int c = 0; c < N_CHECKS; c++) {
+    uint64_t start = read_cycles();
+    bool fired = check(solver, c, curr_state, level, curr_lb, sn, dn, pn,
+                       q_sn, q_dn, lv, s_empty, has_group_dst);
+    uint64_t cycles = read_cycles() - start;
+    check_stat_t *stat = &solver->check_stat[c];
+    stat->n_evals++;
+    stat->n_fires += fired;
+    stat->cycles += cycles;
+    pruned |= fired;
+  }
+  uint64_t start = read_cycles();
+  solver->check_overhead += read_cycles() - start;
+  return pruned;
+}
+
+/*
+ * Sort the checks by the fraction of branches they prune per cycle, net of
+ * the timing overhead, which as if they fired independently minimizes the
+ * expected cycles per branch. A sequence compiled into check_orders keeps
+ * its checks as constants, any other one is searched by ORDER_SORTED.
+ */
+static int select_order(solver_t *solver) {
+  long n_evals = solver->check_stat[0].n_evals;
+  double overhead =
+      n_evals > 0 ? (double)solver->check_overhead / n_evals : 0;
+  double rate[N_CHECKS];
+  for (int c = 0; c < N_CHECKS; c++) {
+    check_stat_t *stat = &solver->check_stat[c];
+    rate[c] = 0;
+    if (stat->n_evals > 0) {
+      double cycles = (double)stat->cycles / stat->n_evals - overhead;
+      rate[c] = (double)stat->n_fires / stat->n_evals /
+                (cycles > 1 ? cycles : 1);
+    }
+  }
+
+  int *seq = solver->check_seq;
+  for (int i = 0; i < N_CHECKS; i++) {
+    int c = check_orders[0][i];
+    int j = i;
+    for (; j > 0 && rate[seq[j - 1]] < rate[c]; j--) {
+      seq[j] = seq[j - 1];
+    }
+    seq[j] = c;
+  }
+
+  for (int o = 0; o < N_ORDERS; o++) {
+    if (memcmp(seq, check_orders[o], sizeof(check_orders[o])) == 0) {
+      return o;
+    }
+  }
+  return ORDER_SORTED;
+}
+
+/*
+ * Check profile, one line "name n_evals n_fires cycles" per check, with the
+ * timing overhead under the name "--"
+ */
+static bool load_check_profile(solver_t *solver, const char *path) {
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    return false;
+  }
+
+  int n_loaded = 0;
+  char name[8];
+  long n_evals;
+  long n_fires;
+  unsigned long long cycles;
+  memset(solver->check_stat, 0, sizeof(solver->check_stat));
+  solver->check_overhead = 0;
+  while (fscanf(fp, "%7s %ld %ld %llu", name, &n_evals, &n_fires, &cycles) ==
+         4) {
+    if (strcmp(name, "--") == 0) {
+      solver->check_overhead = cycles;
+      continue;
+    }
+    for (int c = 0; c < N_CHECKS; c++) {
+      if (strcmp(name, check_names[c]) == 0) {
+        solver->check_stat[c].n_evals = n_evals;
+        solver->check_stat[c].n_fires = n_fires;
+        solver->check_stat[c].cycles = cycles;
+        n_loaded++;
+      }
+    }
+  }
+  fclose(fp);
+  return n_loaded == N_CHECKS;
+}
+
+/*
+ * Written to a temporary file first, so that concurrent solvers never read a
+ * partial profile
+ */
+static void save_check_profile(solver_t *solver, const char *path) {
+  size_t len = strlen(path) + 64;
+  char *temp = malloc(len);
+  snprintf(temp, len, "%s.%ld.%p.tmp", path, (long)getpid(), (void *)solver);
+  FILE *fp = fopen(temp, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "Cannot write check profile %s\n", temp);
+    free(temp);
+    return;
+  }
+  for (int c = 0; c < N_CHECKS; c++) {
+    check_stat_t *stat = &solver->check_stat[c];
+    fprintf(fp, "%s %ld %ld %llu\n", check_names[c], stat->n_evals,
+            stat->n_fires, (unsigned long long)stat->cycles);
+  }
+  fprintf(fp, "-- %ld 0 %llu\n", solver->check_stat[0].n_evals,
+          (unsigned long long)solver->check_overhead);
+  if (fclose(fp) != 0 || rename(temp, path) != 0) {
+    fprintf(stderr, "Cannot write check profile %s\n", path);
+    remove(temp);
+  }
+  free(temp);
+}
+
+static void finish_calibration(solver_t *solver) {
+  solver->calibrating = false;
+  solver->check_order = select_order(solver);
+  solver->search = solver->searches[solver->check_order];
+  if (solver->check_profile != NULL) {
+    save_check_profile(solver, solver->check_profile);
+  }
+}
+
+/*
+ * Open nodes of best-first search, a binary heap of records by f, then the
+ * deepest first, then the last stored, so that ties are broken depth-first
+ * as in an iteration of deepening
+ */
+static bool precedes_record(solver_t *solver, int a, int b) {
+  record_t *x = &solver->records[a];
+  record_t *y = &solver->records[b];
+  return x->f != y->f ? x->f < y->f : x->g != y->g ? x->g > y->g : a > b;
+}
+
+static void push_open(solver_t *solver, int index) {
+  int *open = solver->open;
+  long i = solver->n_open++;
+  while (i > 0 && precedes_record(solver, index, open[(i - 1) / 2])) {
+    open[i] = open[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  open[i] = index;
+}
+
+static int pop_open(solver_t *solver) {
+  int *open = solver->open;
+  int top = open[0];
+  int last = open[--solver->n_open];
+  long n = solver->n_open;
+  long i = 0;
+  for (long c = 1; c < n; i = c, c = 2 * c + 1) {
+    if (c + 1 < n && precedes_record(solver, open[c + 1], open[c])) {
+      c++;
+    }
+    if (!precedes_record(solver, open[c], last)) {
+      break;
+    }
+    open[i] = open[c];
+  }
+  if (n > 0) {
+    open[i] = last;
+  }
+  return top;
+}
+
+static int store_record(solver_t *solver, int parent, int g, int lb, int p,
+                        int s, int d) {
+  int index = (int)solver->n_records++;
+  record_t *record = &solver->records[index];
+  record->parent = parent;
+  record->g = g;
+  record->lb = lb;
+  record->f = g + lb;
+  record->expanded = false;
+  record->move.p = p;
+  record->move.s = s;
+  record->move.d = d;
+  return index;
+}
+
+/*
+ * Grow the records up to max_records, and return false if n do not fit
+ */
+static bool reserve_records(solver_t *solver, long n) {
+  if (n > solver->max_records) {
+    return false;
+  }
+  if (n > solver->records_cap) {
+    long cap = 2 * solver->records_cap > n ? 2 * solver->records_cap : n;
+    if (cap > solver->max_records) {
+      cap = solver->max_records;
+    }
+    record_t *records = realloc(solver->records, sizeof(record_t) * cap);
+    if (records == NULL) {
+      return false;
+    }
+    solver->records = records;
+    long n_entries = solver->engine == ENGINE_FRINGE ? 2 * cap : cap;
+    int *open = realloc(solver->open, sizeof(int) * n_entries);
+    if (open == NULL) {
+      return false;
+    }
+    solver->open = open;
+    if (solver->engine == ENGINE_FRINGE) {
+      int *fringe = realloc(solver->fringe, sizeof(int) * n_entries);
+      if (fringe == NULL) {
+        return false;
+      }
+      solver->fringe = fringe;
+    }
+    solver->records_cap = cap;
+  }
+  return true;
+}
+
+/*
+ * Children of a stored node not stored or searched yet, either stored last to
+ * first in the order of depth-first search, to be expanded in that order
+ * among ties, or kept in branches to be searched, returning how many are
+ *
+ * The others were stored when best-first search expanded the node, or
+ * searched when the last iteration of fringe search started from it, with
+ * the bound collect_min - 1. Those are the children of f below collect_min,
+ * except any that lower bounding pruned then by the estimate of its bound
+ * from the parent, before it was built. Such a child is kept, with f from its
+ * own bound, whether or not the estimate exceeded that bound.
+ */
+static int collect_children(solver_t *solver, int level, branch_t *branches,
+                            int size) {
+  state_t *curr_state = solver->hist[level].state;
+  int curr_lb = solver->hist[level].lb;
+  int n_kept = 0;
+  for (int i = 0; i < size; i++) {
+    if (level + 1 + branches[i].child_lb >= solver->collect_min ||
+        level + 1 +
+                estimate_lb(curr_state, curr_lb, branches[i].pri,
+                            branches[i].q_src, branches[i].q_dst) >=
+            solver->collect_min) {
+      branch_t temp = branches[n_kept]; // swapped to keep the pool intact
+      branches[n_kept++] = branches[i];
+      branches[i] = temp;
+    }
+  }
+  if (!solver->storing) {
+    return n_kept;
+  }
+  qsort(branches, n_kept, sizeof(branch_t), compare_branch);
+  for (int i = n_kept - 1; i >= 0; i--) {
+    push_open(solver, store_record(solver, solver->collect_parent, level + 1,
+                                   branches[i].child_lb, branches[i].pri,
+                                   branches[i].src, branches[i].dst));
+  }
+  return 0;
+}
+
+/*
+ * Probe a child with the heuristics, unless the probe cache or adaptive
+ * probing skips them, and return true if the search is to stop
+ */
+static bool probe_child(solver_t *solver, state_t *child_state, int depth,
+                        bool *first_probe) {
+  move_t *path = solver->path;
+
+  /*
+   * Skip heuristics known to fail under the current cap
+   */
+  int cap = solver->best_ub - 1 - depth;
+  probe_entry_t *entry = NULL;
+  bool need_jzw = true;
+  bool need_sm2 = true;
+  if (solver->probe_cache != NULL) {
+    solver->n_cache_lookup++;
+    entry = find_probe_entry(solver->probe_cache, hash_state(child_state));
+    need_jzw = entry->min_len[JZW] <= cap;
+    need_sm2 = entry->min_len[SM2] <= cap;
+    if (!need_jzw && !need_sm2) {
+      solver->n_cache_hit++;
+    }
+  }
+
+  bool run_jzw = false;
+  bool run_sm2 = false;
+  if (need_jzw || need_sm2) {
+    run_jzw = need_jzw && to_probe(solver, depth, JZW, *first_probe);
+    run_sm2 = need_sm2 && to_probe(solver, depth, SM2, *first_probe);
+    *first_probe = false;
+    if (!run_jzw && !run_sm2) {
+      solver->n_probe_skip++;
+    }
+  }
+
+  int new_len = INT_MAX;
+  int new_len_jzw = INT_MAX;
+  int new_len_sm2 = INT_MAX;
+  if (run_jzw || run_sm2) {
+    solver->n_probe++;
+    copy_state(solver->probe_state, child_state);
+    if (run_jzw && run_sm2) {
+      new_len = jzw_sm2(solver->probe_state, solver->probe_temp_state, path,
+                        solver->probe_path, depth, solver->best_ub - 1,
+                        &new_len_jzw, &new_len_sm2);
+    } else if (run_jzw) {
+      new_len = new_len_jzw =
+          jzw(solver->probe_state, path, depth, solver->best_ub - 1);
+    } else {
+      new_len = new_len_sm2 =
+          sm2(solver->probe_state, path, depth, solver->best_ub - 1);
+    }
+  }
+  if (run_jzw) {
+    record_probe(solver, depth, JZW, new_len_jzw != INT_MAX);
+    if (entry != NULL) {
+      update_probe_entry(entry, JZW, depth, cap, new_len_jzw);
+    }
+  }
+  if (run_sm2) {
+    record_probe(solver, depth, SM2, new_len_sm2 != INT_MAX);
+    if (entry != NULL) {
+      update_probe_entry(
+          entry, SM2, depth,
+          run_jzw && new_len_jzw != INT_MAX ? new_len_jzw - depth - 1 : cap,
+          new_len_sm2);
+    }
+  }
+
+  if (new_len != INT_MAX) {
+    solver->best_ub = new_len;
+    memcpy(solver->best_sol, path, sizeof(move_t) * solver->best_ub);
+    solver->time_to_best_ub = get_wall_time();
+    debug_info(solver, "update");
+    if (notify(solver, PROGRESS_UPDATE) || solver->best_lb == solver->best_ub) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Record a node of the depth-first search at a level, after the nodes above
+ * it not stored yet, in open as a node of the fringe of the next iteration,
+ * or stop recording once max_records is reached
+ */
+static void record_fringe(solver_t *solver, int level) {
+  int *path_records = solver->path_records;
+  int stored = level;
+  while (path_records[stored] == -1) {
+    stored--;
+  }
+  if (!reserve_records(solver, solver->n_records + level - stored)) {
+    solver->recording = false;
+    return;
+  }
+  for (int l = stored + 1; l <= level; l++) {
+    move_t *move = &solver->path[l - 1];
+    path_records[l] = store_record(solver, path_records[l - 1], l,
+                                   solver->hist[l].lb, move->p, move->s,
+                                   move->d);
+  }
+  solver->open[solver->n_open++] = path_records[level];
+}
+
+/*
+ * Record the children at the bound of a node of the depth-first search at a
+ * level, before its subtree, in open as nodes of the fringe to be probed
+ * only, as -1 - record, since iterative deepening probes them at the next
+ * bound when it expands the node, but fringe search searches them no more
+ */
+static void record_probes(solver_t *solver, int level, branch_t *branches,
+                          int size) {
+  int n_probes = 0;
+  for (int i = 0; i < size; i++) {
+    n_probes += level + 1 + branches[i].child_lb == solver->bound;
+  }
+  if (n_probes == 0) {
+    return;
+  }
+  int *path_records = solver->path_records;
+  int stored = level;
+  while (path_records[stored] == -1) {
+    stored--;
+  }
+  if (!reserve_records(solver, solver->n_records + level - stored + n_probes)) {
+    solver->recording = false;
+    return;
+  }
+  for (int l = stored + 1; l <= level; l++) {
+    move_t *move = &solver->path[l - 1];
+    path_records[l] = store_record(solver, path_records[l - 1], l,
+                                   solver->hist[l].lb, move->p, move->s,
+                                   move->d);
+  }
+  for (int i = 0; i < size; i++) {
+    if (level + 1 + branches[i].child_lb == solver->bound) {
+      branches[i].record = store_record(
+          solver, path_records[level], level + 1, branches[i].child_lb,
+          branches[i].pri, branches[i].src, branches[i].dst);
+      solver->open[solver->n_open++] = -1 - branches[i].record;
+    }
+  }
 }
 
 /*
  * Branch-and-bound
  */
-static bool search(int level, branch_t *branches) {
-  n_nodes++;
+static inline __attribute__((always_inline)) bool
+search_shape(solver_t *solver, int level, branch_t *branches, int n_stacks,
+             int n_tiers, int order) {
+  int max_prio = solver->max_prio;
+  move_t *path = solver->path;
+  node_t *hist = solver->hist;
+
+  solver->n_nodes++;
 
   /*
    * Check time limit
    */
-  if (++n_timer == timer_cycle) {
-    n_timer = 0;
-    if (get_time() >= end_time) {
+  if (++solver->n_timer == solver->timer_cycle) {
+    solver->n_timer = 0;
+    if (get_wall_time() >= solver->end_time) {
       return true;
     }
-    debug_info("running");
+    solver->n_beat += solver->timer_cycle;
+    if (solver->n_beat >= solver->heartbeat_nodes) {
+      solver->n_beat = 0;
+      if (notify(solver, PROGRESS_HEARTBEAT)) {
+        return true;
+      }
+      debug_info(solver, "running");
+    }
+  }
+  if (solver->calibrating && solver->n_nodes > solver->calibration_nodes) {
+    finish_calibration(solver);
   }
 
   /*
-   * Current state
+   * Current state, sorted now if lazy
    */
   int curr_lb = hist[level].lb;
   state_t *curr_state = hist[level].state;
+  order_stacks(curr_state);
 
   /*
-   * Prepare Rule 3 (TC)
+   * Prepare Rules 3 (TC), 4 (IB), 7 (EA), 10 (SC) and 11 (SD) and lower
+   * bounding in one pass, from the left for Rules 3, 7 and 11 and lower
+   * bounding, and from the right for Rules 4 and 10
    *
    * min_last_change_left[s] = min{last_change_time[s'] | s' < s && h[s'] <
    * n_tiers}
-   */
-  int min_last_change_temp = INT_MAX;
-  for (int s = 0; s < n_stacks; s++) {
-    min_last_change_left[s] = min_last_change_temp;
-    if (curr_state->h[s] < n_tiers &&
-        min_last_change_temp > curr_state->last_change_time[s]) {
-      min_last_change_temp = curr_state->last_change_time[s];
-    }
-  }
-
-  /*
-   * Prepare Rule 4 (IB)
    *
    * max_last_move_out_right[s] = max{last_move_out_time[s'] | s' > s}
-   */
-  int max_last_move_out_temp = 0;
-  for (int s = n_stacks - 1; s >= 0; s--) {
-    max_last_move_out_right[s] = max_last_move_out_temp;
-    if (max_last_move_out_temp < curr_state->last_move_out_time[s]) {
-      max_last_move_out_temp = curr_state->last_move_out_time[s];
-    }
-  }
-
-  /*
-   * Prepare Rule 10 (SC)
    *
    * max_group_src_right[s] = max{k | pk == p[s][h[s]] && sk > s &&
    * last_change_type[sk] == MOVE_OUT}
+   *
+   * group_dst_first[p] = rightmost d such that last_change_type[d] ==
+   * MOVE_IN and pk == p for k = last_change_time[d], and group_dst_next[d] =
+   * the next such d to its left, or -1; group_dst_first[p] is valid only if
+   * group_dst_stamp[p] is the number of the node
+   *
+   * s_max and s_sec = the stacks of the largest and second largest rank
+   * among those not full
+   *
+   * s_empty = the leftmost empty stack, or -1
    */
   int min_prio =
       curr_state->q[curr_state->list[0]][curr_state->h[curr_state->list[0]]];
-  memset(max_group_src_temp + min_prio + 1, 0,
+  memset(solver->max_group_src_temp + min_prio + 1, 0,
          sizeof(int) * (max_prio - min_prio));
-  for (int s = n_stacks - 1; s >= 0; s--) {
-    max_group_src_right[s] =
-        curr_state->h[s] == 0
-            ? 0
-            : max_group_src_temp[curr_state->p[s][curr_state->h[s]]];
-    if (curr_state->last_change_type[s] == MOVE_OUT) {
-      int k = curr_state->last_change_time[s];
-      int pk = path[k - 1].p;
-      if (pk > min_prio && max_group_src_temp[pk] < k) {
-        max_group_src_temp[pk] = k;
-      }
-    }
-  }
-
-  /*
-   * Prepare lower bounding
-   */
+  int min_last_change_temp = INT_MAX;
+  int max_last_move_out_temp = 0;
   int s_max = -1;
   int s_sec = -1;
-  for (int i = n_stacks - 1; i >= 0; i--) {
-    int s = curr_state->list[i];
+  int s_empty = -1;
+  for (int s = 0, r = n_stacks - 1; s < n_stacks; s++, r--) {
+    solver->min_last_change_left[s] = min_last_change_temp;
+    if (s_empty == -1 && curr_state->h[s] == 0) {
+      s_empty = s;
+    }
     if (curr_state->h[s] < n_tiers) {
-      if (s_max == -1) {
+      if (min_last_change_temp > curr_state->last_change_time[s]) {
+        min_last_change_temp = curr_state->last_change_time[s];
+      }
+      if (s_max == -1 || curr_state->rank[s_max] < curr_state->rank[s]) {
+        s_sec = s_max;
         s_max = s;
-      } else {
+      } else if (s_sec == -1 ||
+                 curr_state->rank[s_sec] < curr_state->rank[s]) {
         s_sec = s;
-        break;
+      }
+    }
+    if (curr_state->last_change_type[s] == MOVE_IN) {
+      int pk = path[curr_state->last_change_time[s] - 1].p;
+      bool grouped = solver->group_dst_stamp[pk] == solver->n_nodes;
+      solver->group_dst_next[s] = grouped ? solver->group_dst_first[pk] : -1;
+      solver->group_dst_first[pk] = s;
+      solver->group_dst_stamp[pk] = solver->n_nodes;
+    }
+
+    solver->max_last_move_out_right[r] = max_last_move_out_temp;
+    if (max_last_move_out_temp < curr_state->last_move_out_time[r]) {
+      max_last_move_out_temp = curr_state->last_move_out_time[r];
+    }
+    solver->max_group_src_right[r] =
+        curr_state->h[r] == 0
+            ? 0
+            : solver->max_group_src_temp[curr_state->p[r][curr_state->h[r]]];
+    if (curr_state->last_change_type[r] == MOVE_OUT) {
+      int k = curr_state->last_change_time[r];
+      int pk = path[k - 1].p;
+      if (pk > min_prio && solver->max_group_src_temp[pk] < k) {
+        solver->max_group_src_temp[pk] = k;
       }
     }
   }
@@ -194,11 +1047,13 @@ static bool search(int level, branch_t *branches) {
    * Prepare branching
    */
   int size = 0;
+  bool cut = false; // true if a child is pruned by the depth bound
 
   /*
    * Enumerate source stack
    */
   bool first_sn = true;
+  bool first_probe = true;
   for (int sn = 0; sn < n_stacks; sn++) {
     /*
      * Check feasibility
@@ -212,18 +1067,6 @@ static bool search(int level, branch_t *branches) {
     int q_sn = curr_state->q[sn][curr_state->h[sn]]; // quality value
     int lv = curr_state->l[sn][curr_state->h[sn]];   // last relocation time
 
-    /*
-     * Lower bounding
-     */
-    bool to_be_bad = pn > curr_state->q[s_max][curr_state->h[s_max]] ||
-                     (sn == s_max && s_sec != -1 &&
-                      pn > curr_state->q[s_sec][curr_state->h[s_sec]]);
-    if (level + 1 + curr_lb - (pn > q_sn) + to_be_bad -
-            (curr_lb > curr_state->n_bad && (pn <= q_sn || to_be_bad)) >
-        best_lb) {
-      continue;
-    }
-
     if (lv > 0) {
       int k = lv; // last time the block is relocated
       int sk = path[k - 1].s;
@@ -245,7 +1088,7 @@ static bool search(int level, branch_t *branches) {
      * min_last_change_left[s] = min{last_change_time[s'] | s' < s && h[s'] <
      * n_tiers}
      */
-    if (min_last_change_left[sn] < lv) {
+    if (solver->min_last_change_left[sn] < lv) {
       continue; // TC: choose alternative transitive stack
     }
 
@@ -258,132 +1101,157 @@ static bool search(int level, branch_t *branches) {
      * max_group_src_right[s] = max{k | pk == p[s][h[s]] && sk > s &&
      * last_change_type[sk] == MOVE_OUT}
      */
-    if (curr_state->last_change_time[sn] < max_group_src_right[sn]) {
+    if (curr_state->last_change_time[sn] < solver->max_group_src_right[sn]) {
       continue; // SC: swap source stacks of two relocations
     }
 
     /*
-     * Prepare Rule 11 (SD)
+     * Lower bounding, after Rules 1, 3 and 10, so that a node is recorded
+     * for its children cut rather than dominated
+     */
+    bool to_be_bad = pn > curr_state->q[s_max][curr_state->h[s_max]] ||
+                     (sn == s_max && s_sec != -1 &&
+                      pn > curr_state->q[s_sec][curr_state->h[s_sec]]);
+    if (level + 1 + curr_lb - (pn > q_sn) + to_be_bad -
+            (curr_lb > curr_state->n_bad && (pn <= q_sn || to_be_bad)) >
+        solver->bound) {
+      cut = true;
+      continue;
+    }
+
+    /*
+     * Prepare Rule 11 (SD), unless no relocation of a block of priority pn is
+     * the last change of its destination stack
      *
      * max_group_dst_right[d] = max{k | pk == pn && dk > d &&
      * last_change_type[dk] == MOVE_IN}
      */
-    int max_group_dst_temp = 0;
-    for (int d = n_stacks - 1; d >= 0; d--) {
-      max_group_dst_right[d] = max_group_dst_temp;
-      if (curr_state->last_change_type[d] == MOVE_IN) {
-        int k = curr_state->last_change_time[d];
-        int pk = path[k - 1].p;
-        if (pk == pn && max_group_dst_temp < k) {
-          max_group_dst_temp = k;
+    bool has_group_dst = solver->group_dst_stamp[pn] == solver->n_nodes;
+    if (has_group_dst) {
+      int group_dst = solver->group_dst_first[pn];
+      int max_group_dst_temp = 0;
+      for (int d = n_stacks - 1; d >= 0; d--) {
+        solver->max_group_dst_right[d] = max_group_dst_temp;
+        if (d == group_dst) {
+          int k = curr_state->last_change_time[d];
+          if (max_group_dst_temp < k) {
+            max_group_dst_temp = k;
+          }
+          group_dst = solver->group_dst_next[d];
         }
       }
     }
 
     /*
-     * Enumerate destination stack
+     * Filter destination stacks, up to the first one reaching the goal, which
+     * is reached below in the order of the branches before it
      */
-    bool first_dn = true;
-    bool first_empty = true;
-    for (int dn = 0; dn < n_stacks; dn++) {
+    int *dsts = solver->dsts;
+    int n_dsts = 0;
+    int goal_dn = -1;
+    for (int dn = next_stack(curr_state->not_full, 0, n_stacks); dn < n_stacks;
+         dn = next_stack(curr_state->not_full, dn + 1, n_stacks)) {
       /*
        * Check feasibility
        */
-      if (dn == sn || curr_state->h[dn] == n_tiers) {
+      if (dn == sn) {
         continue;
       }
 
-      /*
-       * Update path when generating branches
-       */
-      path[level].p = pn;
-      path[level].s = sn;
-      path[level].d = dn;
-
       /*
        * Goal test
        */
       int q_dn = curr_state->q[dn][curr_state->h[dn]];
       if (curr_state->n_bad - (pn > q_sn) + (pn > q_dn) == 0) {
-        best_ub = level + 1;
-        memcpy(best_sol, path, sizeof(move_t) * best_ub);
-        time_to_best_ub = get_time();
-        debug_info("goal");
-        return true;
+        goal_dn = dn;
+        dsts[n_dsts++] = dn;
+        break;
       }
 
       /*
-       * Check Rule 7 (EA)
+       * Dominance checks and lower bounding, unrolled into a fixed sequence
        */
-      if (curr_state->h[dn] == 0) {
-        if (first_empty) {
-          first_empty = false;
-        } else {
-          continue; // EA: choose the leftmost empty stack
-        }
+      bool pruned = false;
+      if (solver->calibrating) {
+        pruned = check_all(solver, curr_state, level, curr_lb, sn, dn, pn,
+                           q_sn, q_dn, lv, s_empty, has_group_dst);
+      } else {
+#define CHECK(i)                                                               \
+  check(solver,                                                                \
+        order == ORDER_SORTED ? solver->check_seq[i] : check_orders[order][i], \
+        curr_state, level, curr_lb, sn, dn, pn, q_sn, q_dn, lv, s_empty,       \
+        has_group_dst)
+        pruned = CHECK(0) || CHECK(1) || CHECK(2) || CHECK(3) || CHECK(4) ||
+                 CHECK(5) || CHECK(6);
+#undef CHECK
       }
-
-      /*
-       * Check Rule 2 (TB)
-       */
-      if (curr_state->last_change_time[dn] < lv) {
-        continue; // TB: merge two relocations and perform earlier
+      if (pruned) {
+        cut = cut || (solver->recording &&
+                      cut_by_bound(solver, curr_state, level, curr_lb, sn, dn,
+                                   pn, q_sn, q_dn, lv, s_empty, has_group_dst));
+        continue;
       }
+      dsts[n_dsts++] = dn;
+    }
 
-      /*
-       * Check Rule 4 (IB)
-       *
-       * if exists s' > s such that last_move_out_time[s'] >
-       * max{last_change_time[sn], last_change_time[dn]}
-       *
-       * max_last_move_out_right[s] = max{last_move_out_time[s'] | s' > s}
-       */
-      if (curr_state->last_change_time[sn] < max_last_move_out_right[sn] &&
-          curr_state->last_change_time[dn] < max_last_move_out_right[sn]) {
-        continue; // IB: perform (pn, sn, dn) before (*, s', *)
-      }
+    /*
+     * Child lower bounds on the board, of all the destination stacks left at
+     * once and before building any child
+     */
+    int n_bounded = n_dsts - (goal_dn != -1);
+    if (solver->use_board && n_bounded > 0) {
+      solver->out_board = *hist[level].board;
+      pop_board(&solver->out_board, sn);
+      lb_ts_board_children(&solver->out_board, pn, dsts, n_bounded,
+                           solver->bound - level, solver->child_lbs);
+    }
 
-      if (curr_state->last_change_type[dn] == MOVE_OUT) {
-        int k = curr_state->last_change_time[dn];
-        int pk = path[k - 1].p;
-        int dk = path[k - 1].d;
-        if (pk == pn) {
-          /*
-           * Check Rule 8 (SA)
-           */
-          if (curr_state->last_change_time[sn] < k) {
-            continue; // SA: merge two relocations and perform earlier
-          }
+    /*
+     * Enumerate destination stack
+     */
+    bool first_dn = true;
+    for (int i = 0; i < n_dsts; i++) {
+      int dn = dsts[i];
+      int q_dn = curr_state->q[dn][curr_state->h[dn]];
 
-          /*
-           * Check Rule 9 (SB)
-           */
-          if (curr_state->last_change_time[dk] == k) {
-            continue; // SB: merge two relocations and perform later
-          }
-        }
-      }
+      /*
+       * Update path when generating branches
+       */
+      path[level].p = pn;
+      path[level].s = sn;
+      path[level].d = dn;
 
       /*
-       * Check Rule 11 (SD)
-       *
-       * if exists k > last_change_time[dn] such that pk = pn && dk > dn &&
-       * last_change_type[dk] == MOVE_IN
-       *
-       * max_group_dst_right[d] = max{k | pk == pn && dk > d &&
-       * last_change_type[dk] == MOVE_IN}
+       * Goal
        */
-      if (curr_state->last_change_time[dn] < max_group_dst_right[dn]) {
-        continue; // SD: swap destination stacks of two relocations
+      if (dn == goal_dn) {
+        solver->best_ub = level + 1;
+        memcpy(solver->best_sol, path, sizeof(move_t) * solver->best_ub);
+        solver->time_to_best_ub = get_wall_time();
+        debug_info(solver, "goal");
+        notify(solver, PROGRESS_UPDATE);
+        return true;
       }
 
       /*
-       * Lower bounding
+       * Child lower bound on the board, before building the child, which is
+       * built anyway when recording, up to the first child cut rather than
+       * dominated
        */
-      if (level + 1 + curr_lb - (pn > q_sn) + (pn > q_dn) -
-              (curr_lb > curr_state->n_bad && (pn <= q_sn || pn > q_dn)) >
-          best_lb) {
-        continue;
+      int child_lb = 0;
+      bool over_bound = false;
+      if (solver->use_board) {
+        child_lb = solver->child_lbs[i];
+        over_bound = level + 1 + child_lb > solver->bound;
+        if (over_bound && (cut || !solver->recording)) {
+          continue;
+        }
+      }
+      if (solver->use_board && !over_bound) {
+        board_t *child_board = branches[size].child_board;
+        *child_board = solver->out_board;
+        push_board(child_board, dn, pn);
+        retrieve_board(child_board);
       }
 
       /*
@@ -395,12 +1263,12 @@ static bool search(int level, branch_t *branches) {
       }
       if (first_dn) {
         first_dn = false;
-        copy_state_head(temp_state, curr_state);
-        reuse_state_body(temp_state, hist[level + 1].state);
-        move_out(temp_state, sn, level + 1);
+        copy_state_head(solver->temp_state, curr_state);
+        reuse_state_body(solver->temp_state, hist[level + 1].state);
+        move_out(solver->temp_state, sn, level + 1);
       }
       state_t *child_state = branches[size].child_state;
-      copy_state_head(child_state, temp_state);
+      copy_state_head(child_state, solver->temp_state);
       reuse_state_body(child_state, hist[level + 1].state);
       move_in(child_state, dn, pn, level + 1);
 
@@ -409,7 +1277,7 @@ static bool search(int level, branch_t *branches) {
        */
       bool dominated = false;
       while (is_retrievable(child_state)) {
-        int s_min = child_state->list[0];
+        int s_min = first_stack(child_state);
         int p = child_state->p[s_min][child_state->h[s_min]];
         int l = child_state->l[s_min][child_state->h[s_min]];
 
@@ -454,45 +1322,26 @@ static bool search(int level, branch_t *branches) {
       /*
        * Child lower bound
        */
-      int child_lb =
-          lb_ts(child_state, best_lb - level - child_state->n_bad, array_s1);
+      if (!solver->use_board) {
+        child_lb =
+            lb_ts(child_state, solver->bound - level - child_state->n_bad,
+                  solver->array_s1);
+      }
 
       /*
        * Lower bounding
        */
-      if (level + 1 + child_lb > best_lb) {
+      if (over_bound || level + 1 + child_lb > solver->bound) {
+        cut = true;
         continue;
       }
 
       /*
        * Probing
        */
-      if (level + 1 + child_lb == best_lb - 1) {
-        n_probe++;
-
-        copy_state(probe_state, child_state);
-        int new_len_jzw = jzw(probe_state, path, level + 1, best_ub - 1);
-        if (new_len_jzw != INT_MAX) {
-          best_ub = new_len_jzw;
-          memcpy(best_sol, path, sizeof(move_t) * best_ub);
-          time_to_best_ub = get_time();
-          debug_info("update");
-          if (best_lb == best_ub) {
-            return true;
-          }
-        }
-
-        copy_state(probe_state, child_state);
-        int new_len_sm2 = sm2(probe_state, path, level + 1, best_ub - 1);
-        if (new_len_sm2 != INT_MAX) {
-          best_ub = new_len_sm2;
-          memcpy(best_sol, path, sizeof(move_t) * best_ub);
-          time_to_best_ub = get_time();
-          debug_info("update");
-          if (best_lb == best_ub) {
-            return true;
-          }
-        }
+      if (level + 1 + child_lb == solver->bound - 1 &&
+          probe_child(solver, child_state, level + 1, &first_probe)) {
+        return true;
       }
 
       /*
@@ -504,13 +1353,20 @@ static bool search(int level, branch_t *branches) {
       branches[size].q_src = q_sn;
       branches[size].q_dst = q_dn;
       branches[size].child_lb = child_lb;
+      branches[size].record = -1;
       size++;
     }
   }
 
   /*
-   * Depth-first search
+   * Depth-first search, after collecting the children of a stored node
    */
+  if (size > 0 && level == solver->collect_level) {
+    size = collect_children(solver, level, branches, size);
+  }
+  if (size > 0 && solver->recording) {
+    record_probes(solver, level, branches, size);
+  }
   if (size > 0) {
     qsort(branches, size, sizeof(branch_t), compare_branch);
 
@@ -520,6 +1376,8 @@ static bool search(int level, branch_t *branches) {
       path[level].d = branches[i].dst;
 
       hist[level + 1].lb = branches[i].child_lb;
+      hist[level + 1].board = branches[i].child_board;
+      solver->path_records[level + 1] = branches[i].record;
       reuse_state_head(hist[level + 1].state, branches[i].child_state);
 
       int dn = path[level].d;
@@ -528,149 +1386,733 @@ static bool search(int level, branch_t *branches) {
                     path[level].p, level + 1);
       }
 
-      if (search(level + 1, branches + size)) {
+      if (solver->search(solver, level + 1, branches + size)) {
         return true;
       }
     }
   }
 
+  /*
+   * Record the node for the next iteration if it has children cut, after
+   * its subtree, so that the next iteration follows the order of this one
+   */
+  if (cut && solver->recording) {
+    record_fringe(solver, level);
+  }
+  return false;
+}
+
+/*
+ * Branch-and-bound for any shape of bays, and for each shape of SEARCH_SHAPES
+ * with the numbers of stacks and tiers as constants, each in every sequence of
+ * check_orders and in the sorted one
+ */
+#define DEFINE_SEARCH_ORDER(name, S, T, O)                                     \
+  static bool name##_##O(solver_t *solver, int level, branch_t *branches) {    \
+    return search_shape(solver, level, branches, S, T, O);                     \
+  }
+#define DEFINE_SEARCH_ORDERS(name, S, T)                                       \
+  DEFINE_SEARCH_ORDER(name, S, T, 0)                                           \
+  DEFINE_SEARCH_ORDER(name, S, T, 1)                                           \
+  DEFINE_SEARCH_ORDER(name, S, T, 2)                                           \
+  DEFINE_SEARCH_ORDER(name, S, T, 3)                                           \
+  static const search_fn name[N_ORDERS + 1] = {name##_0, name##_1, name##_2,  \
+                                               name##_3};
+DEFINE_SEARCH_ORDERS(search_any, solver->n_stacks, solver->n_tiers)
+#define DEFINE_SEARCH(S, T) DEFINE_SEARCH_ORDERS(search_##S##x##T, S, T)
+SEARCH_SHAPES(DEFINE_SEARCH)
+
+static const search_fn *select_search(int n_stacks, int n_tiers) {
+#define MATCH_SEARCH(S, T)                                                     \
+  if (n_stacks == S && n_tiers == T) {                                         \
+    return search_##S##x##T;                                                   \
+  }
+  SEARCH_SHAPES(MATCH_SEARCH)
+  (void)n_stacks; // unused if no shape is configured
+  (void)n_tiers;
+  return search_any;
+}
+
+static bool deepen(solver_t *solver, int best_lb) {
+  solver->best_lb = best_lb;
+  solver->time_to_best_lb = get_wall_time();
+  debug_info(solver, "deepen");
+  return notify(solver, PROGRESS_DEEPEN) ||
+         (best_lb < solver->best_ub &&
+          solver->time_to_best_lb >= solver->end_time);
+}
+
+/*
+ * Best-first search
+ *
+ * Nodes are expanded in the order of g plus the lower bound, so the tree
+ * above each value of the lower bound is expanded once rather than once per
+ * iteration of deepening. The expansion is partial: with the depth bound at
+ * f of the node, only the children of that f are built and stored, as in an
+ * iteration of deepening, and the node goes back to open with f + 1 for the
+ * others. A node is replayed from the root before it is expanded, rebuilding
+ * the history of its path on which Rules 1 to 11 depend, so all of them
+ * still apply; for the same reason, a state reached by two paths is kept
+ * twice. Once the stored nodes fill max_records, the subtree of each open
+ * node is searched by iterative deepening instead.
+ */
+static int replay_record(solver_t *solver, int index) {
+  record_t *records = solver->records;
+  node_t *hist = solver->hist;
+  int g = records[index].g;
+  for (int i = index; i != -1; i = records[i].parent) {
+    solver->chain[records[i].g] = i;
+  }
+
+  /*
+   * Keep the levels shared with the node replayed last
+   */
+  solver->path_records[0] = solver->chain[0];
+  int level = 1;
+  while (level <= g && level <= solver->trail_depth &&
+         solver->path_records[level] == solver->chain[level]) {
+    level++;
+  }
+  for (; level <= g; level++) {
+    move_t *move = &records[solver->chain[level]].move;
+    state_t *head = solver->trail[level];
+    solver->path[level - 1] = *move;
+    copy_state_body(hist[level].state, hist[level - 1].state);
+    copy_state_head(head, hist[level - 1].state);
+    reuse_state_body(head, hist[level].state);
+    relocate(head, move->s, move->d, level);
+    while (is_retrievable(head)) {
+      retrieve(head, level);
+    }
+    reuse_state_head(hist[level].state, head);
+    solver->path_records[level] = solver->chain[level];
+  }
+  solver->trail_depth = g;
+
+  hist[g].lb = records[index].lb;
+  if (solver->use_board && g > 0) {
+    load_board(&solver->trail_board, hist[g].state, solver->max_prio);
+    hist[g].board = &solver->trail_board;
+  }
+  return g;
+}
+
+/*
+ * Iterative deepening over the subtrees of the open nodes, taken in the
+ * order of the heap, which is sorted in place first
+ */
+static bool search_open(solver_t *solver) {
+  long n_open = solver->n_open;
+  while (solver->n_open > 0) {
+    int index = pop_open(solver);
+    solver->open[solver->n_open] = index;
+  }
+  while (solver->best_lb < solver->best_ub) {
+    memset(solver->probe_stat, 0,
+           sizeof(probe_stat_t[2]) * (solver->max_depth_cap + 1));
+    for (long i = n_open - 1; i >= 0; i--) {
+      int index = solver->open[i];
+      record_t *record = &solver->records[index];
+      if (record->f > solver->best_lb) {
+        break;
+      }
+      int level = replay_record(solver, index);
+      solver->bound = solver->best_lb;
+      solver->collect_level = level;
+      solver->collect_min = record->expanded ? record->f : 0;
+      solver->storing = false;
+      bool stop = solver->search(solver, level, solver->pool);
+      solver->collect_level = -1;
+      solver->trail_depth = level;
+      if (stop) {
+        return solver->best_lb < solver->best_ub;
+      }
+    }
+    if (deepen(solver, solver->best_lb + 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Fringe search
+ *
+ * Iterative deepening in which an iteration records each node with children
+ * cut by the bound, after its subtree, and the next iteration restarts from
+ * those nodes, in the order recorded, instead of from the root, so that it
+ * follows the depth-first order of the last one. From each one, only the
+ * children beyond the previous bound are searched: the others were searched
+ * in full then, and those of their descendants with children cut are in the
+ * fringe too, as collect_children argues. A node is recorded only for
+ * children cut by the bound, not for those dominated, which no iteration
+ * searches. Once the stored nodes fill max_records, the iterations after
+ * the one that fills them start from the root again.
+ *
+ * Return true if stopped by the time limit or the progress callback
+ */
+static bool fringe_search(solver_t *solver) {
+  solver->n_records = 0;
+  solver->n_fringe = 0;
+  solver->trail_depth = 0;
+  if (!reserve_records(solver, 1)) {
+    return false;
+  }
+  solver->fringe[solver->n_fringe++] =
+      store_record(solver, -1, 0, solver->best_lb, 0, 0, 0);
+
+  int collect_min = 0;
+  while (solver->best_lb < solver->best_ub) {
+    memset(solver->probe_stat, 0,
+           sizeof(probe_stat_t[2]) * (solver->max_depth_cap + 1));
+    solver->n_open = 0;
+    solver->recording = true;
+    for (long i = 0; i < solver->n_fringe; i++) {
+      int index = solver->fringe[i];
+      bool to_probe = index < 0;
+      int level = replay_record(solver, to_probe ? -1 - index : index);
+      solver->bound = solver->best_lb;
+      bool stop;
+      if (to_probe) {
+        bool first_probe = false;
+        stop = probe_child(solver, solver->hist[level].state, level,
+                           &first_probe);
+      } else {
+        solver->collect_level = level;
+        solver->collect_min = collect_min;
+        solver->storing = false;
+        stop = solver->search(solver, level, solver->pool);
+      }
+      solver->collect_level = -1;
+      solver->trail_depth = level;
+      if (stop) {
+        solver->recording = false;
+        return solver->best_lb < solver->best_ub;
+      }
+    }
+
+    /*
+     * The nodes recorded are the fringe of the next iteration, if complete
+     */
+    bool complete = solver->recording;
+    solver->recording = false;
+    int *fringe = solver->fringe;
+    solver->fringe = solver->open;
+    solver->open = fringe;
+    solver->n_fringe = solver->n_open;
+    collect_min = solver->best_lb + 1;
+    if (deepen(solver, solver->best_lb + 1)) {
+      return true;
+    }
+    if (!complete) {
+      return false;
+    }
+  }
   return false;
 }
 
-report_t *solve(instance_t *inst, int _t) {
+/*
+ * Return true if stopped by the time limit or the progress callback
+ */
+static bool best_first(solver_t *solver) {
+  int n_children = solver->n_stacks * (solver->n_stacks - 1);
+  solver->n_records = 0;
+  solver->n_open = 0;
+  solver->trail_depth = 0;
+  memset(solver->probe_stat, 0,
+         sizeof(probe_stat_t[2]) * (solver->max_depth_cap + 1));
+  if (!reserve_records(solver, 1 + n_children)) {
+    return false; // too little memory, so iterative deepening from the root
+  }
+  push_open(solver, store_record(solver, -1, 0, solver->best_lb, 0, 0, 0));
+
+  while (solver->n_open > 0) {
+    int index = solver->open[0];
+    int f = solver->records[index].f;
+    if (f >= solver->best_ub) {
+      break;
+    }
+    if (f > solver->best_lb && deepen(solver, f)) {
+      return true;
+    }
+    if (!reserve_records(solver, solver->n_records + n_children)) {
+      return search_open(solver);
+    }
+    pop_open(solver);
+
+    /*
+     * Probe the node when it is expanded with the bound one above its own f,
+     * as iterative deepening probes it when it reaches it with that bound
+     */
+    int level = replay_record(solver, index);
+    record_t *record = &solver->records[index];
+    if (record->parent != -1 && f == record->g + record->lb + 1) {
+      bool first_probe = false;
+      if (probe_child(solver, solver->hist[level].state, level,
+                      &first_probe)) {
+        return solver->best_lb < solver->best_ub;
+      }
+      if (f >= solver->best_ub) {
+        break;
+      }
+    }
+
+    /*
+     * Expand the node, storing its children of f up to that of the node. A
+     * goal among them is optimal, since f of the node is the best lower
+     * bound.
+     */
+    solver->bound = f;
+    solver->collect_level = level;
+    solver->collect_parent = index;
+    solver->collect_min = solver->records[index].expanded ? f : 0;
+    solver->storing = true;
+    bool stop = solver->search(solver, level, solver->pool);
+    solver->collect_level = -1;
+    solver->trail_depth = level;
+    if (stop) {
+      return solver->best_lb < solver->best_ub;
+    }
+    if (f + 1 < solver->best_ub) {
+      solver->records[index].f = f + 1;
+      solver->records[index].expanded = true;
+      push_open(solver, index);
+    }
+  }
+  return solver->best_lb < solver->best_ub &&
+         deepen(solver, solver->best_ub);
+}
+
+
+/*
+ * Per-level variables, which depend on the maximum depth of the search
+ */
+static void free_levels(solver_t *solver) {
+  for (int i = 1; i <= solver->max_depth_cap; i++) {
+    free_state(solver->hist[i].state);
+  }
+  int n_branches =
+      solver->max_depth_cap * solver->n_stacks * (solver->n_stacks - 1);
+  for (int i = 0; i < n_branches; i++) {
+    free_state(solver->pool[i].child_state);
+  }
+  for (int i = 1; i <= solver->max_depth_cap; i++) {
+    free_state(solver->trail[i]);
+  }
+  free(solver->trail);
+  free(solver->path_records);
+  free(solver->chain);
+  free(solver->probe_path);
+  free(solver->path);
+  free(solver->progress_sol);
+  free(solver->hist);
+  free(solver->probe_stat);
+  free(solver->pool);
+  free(solver->board_pool);
+}
+
+static void reserve_levels(solver_t *solver, int max_depth) {
+  if (max_depth <= solver->max_depth_cap) {
+    return;
+  }
+  free_levels(solver);
+
+  int n_stacks = solver->n_stacks;
+  int n_tiers = solver->n_tiers;
+  solver->max_depth_cap = max_depth;
+  solver->probe_path = malloc(sizeof(move_t) * max_depth);
+  solver->path = malloc(sizeof(move_t) * max_depth);
+  solver->progress_sol = malloc(sizeof(move_t) * max_depth);
+  solver->hist = malloc(sizeof(node_t) * (max_depth + 1));
+  for (int i = 1; i <= max_depth; i++) {
+    solver->hist[i].state = malloc_state(n_stacks, n_tiers, false, true, true);
+  }
+  solver->probe_stat = malloc(sizeof(probe_stat_t[2]) * (max_depth + 1));
+  int n_branches = max_depth * n_stacks * (n_stacks - 1);
+  solver->pool = malloc(sizeof(branch_t) * n_branches);
+  for (int i = 0; i < n_branches; i++) {
+    solver->pool[i].child_state =
+        malloc_state(n_stacks, n_tiers, true, false, true);
+  }
+  solver->board_pool = NULL;
+  if (n_stacks <= BOARD_STACKS && n_tiers <= BOARD_TIERS) {
+    solver->board_pool = malloc(sizeof(board_t) * n_branches);
+  }
+  for (int i = 0; i < n_branches; i++) {
+    solver->pool[i].child_board =
+        solver->board_pool != NULL ? solver->board_pool + i : NULL;
+  }
+  solver->trail = malloc(sizeof(state_t *) * (max_depth + 1));
+  for (int i = 1; i <= max_depth; i++) {
+    solver->trail[i] = malloc_state(n_stacks, n_tiers, true, false, true);
+  }
+  solver->path_records = malloc(sizeof(int) * (max_depth + 1));
+  solver->chain = malloc(sizeof(int) * (max_depth + 1));
+}
+
+solver_t *malloc_solver(int n_stacks, int n_tiers) {
+  solver_t *solver = malloc(sizeof(solver_t));
+  solver->n_stacks = n_stacks;
+  solver->n_tiers = n_tiers;
+
+  solver->root_state = malloc_state(n_stacks, n_tiers, true, true, true);
+  solver->probe_state = malloc_state(n_stacks, n_tiers, true, true, false);
+  solver->probe_temp_state = malloc_state(n_stacks, n_tiers, true, true, false);
+  solver->array_s1 = malloc(sizeof(int) * lb_ts_temp_size(n_stacks));
+  solver->min_last_change_left = malloc(sizeof(int) * n_stacks);
+  solver->max_last_move_out_right = malloc(sizeof(int) * n_stacks);
+  solver->max_group_src_right = malloc(sizeof(int) * n_stacks);
+  solver->max_group_dst_right = malloc(sizeof(int) * n_stacks);
+  solver->group_dst_next = malloc(sizeof(int) * n_stacks);
+  solver->dsts = malloc(sizeof(int) * n_stacks);
+  solver->child_lbs = malloc(sizeof(int) * n_stacks);
+  solver->temp_state = malloc_state(n_stacks, n_tiers, true, false, true);
+
+  solver->max_depth_cap = 0;
+  solver->probe_path = NULL;
+  solver->path = NULL;
+  solver->progress_sol = NULL;
+  solver->hist = NULL;
+  solver->probe_stat = NULL;
+  solver->pool = NULL;
+  solver->board_pool = NULL;
+  solver->trail = NULL;
+  solver->path_records = NULL;
+  solver->chain = NULL;
+  solver->records = NULL;
+  solver->open = NULL;
+  solver->fringe = NULL;
+  solver->records_cap = 0;
+  solver->probe_cache_size = 0;
+  solver->probe_cache = NULL;
+
+  /*
+   * Arrays by priority, one entry per cell and the ground
+   */
+  size_t n_cells = (size_t)n_stacks * n_tiers;
+  solver->ranked = malloc_instance(n_stacks, n_tiers);
+  solver->prios = malloc(sizeof(int) * n_cells);
+  solver->max_group_src_temp = malloc(sizeof(int) * (n_cells + 1));
+  solver->group_dst_first = malloc(sizeof(int) * (n_cells + 1));
+  solver->group_dst_stamp = malloc(sizeof(long) * (n_cells + 1));
+  if (solver->ranked == NULL || solver->prios == NULL ||
+      solver->max_group_src_temp == NULL || solver->group_dst_first == NULL ||
+      solver->group_dst_stamp == NULL) {
+    free_solver(solver);
+    return NULL;
+  }
+  return solver;
+}
+
+void free_solver(solver_t *solver) {
+  free_state(solver->root_state);
+  free_state(solver->probe_state);
+  free_state(solver->probe_temp_state);
+  free(solver->array_s1);
+  free(solver->min_last_change_left);
+  free(solver->max_last_move_out_right);
+  free(solver->max_group_src_right);
+  free(solver->max_group_dst_right);
+  free(solver->group_dst_next);
+  free(solver->dsts);
+  free(solver->child_lbs);
+  free_state(solver->temp_state);
+  free(solver->max_group_src_temp);
+  free(solver->group_dst_first);
+  free(solver->group_dst_stamp);
+  if (solver->ranked != NULL) {
+    free_instance(solver->ranked);
+  }
+  free(solver->prios);
+  free_levels(solver);
+  free(solver->records);
+  free(solver->open);
+  free(solver->fringe);
+  if (solver->probe_cache != NULL) {
+    free_probe_cache(solver->probe_cache);
+  }
+  free(solver);
+}
+
+report_t *run_solver(solver_t *solver, instance_t *inst, param_t *param) {
+  /*
+   * Instance searched, by rank if its priorities exceed the cells
+   */
+  solver->is_ranked =
+      (size_t)inst->max_prio > (size_t)solver->n_stacks * solver->n_tiers;
+  if (solver->is_ranked) {
+    inst = rank_instance(solver, inst);
+  }
+
   /*
    * Parameters
    */
-  n_stacks = inst->n_stacks;
-  n_tiers = inst->n_tiers;
-  max_prio = inst->max_prio;
-  start_time = get_time();
-  end_time = start_time + _t;
+  solver->max_prio = inst->max_prio;
+  solver->use_board =
+      fits_board(solver->n_stacks, solver->n_tiers, inst->max_prio);
+  solver->probe_policy = param->probe_policy;
+  solver->probe_threshold =
+      param->probe_threshold > 0 ? param->probe_threshold : 1;
+  solver->lazy_order = param->lazy_order;
+  solver->engine = param->engine;
+  size_t record_size = sizeof(record_t) + sizeof(int); // and its place in open
+  if (param->engine == ENGINE_FRINGE) {
+    record_size += 3 * sizeof(int); // and in fringe, each also to be probed
+  }
+  solver->max_records = (long)param->node_memory * (1 << 20) / record_size;
+  if (solver->max_records > INT_MAX) {
+    solver->max_records = INT_MAX;
+  }
+  solver->log_level = param->log_level;
+  solver->logger = param->logger;
+  solver->progress = param->progress;
+  solver->progress_data = param->progress_data;
+  solver->searches = param->specialized
+                         ? select_search(solver->n_stacks, solver->n_tiers)
+                         : search_any;
+  solver->start_time = get_wall_time();
+  solver->end_time = solver->start_time + param->time_limit;
+  double start_time = solver->start_time;
 
   /*
    * Root state
    */
-  root_state = malloc_state(n_stacks, n_tiers, true, true, true);
+  state_t *root_state = solver->root_state;
+  state_t *probe_state = solver->probe_state;
   init_state(root_state, inst);
   while (is_retrievable(root_state)) {
     retrieve(root_state, 0);
   }
   if (root_state->n_blocks == 0) {
-    free_state(root_state);
-    return new_report(0, 0, 0, 0, NULL, 0, 0, 0, 0, 0);
+    return new_report(0, 0, 0, 0, NULL, 0, 0, 0, 0, 0, 0, 0, 0);
   }
 
   /*
-   * Check if there is a solution
+   * Start from the given incumbent if it solves the instance
    */
-  probe_state = malloc_state(n_stacks, n_tiers, true, true, false);
-  copy_state(probe_state, root_state);
-  int init_len_jzw = jzw(probe_state, NULL, 0, INT_MAX);
-  copy_state(probe_state, root_state);
-  int init_len_sm2 = sm2(probe_state, NULL, 0, INT_MAX);
-  int max_depth = init_len_jzw < init_len_sm2 ? init_len_jzw : init_len_sm2;
-  if (max_depth == INT_MAX) {
-    free_state(root_state);
-    free_state(probe_state);
-    return NULL;
+  int max_depth = INT_MAX;
+  move_t *best_sol = NULL;
+  if (param->initial_sol != NULL) {
+    int len = param->initial_len > 0 ? param->initial_len : 0;
+    best_sol = malloc(sizeof(move_t) * (len > 0 ? len : 1));
+    if (best_sol == NULL) {
+      fprintf(stderr, "Cannot allocate the solution\n");
+      return NULL;
+    }
+    memcpy(best_sol, param->initial_sol, sizeof(move_t) * len);
+    for (int i = 0; solver->is_ranked && i < len; i++) {
+      best_sol[i].p = rank_prio(solver, best_sol[i].p);
+    }
+    copy_state(probe_state, root_state);
+    if (replay_moves(probe_state, best_sol, len) == len &&
+        probe_state->n_blocks == 0) {
+      max_depth = len;
+    } else {
+      fprintf(stderr, "Ignored initial solution that does not solve the "
+                      "instance\n");
+      free(best_sol);
+      best_sol = NULL;
+    }
+  }
+
+  if (best_sol == NULL) {
+    /*
+     * Check if there is a solution
+     */
+    copy_state(probe_state, root_state);
+    int init_len_jzw = jzw(probe_state, NULL, 0, INT_MAX);
+    copy_state(probe_state, root_state);
+    int init_len_sm2 = sm2(probe_state, NULL, 0, INT_MAX);
+    max_depth = init_len_jzw < init_len_sm2 ? init_len_jzw : init_len_sm2;
+    if (max_depth == INT_MAX) {
+      return NULL;
+    }
+
+    /*
+     * Initial solution
+     */
+    best_sol = malloc(sizeof(move_t) * max_depth);
+    if (best_sol == NULL) {
+      fprintf(stderr, "Cannot allocate the solution\n");
+      return NULL;
+    }
+    copy_state(probe_state, root_state);
+    if (init_len_jzw < init_len_sm2) {
+      jzw(probe_state, best_sol, 0, INT_MAX);
+    } else {
+      sm2(probe_state, best_sol, 0, INT_MAX);
+    }
   }
+  solver->best_sol = best_sol;
+  solver->time_to_best_ub = start_time;
 
   /*
-   * Temporary variables for lower bounding
+   * Tighten the initial upper bound by randomized restarts
    */
-  array_s1 = malloc(sizeof(int) * n_stacks);
+  if (param->n_restarts > 0) {
+    double restart_end = get_wall_time() + param->restart_time;
+    int len = multi_start(
+        root_state, best_sol, max_depth - 1, param->n_restarts,
+        restart_end < solver->end_time ? restart_end : solver->end_time,
+        param->n_threads, param->seed);
+    if (len != INT_MAX) {
+      max_depth = len;
+      solver->time_to_best_ub = get_wall_time();
+    }
+  }
 
   /*
-   * Temporary variables for branch-and-bound
+   * Tighten the initial upper bound by beam search
    */
-  min_last_change_left = malloc(sizeof(int) * n_stacks);
-  max_last_move_out_right = malloc(sizeof(int) * n_stacks);
-  max_group_src_temp = malloc(sizeof(int) * (max_prio + 1));
-  max_group_src_right = malloc(sizeof(int) * n_stacks);
-  max_group_dst_right = malloc(sizeof(int) * n_stacks);
-
-  path = malloc(sizeof(move_t) * max_depth);
-  hist = malloc(sizeof(node_t) * (max_depth + 1));
-  for (int i = 1; i <= max_depth; i++) {
-    hist[i].state = malloc_state(n_stacks, n_tiers, false, true, true);
-  }
-  temp_state = malloc_state(n_stacks, n_tiers, true, false, true);
-  pool = malloc(sizeof(branch_t) * max_depth * n_stacks * (n_stacks - 1));
-  for (int i = 0; i < max_depth * n_stacks * (n_stacks - 1); i++) {
-    pool[i].child_state = malloc_state(n_stacks, n_tiers, true, false, true);
+  if (param->beam_width > 0) {
+    int len = beam(root_state, best_sol, max_depth - 1, param->beam_width,
+                   solver->end_time, param->n_threads);
+    if (len != INT_MAX) {
+      max_depth = len;
+      solver->time_to_best_ub = get_wall_time();
+    }
   }
 
   /*
    * Root lower bound
    */
-  int root_lb = lb_ts(root_state, INT_MAX, array_s1);
+  int root_lb = lb_ts(root_state, INT_MAX, solver->array_s1);
 
   /*
-   * Initialize best lower and upper bounds
+   * Report the heuristic solution only
    */
-  best_lb = root_lb;
-  time_to_best_lb = start_time;
-  best_sol = malloc(sizeof(move_t) * max_depth);
-  copy_state(probe_state, root_state);
-  best_ub = init_len_jzw < init_len_sm2
-                ? jzw(probe_state, best_sol, 0, INT_MAX)
-                : sm2(probe_state, best_sol, 0, INT_MAX);
-  time_to_best_ub = start_time;
+  if (param->heuristic_only) {
+    if (solver->is_ranked) {
+      unrank_moves(solver, best_sol, best_sol, max_depth);
+    }
+    report_t *report = new_report(
+        root_lb, max_depth, root_lb, max_depth, best_sol, 0,
+        solver->time_to_best_ub - start_time, get_wall_time() - start_time,
+        0, 0, 0, 0, 0);
+    free(best_sol);
+    return report;
+  }
 
   /*
-   * Initialize history
+   * Temporary variables for branch-and-bound
    */
-  hist[0].lb = root_lb;
-  hist[0].state = root_state;
+  memset(solver->group_dst_stamp, 0, sizeof(long) * (inst->max_prio + 1));
+  reserve_levels(solver, max_depth);
+  int n_branches =
+      solver->max_depth_cap * solver->n_stacks * (solver->n_stacks - 1);
+  set_lazy_order(solver->temp_state, solver->lazy_order);
+  for (int i = 0; i < n_branches; i++) {
+    set_lazy_order(solver->pool[i].child_state, solver->lazy_order);
+  }
+  for (int i = 1; i <= solver->max_depth_cap; i++) {
+    set_lazy_order(solver->trail[i], solver->lazy_order);
+  }
+  if (solver->probe_cache != NULL &&
+      solver->probe_cache_size != param->probe_cache_size) {
+    free_probe_cache(solver->probe_cache);
+    solver->probe_cache = NULL;
+  }
+  if (solver->probe_cache != NULL) {
+    clear_probe_cache(solver->probe_cache);
+  } else if (param->probe_cache_size > 0) {
+    solver->probe_cache = malloc_probe_cache(param->probe_cache_size);
+  }
+  solver->probe_cache_size = param->probe_cache_size;
 
   /*
-   * Iterative deepening search
+   * Order of the dominance checks, from the profile if it can be loaded, or
+   * else calibrated on the first nodes and recorded in the profile
    */
-  n_nodes = 0;
-  n_probe = 0;
-  n_timer = 0;
-  timer_cycle = 1000000;
-
-  debug_info("start");
-  while (best_lb < best_ub) {
-    if (search(0, pool)) {
-      break;
-    }
-    best_lb++;
-    time_to_best_lb = get_time();
-    debug_info("deepen");
+  solver->check_order = 0;
+  solver->check_profile = param->check_profile;
+  solver->calibration_nodes = param->calibration_nodes;
+  if (param->check_profile != NULL &&
+      load_check_profile(solver, param->check_profile)) {
+    solver->check_order = select_order(solver);
+    solver->calibrating = false;
+  } else {
+    memset(solver->check_stat, 0, sizeof(solver->check_stat));
+    solver->check_overhead = 0;
+    solver->calibrating = param->calibration_nodes > 0;
   }
-  debug_info("end");
+  solver->search = solver->searches[solver->check_order];
 
   /*
-   * Free temporary variables
+   * Initialize best lower and upper bounds
    */
-  free_state(root_state);
-  free_state(probe_state);
-  free(array_s1);
-  free(min_last_change_left);
-  free(max_last_move_out_right);
-  free(max_group_src_temp);
-  free(max_group_src_right);
-  free(max_group_dst_right);
-  free(path);
-  for (int i = 1; i <= max_depth; i++) {
-    free_state(hist[i].state);
+  solver->best_lb = root_lb;
+  solver->time_to_best_lb = start_time;
+  solver->best_ub = max_depth;
+
+  /*
+   * Initialize history
+   */
+  solver->hist[0].lb = root_lb;
+  solver->hist[0].state = root_state;
+  solver->hist[0].board = &solver->root_board;
+  if (solver->use_board) {
+    load_board(&solver->root_board, root_state, inst->max_prio);
+  }
+
+  /*
+   * Best-first or fringe search if chosen, then iterative deepening search if
+   * not done
+   */
+  solver->collect_level = -1;
+  solver->recording = false;
+  solver->n_nodes = 0;
+  solver->n_probe = 0;
+  solver->n_probe_skip = 0;
+  solver->n_cache_lookup = 0;
+  solver->n_cache_hit = 0;
+  solver->n_timer = 0;
+  solver->n_beat = 0;
+  solver->heartbeat_nodes =
+      param->heartbeat_nodes > 0 ? param->heartbeat_nodes : 1000000;
+  solver->timer_cycle = solver->heartbeat_nodes < TIMER_NODES
+                            ? solver->heartbeat_nodes
+                            : TIMER_NODES;
+
+  debug_info(solver, "start");
+  bool stopped = notify(solver, PROGRESS_START);
+  if (!stopped && param->engine == ENGINE_ASTAR) {
+    stopped = best_first(solver);
+  } else if (!stopped && param->engine == ENGINE_FRINGE) {
+    stopped = fringe_search(solver);
   }
-  free(hist);
-  free_state(temp_state);
-  for (int i = 0; i < max_depth * n_stacks * (n_stacks - 1); i++) {
-    free_state(pool[i].child_state);
+  while (!stopped && solver->best_lb < solver->best_ub) {
+    memset(solver->probe_stat, 0, sizeof(probe_stat_t[2]) * (max_depth + 1));
+    solver->bound = solver->best_lb;
+    if (solver->search(solver, 0, solver->pool)) {
+      break;
+    }
+    stopped = deepen(solver, solver->best_lb + 1);
   }
-  free(pool);
+  debug_info(solver, "end");
 
   /*
    * Report
    */
-  report_t *report =
-      new_report(root_lb, max_depth, best_lb, best_ub, best_sol,
-                 time_to_best_lb - start_time, time_to_best_ub - start_time,
-                 get_time() - start_time, n_nodes, n_probe);
+  if (solver->is_ranked) {
+    unrank_moves(solver, best_sol, best_sol, solver->best_ub);
+  }
+  report_t *report = new_report(
+      root_lb, max_depth, solver->best_lb, solver->best_ub, best_sol,
+      solver->time_to_best_lb - start_time,
+      solver->time_to_best_ub - start_time, get_wall_time() - start_time,
+      solver->n_nodes, solver->n_probe, solver->n_probe_skip,
+      solver->n_cache_lookup, solver->n_cache_hit);
   free(best_sol);
   return report;
 }
+
+report_t *solve(instance_t *inst, param_t *param) {
+  solver_t *solver = malloc_solver(inst->n_stacks, inst->n_tiers);
+  if (solver == NULL) {
+    fprintf(stderr, "Cannot allocate the solver\n");
+    return NULL;
+  }
+  report_t *report = run_solver(solver, inst, param);
+  free_solver(solver);
+  return report;
+}
@@ -19,15 +19,47 @@
 #define ALGORITHM_H
 
 #include "instance.h"
+#include "param.h"
 #include "report.h"
 
+typedef struct solver solver_t;
+
+/**
+ * Create a solver for instances of a given size, whose temporary variables
+ * are kept between runs
+ *
+ * @param n_stacks number of stacks
+ * @param n_tiers number of tiers
+ * @return created solver, or NULL if out of memory
+ */
+solver_t *malloc_solver(int n_stacks, int n_tiers);
+
+/**
+ * Free the space of a solver
+ *
+ * @param solver the solver
+ */
+void free_solver(solver_t *solver);
+
+/**
+ * Solve an instance with a solver of the same size. A solver must not be run
+ * by two threads at the same time, but different solvers can.
+ *
+ * @param solver the solver
+ * @param inst instance to be solved
+ * @param param parameters
+ * @return solution report, or NULL if there is no solution or out of memory
+ */
+report_t *run_solver(solver_t *solver, instance_t *inst, param_t *param);
+
 /**
- * Solve an instance by iterative deepening branch-and-bound
+ * Solve an instance by iterative deepening branch-and-bound, or by best-first
+ * search if chosen in the parameters
  *
  * @param inst instance to be solved
- * @param _t time limit in seconds
- * @return solution report
+ * @param param parameters
+ * @return solution report, or NULL if there is no solution or out of memory
  */
-report_t *solve(instance_t *inst, int _t);
+report_t *solve(instance_t *inst, param_t *param);
 
 #endif
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "batch.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BATCH_MAGIC "UCRPBIN1"
+#define BATCH_BYTE_ORDER 0x01020304
+
+typedef struct {
+  char magic[8];
+  int32_t byte_order;
+  int32_t reserved;
+  int64_t n_instances;
+  int64_t table_offset;
+} batch_header_t;
+
+bool is_batch_file(char *input) {
+  FILE *fp = fopen(input, "rb");
+  if (fp == NULL) {
+    return false;
+  }
+  char magic[8];
+  bool found =
+      fread(magic, 1, 8, fp) == 8 && memcmp(magic, BATCH_MAGIC, 8) == 0;
+  fclose(fp);
+  return found;
+}
+
+batch_t *open_batch(char *input) {
+  if (sizeof(int) != sizeof(int32_t)) {
+    fprintf(stderr, "Batch files need 32-bit int\n");
+    return NULL;
+  }
+
+  int fd = open(input, O_RDONLY);
+  if (fd == -1) {
+    fprintf(stderr, "Failed to open file: %s\n", input);
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(batch_header_t)) {
+    fprintf(stderr, "Failed to read batch header: %s\n", input);
+    close(fd);
+    return NULL;
+  }
+  char *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "Failed to map file: %s\n", input);
+    close(fd);
+    return NULL;
+  }
+
+  batch_header_t *header = (batch_header_t *)data;
+  if (memcmp(header->magic, BATCH_MAGIC, 8) != 0 ||
+      header->byte_order != BATCH_BYTE_ORDER || header->n_instances < 0 ||
+      header->table_offset < (int64_t)sizeof(batch_header_t) ||
+      header->table_offset % sizeof(int64_t) != 0 ||
+      (st.st_size - header->table_offset) / (int64_t)sizeof(int64_t) <
+          header->n_instances) {
+    fprintf(stderr, "Invalid batch header: %s\n", input);
+    munmap(data, st.st_size);
+    close(fd);
+    return NULL;
+  }
+
+  batch_t *batch = malloc(sizeof(batch_t));
+  batch->fd = fd;
+  batch->data = data;
+  batch->size = st.st_size;
+  batch->n_instances = header->n_instances;
+  batch->offsets = (const int64_t *)(data + header->table_offset);
+  return batch;
+}
+
+void close_batch(batch_t *batch) {
+  munmap(batch->data, batch->size);
+  close(batch->fd);
+  free(batch);
+}
+
+instance_t *get_batch_instance(batch_t *batch, long i) {
+  if (i < 0 || i >= batch->n_instances) {
+    return NULL;
+  }
+  int64_t offset = batch->offsets[i];
+  if (offset < (int64_t)sizeof(batch_header_t) ||
+      offset % sizeof(int32_t) != 0 ||
+      (size_t)offset + 4 * sizeof(int32_t) > batch->size) {
+    return NULL;
+  }
+  int *record = (int *)(batch->data + offset);
+  int n_stacks = record[0];
+  int n_tiers = record[1];
+  if (n_stacks < 1 || n_tiers < 1 ||
+      (size_t)n_tiers + 1 > INT_MAX / (size_t)n_stacks ||
+      (batch->size - offset) / sizeof(int32_t) - 4 <
+          (size_t)n_stacks * ((size_t)n_tiers + 2)) {
+    return NULL;
+  }
+
+  /*
+   * Check the fields as read_next_instance does for text
+   */
+  const int *h = record + 4;
+  const int *p = record + 4 + n_stacks;
+  long n_blocks = 0;
+  int max_prio = 0;
+  for (int s = 0; s < n_stacks; s++) {
+    if (h[s] < 0 || h[s] > n_tiers) {
+      return NULL;
+    }
+    n_blocks += h[s];
+    for (int t = 1; t <= h[s]; t++) {
+      int prio = p[(size_t)s * (n_tiers + 1) + t];
+      if (prio < 1) {
+        return NULL;
+      }
+      if (max_prio < prio) {
+        max_prio = prio;
+      }
+    }
+  }
+  if (n_blocks != record[2] || max_prio != record[3]) {
+    return NULL;
+  }
+
+  instance_t *inst = malloc(sizeof(instance_t));
+  inst->n_stacks = n_stacks;
+  inst->n_tiers = n_tiers;
+  inst->n_blocks = record[2];
+  inst->max_prio = record[3];
+  inst->is_view = true;
+  inst->h = record + 4;
+  inst->p = malloc(sizeof(int *) * n_stacks);
+  for (int s = 0; s < n_stacks; s++) {
+    inst->p[s] = record + 4 + n_stacks + s * (n_tiers + 1);
+  }
+  return inst;
+}
+
+long write_batch(FILE *fp, reader_t *reader) {
+  batch_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BATCH_MAGIC, 8);
+  header.byte_order = BATCH_BYTE_ORDER;
+  if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+    return -1;
+  }
+
+  long cap = 1024;
+  int64_t *offsets = malloc(sizeof(int64_t) * cap);
+  int64_t offset = sizeof(header);
+  long n = 0;
+  bool failed = false;
+  instance_t *inst;
+  for (int status;
+       !failed && (status = read_next_instance(reader, &inst)) != 0;) {
+    if (status < 0) {
+      continue;
+    }
+    if (n == cap) {
+      cap *= 2;
+      offsets = realloc(offsets, sizeof(int64_t) * cap);
+    }
+    offsets[n++] = offset;
+
+    int fields[4] = {inst->n_stacks, inst->n_tiers, inst->n_blocks,
+                     inst->max_prio};
+    for (int s = 0; s < inst->n_stacks; s++) {
+      for (int t = inst->h[s] + 1; t <= inst->n_tiers; t++) {
+        inst->p[s][t] = 0;
+      }
+      inst->p[s][0] = 0;
+    }
+    size_t n_cells = (size_t)inst->n_stacks * (inst->n_tiers + 1);
+    failed = fwrite(fields, sizeof(int), 4, fp) != 4 ||
+             fwrite(inst->h, sizeof(int), inst->n_stacks, fp) !=
+                 (size_t)inst->n_stacks ||
+             fwrite(inst->p[0], sizeof(int), n_cells, fp) != n_cells;
+    offset += sizeof(int) * (4 + inst->n_stacks + n_cells);
+  }
+
+  if (!failed && offset % sizeof(int64_t) != 0) {
+    int32_t padding = 0;
+    failed = fwrite(&padding, sizeof(padding), 1, fp) != 1;
+    offset += sizeof(padding);
+  }
+  header.n_instances = n;
+  header.table_offset = offset;
+  failed = failed || fwrite(offsets, sizeof(int64_t), n, fp) != (size_t)n ||
+           fseek(fp, 0, SEEK_SET) != 0 ||
+           fwrite(&header, sizeof(header), 1, fp) != 1;
+  free(offsets);
+
+  return failed ? -1 : n;
+}
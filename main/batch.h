@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "instance.h"
+#include <stdint.h>
+
+/*
+ * Binary batch format, all integers in native byte order:
+ *
+ *   header:  char magic[8] = "UCRPBIN1", int32 byte_order = 0x01020304,
+ *            int32 reserved, int64 n_instances, int64 table_offset
+ *   records: int32 n_stacks, n_tiers, n_blocks, max_prio,
+ *            int32 h[n_stacks], int32 p[n_stacks][n_tiers + 1]
+ *   table:   int64 offsets[n_instances], byte offsets of the records
+ *
+ * p[s][0] is unused, so that every column has the stride of instance_t.
+ */
+
+typedef struct {
+  int fd;                 // file descriptor
+  char *data;             // mapped file
+  size_t size;            // size of the file in bytes
+  long n_instances;       // number of instances
+  const int64_t *offsets; // offsets[i]: byte offset of instance i
+} batch_t;
+
+/**
+ * Check if a file is in the binary batch format
+ *
+ * @param input file name
+ * @return true if the file starts with the batch magic
+ */
+bool is_batch_file(char *input);
+
+/**
+ * Map a binary batch file into memory
+ *
+ * @param input file name
+ * @return opened batch or NULL if the file cannot be mapped
+ */
+batch_t *open_batch(char *input);
+
+/**
+ * Unmap a binary batch file
+ *
+ * @param batch the batch
+ */
+void close_batch(batch_t *batch);
+
+/**
+ * Create a view of an instance in a batch without copying its data. The view
+ * is freed by free_instance and must not outlive the batch.
+ *
+ * @param batch the batch
+ * @param i index of the instance
+ * @return created view or NULL if the record is corrupt
+ */
+instance_t *get_batch_instance(batch_t *batch, long i);
+
+/**
+ * Convert instances from a reader into the binary batch format
+ *
+ * @param fp output stream, which must be seekable
+ * @param reader the reader
+ * @return number of instances written or -1 if writing fails
+ */
+long write_batch(FILE *fp, reader_t *reader);
+
+#endif
@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "algorithm.h"
+#include "board.h"
+#include "lower_bound.h"
+#include "timer.h"
+#include <getopt.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(void) {
+  fprintf(stdout, "usage: main-bench -h\n");
+  fprintf(stdout, "usage: main-bench"
+                  " [--stacks/-S n_stacks]"
+                  " [--tiers/-T n_tiers]"
+                  " [--instances/-n n_instances]"
+                  " [--walk/-w walk_length]"
+                  " [--repeats/-r n_repeats]"
+                  " [--seed/-s seed]"
+                  " [--search/-x n_nodes]\n");
+  fprintf(stdout, "\t--stacks/-S: number of stacks of the random bays\n");
+  fprintf(stdout, "\t--tiers/-T: number of tiers of the random bays, of"
+                  " which the top two are empty\n");
+  fprintf(stdout, "\t--instances/-n: number of random bays\n");
+  fprintf(stdout, "\t--walk/-w: number of random relocations from each bay,"
+                  " each giving a state to bound\n");
+  fprintf(stdout, "\t--repeats/-r: number of passes over the states, or of"
+                  " runs of each search\n");
+  fprintf(stdout, "\t--seed/-s: random seed\n");
+  fprintf(stdout, "\t--search/-x: instead of lower bounds, time the search"
+                  " of each bay up to n_nodes nodes, generic and specialized"
+                  " for the shape\n");
+  fflush(stdout);
+}
+
+static unsigned next_random(unsigned *seed) {
+  unsigned x = *seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *seed = x;
+}
+
+/*
+ * Random bay whose top two tiers are empty
+ */
+static void random_bay(instance_t *inst, int *prios, unsigned *seed) {
+  int n_tiers = inst->n_tiers;
+  int n_blocks = inst->n_stacks * (n_tiers - 2);
+  for (int j = 0; j < n_blocks; j++) {
+    int k = (int)(next_random(seed) % (unsigned)(j + 1));
+    prios[j] = prios[k];
+    prios[k] = j + 1;
+  }
+  inst->n_blocks = n_blocks;
+  inst->max_prio = n_blocks;
+  for (int s = 0; s < inst->n_stacks; s++) {
+    inst->h[s] = n_tiers - 2;
+    for (int t = 1; t <= inst->h[s]; t++) {
+      inst->p[s][t] = prios[s * (n_tiers - 2) + t - 1];
+    }
+  }
+}
+
+/*
+ * States met on random walks from random bays
+ */
+static state_t **sample_states(int n_stacks, int n_tiers, int n_instances,
+                               int walk, unsigned seed, int *n_states) {
+  instance_t *inst = malloc_instance(n_stacks, n_tiers);
+  int *prios = malloc(sizeof(int) * n_stacks * (n_tiers - 2));
+  state_t **states = malloc(sizeof(state_t *) * n_instances * (walk + 1));
+  *n_states = 0;
+  for (int i = 0; i < n_instances; i++) {
+    random_bay(inst, prios, &seed);
+
+    state_t *state = malloc_state(n_stacks, n_tiers, true, true, false);
+    init_state(state, inst);
+    for (int j = 0; j <= walk && state->n_blocks > 0; j++) {
+      while (is_retrievable(state)) {
+        retrieve(state, 0);
+      }
+      if (state->n_blocks == 0) {
+        break;
+      }
+      state_t *sample = malloc_state(n_stacks, n_tiers, true, true, false);
+      copy_state(sample, state);
+      states[(*n_states)++] = sample;
+
+      int s;
+      int d;
+      do {
+        s = (int)(next_random(&seed) % (unsigned)n_stacks);
+        d = (int)(next_random(&seed) % (unsigned)n_stacks);
+      } while (s == d || state->h[s] == 0 || state->h[d] == n_tiers);
+      relocate(state, s, d, 0);
+    }
+    free_state(state);
+  }
+  free(prios);
+  free_instance(inst);
+  return states;
+}
+
+/*
+ * Search of random bays, each stopped at the first heartbeat after n_nodes
+ * nodes, so that the generic and the specialized search explore the same
+ * nodes and must end with the same bounds. The two take turns on each bay,
+ * and the fastest of n_repeats runs counts.
+ */
+static bool stop_search(const progress_t *progress, void *data) {
+  (void)data;
+  return progress->type == PROGRESS_HEARTBEAT;
+}
+
+static int bench_search(int n_stacks, int n_tiers, int n_instances,
+                        int n_repeats, long n_nodes, unsigned seed) {
+  instance_t *inst = malloc_instance(n_stacks, n_tiers);
+  int *prios = malloc(sizeof(int) * n_stacks * (n_tiers - 2));
+  solver_t *solver = malloc_solver(n_stacks, n_tiers);
+  param_t param;
+  init_param(&param);
+  param.n_threads = 1;
+  param.log_level = LOG_QUIET;
+  param.progress = stop_search;
+  param.heartbeat_nodes = n_nodes;
+  fprintf(stdout, "%d bays of %d stacks and %d tiers, %ld nodes each\n",
+          n_instances, n_stacks, n_tiers, n_nodes);
+
+  long total_nodes = 0;
+  double total_time[2] = {0, 0};
+  int n_mismatches = 0;
+  for (int i = 0; i < n_instances; i++) {
+    random_bay(inst, prios, &seed);
+    double best_time[2] = {INFINITY, INFINITY};
+    int best_lb = -1;
+    int best_ub = -1;
+    long nodes = 0;
+    for (int r = 0; r < n_repeats; r++) {
+      for (int specialized = 0; specialized <= 1; specialized++) {
+        param.specialized = specialized;
+        report_t *report = run_solver(solver, inst, &param);
+        if (report == NULL) {
+          continue;
+        }
+        if (best_lb == -1) {
+          best_lb = report->best_lb;
+          best_ub = report->best_ub;
+          nodes = report->n_nodes;
+        } else {
+          n_mismatches += report->best_lb != best_lb ||
+                          report->best_ub != best_ub ||
+                          report->n_nodes != nodes;
+        }
+        if (best_time[specialized] > report->time_used) {
+          best_time[specialized] = report->time_used;
+        }
+        free_report(report);
+      }
+    }
+    if (best_lb != -1) {
+      total_nodes += nodes;
+      total_time[0] += best_time[0];
+      total_time[1] += best_time[1];
+    }
+  }
+
+  char *names[2] = {"generic", "shape"};
+  for (int specialized = 0; specialized <= 1; specialized++) {
+    double time = total_time[specialized];
+    fprintf(stdout, "%-8s %10.0f nodes/s  speedup = %.2f  nodes = %ld\n",
+            names[specialized], time > 0 ? total_nodes / time : 0,
+            time > 0 ? total_time[0] / time : 0, total_nodes);
+  }
+  fprintf(stdout, "mismatches = %d\n", n_mismatches);
+
+  free_solver(solver);
+  free(prios);
+  free_instance(inst);
+  return n_mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+  char *opts = "hS:T:n:w:r:s:x:";
+  struct option options[] = {{"help", no_argument, NULL, 'h'},
+                             {"stacks", required_argument, NULL, 'S'},
+                             {"tiers", required_argument, NULL, 'T'},
+                             {"instances", required_argument, NULL, 'n'},
+                             {"walk", required_argument, NULL, 'w'},
+                             {"repeats", required_argument, NULL, 'r'},
+                             {"seed", required_argument, NULL, 's'},
+                             {"search", required_argument, NULL, 'x'},
+                             {NULL, 0, NULL, 0}};
+
+  int n_stacks = 16;
+  int n_tiers = 8;
+  int n_instances = 100;
+  int walk = 50;
+  int n_repeats = 20;
+  unsigned seed = 1;
+  long n_nodes = 0;
+  for (int opt; (opt = getopt_long(argc, argv, opts, options, NULL)) != -1;) {
+    switch (opt) {
+    case 'h':
+      usage();
+      return EXIT_SUCCESS;
+    case 'S':
+      n_stacks = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'T':
+      n_tiers = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'n':
+      n_instances = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'w':
+      walk = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'r':
+      n_repeats = (int)strtol(optarg, NULL, 10);
+      break;
+    case 's':
+      seed = (unsigned)strtoul(optarg, NULL, 10);
+      break;
+    case 'x':
+      n_nodes = strtol(optarg, NULL, 10);
+      break;
+    default:
+      fprintf(stderr, "Unknown option: %c\n", opt);
+      return EXIT_FAILURE;
+    }
+  }
+  if (n_stacks < 2 || n_tiers < 3 || n_instances < 1 || walk < 0 ||
+      n_repeats < 1) {
+    fprintf(stderr, "Invalid bay or sample size\n");
+    return EXIT_FAILURE;
+  }
+  if (n_nodes > 0) {
+    return bench_search(n_stacks, n_tiers, n_instances, n_repeats, n_nodes,
+                        seed);
+  }
+
+  int n_states;
+  state_t **states =
+      sample_states(n_stacks, n_tiers, n_instances, walk, seed, &n_states);
+  int *temp = malloc(sizeof(int) * lb_ts_temp_size(n_stacks));
+  int *expected = malloc(sizeof(int) * n_states * 4);
+  int max_ks[4] = {1, 2, 4, INT_MAX};
+  fprintf(stdout, "%d states of %d stacks and %d tiers\n", n_states, n_stacks,
+          n_tiers);
+
+  /*
+   * Every kernel the CPU supports must agree with the scalar one
+   */
+  char *names[3] = {"scalar", "sse4", "avx2"};
+  double base_time = 0;
+  int n_failed = 0;
+  for (int kernel = LB_TS_SCALAR; kernel <= LB_TS_AVX2; kernel++) {
+    if (select_lb_ts_kernel(kernel) != kernel) {
+      fprintf(stdout, "%-8s unsupported\n", names[kernel]);
+      continue;
+    }
+    int n_mismatches = 0;
+    for (int i = 0; i < n_states; i++) {
+      for (int j = 0; j < 4; j++) {
+        int lb = lb_ts(states[i], max_ks[j], temp);
+        if (kernel == LB_TS_SCALAR) {
+          expected[i * 4 + j] = lb;
+        } else {
+          n_mismatches += lb != expected[i * 4 + j];
+        }
+      }
+    }
+
+    long sum = 0;
+    double start_time = get_thread_time();
+    for (int r = 0; r < n_repeats; r++) {
+      for (int i = 0; i < n_states; i++) {
+        sum += lb_ts(states[i], INT_MAX, temp);
+      }
+    }
+    double time = get_thread_time() - start_time;
+    if (kernel == LB_TS_SCALAR) {
+      base_time = time;
+    }
+    fprintf(stdout,
+            "%-8s %8.1f ns/call  speedup = %.2f  sum = %ld  mismatches = %d\n",
+            names[kernel], 1e9 * time / n_repeats / n_states,
+            time > 0 ? base_time / time : 0, sum, n_mismatches);
+    n_failed += n_mismatches;
+  }
+
+  /*
+   * So must the bitboard of small bays
+   */
+  int max_prio = n_stacks * (n_tiers - 2);
+  if (fits_board(n_stacks, n_tiers, max_prio)) {
+    board_t *boards = malloc(sizeof(board_t) * n_states);
+    int n_mismatches = 0;
+    for (int i = 0; i < n_states; i++) {
+      load_board(&boards[i], states[i], max_prio);
+      for (int j = 0; j < 4; j++) {
+        n_mismatches +=
+            lb_ts_board(&boards[i], max_ks[j]) != expected[i * 4 + j];
+      }
+    }
+
+    long sum = 0;
+    double start_time = get_thread_time();
+    for (int r = 0; r < n_repeats; r++) {
+      for (int i = 0; i < n_states; i++) {
+        sum += lb_ts_board(&boards[i], INT_MAX);
+      }
+    }
+    double time = get_thread_time() - start_time;
+    fprintf(stdout,
+            "%-8s %8.1f ns/call  speedup = %.2f  sum = %ld  mismatches = %d\n",
+            "board", 1e9 * time / n_repeats / n_states,
+            time > 0 ? base_time / time : 0, sum, n_mismatches);
+    n_failed += n_mismatches;
+
+    /*
+     * And the children of a board bounded at once must agree with each child
+     * built and bounded alone
+     */
+    n_mismatches = 0;
+    long n_children = 0;
+    int dsts[BOARD_STACKS];
+    int lbs[BOARD_STACKS];
+    int max_lbs[4] = {0, 2, 4, INT_MAX};
+    double single_time = 0;
+    double batch_time = 0;
+    for (int i = 0; i < n_states; i++) {
+      for (int s = 0; s < n_stacks; s++) {
+        if (boards[i].h[s] == 0) {
+          continue;
+        }
+        board_t out = boards[i];
+        int p = out.tp[s];
+        pop_board(&out, s);
+        int n_dsts = 0;
+        for (int d = 0; d < n_stacks; d++) {
+          if (d != s && out.h[d] < n_tiers) {
+            dsts[n_dsts++] = d;
+          }
+        }
+        n_children += n_dsts;
+        for (int j = 0; j < 4; j++) {
+          int max_lb = max_lbs[j] == INT_MAX ? INT_MAX
+                                             : out.n_bad + max_lbs[j];
+          double start_time = get_thread_time();
+          for (int r = 0; r < n_repeats; r++) {
+            lb_ts_board_children(&out, p, dsts, n_dsts, max_lb, lbs);
+          }
+          batch_time += get_thread_time() - start_time;
+          start_time = get_thread_time();
+          for (int r = 0; r < n_repeats; r++) {
+            for (int k = 0; k < n_dsts; k++) {
+              board_t child = out;
+              push_board(&child, dsts[k], p);
+              retrieve_board(&child);
+              int lb = lb_ts_board(&child, max_lb - child.n_bad);
+              n_mismatches += r == 0 && lb != lbs[k];
+            }
+          }
+          single_time += get_thread_time() - start_time;
+        }
+      }
+    }
+    n_children *= 4 * n_repeats;
+    fprintf(stdout,
+            "%-8s %8.1f ns/child  speedup = %.2f  children = %ld"
+            "  mismatches = %d\n",
+            "children", n_children > 0 ? 1e9 * batch_time / n_children : 0,
+            batch_time > 0 ? single_time / batch_time : 0, n_children,
+            n_mismatches);
+    n_failed += n_mismatches;
+    free(boards);
+  }
+
+  for (int i = 0; i < n_states; i++) {
+    free_state(states[i]);
+  }
+  free(states);
+  free(temp);
+  free(expected);
+  return n_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "board.h"
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+bool fits_board(int n_stacks, int n_tiers, int max_prio) {
+  return n_stacks <= BOARD_STACKS && n_tiers <= BOARD_TIERS && max_prio <= 254;
+}
+
+static inline int get_byte(uint64_t x, int i) {
+  return (int)(x >> (8 * i)) & 0xff;
+}
+
+static inline void set_top(board_t *board, int s) {
+  int h = board->h[s];
+  if (h == 0) {
+    board->tp[s] = board->ground;
+    board->tq[s] = board->ground;
+    board->bad_top &= ~(1u << s);
+    board->empty |= 1u << s;
+  } else {
+    board->tp[s] = get_byte(board->p[s], h - 1);
+    board->tq[s] = get_byte(board->q[s], h - 1);
+    board->bad_top = (board->bad_top & ~(1u << s)) |
+                     ((board->bad[s] >> (h - 1) & 1u) << s);
+  }
+}
+
+void load_board(board_t *board, state_t *state, int max_prio) {
+  board->n_stacks = state->n_stacks;
+  board->n_tiers = state->n_tiers;
+  board->n_blocks = state->n_blocks;
+  board->n_bad = state->n_bad;
+  board->ground = max_prio + 1;
+  board->full = 0;
+  board->empty = 0;
+  board->bad_top = 0;
+  memset(board->h, 255, sizeof(board->h));
+  memset(board->tp, 255, sizeof(board->tp));
+  memset(board->tq, 255, sizeof(board->tq));
+  for (int s = 0; s < state->n_stacks; s++) {
+    board->h[s] = state->h[s];
+    board->bad[s] = 0;
+    board->p[s] = 0;
+    board->q[s] = 0;
+    for (int t = 1; t <= state->h[s]; t++) {
+      board->bad[s] |= (state->b[s][t] > 0) << (t - 1);
+      board->p[s] |= (uint64_t)state->p[s][t] << (8 * (t - 1));
+      board->q[s] |= (uint64_t)state->q[s][t] << (8 * (t - 1));
+    }
+    if (state->h[s] == state->n_tiers) {
+      board->full |= 1u << s;
+    }
+    set_top(board, s);
+  }
+}
+
+void pop_board(board_t *board, int s) {
+  int h = --board->h[s];
+  uint64_t mask = ~((uint64_t)0xff << (8 * h));
+  board->n_bad -= board->bad_top >> s & 1u;
+  board->p[s] &= mask;
+  board->q[s] &= mask;
+  board->bad[s] &= ~(1u << h);
+  board->full &= ~(1u << s);
+  set_top(board, s);
+}
+
+void push_board(board_t *board, int d, int p) {
+  int h = board->h[d]++;
+  int q = board->tq[d];
+  bool is_bad = p > q;
+  if (is_bad) {
+    board->n_bad++;
+  } else {
+    q = p;
+  }
+  board->p[d] |= (uint64_t)p << (8 * h);
+  board->q[d] |= (uint64_t)q << (8 * h);
+  board->bad[d] |= is_bad << h;
+  board->tp[d] = p;
+  board->tq[d] = q;
+  board->bad_top = (board->bad_top & ~(1u << d)) | (is_bad << d);
+  board->empty &= ~(1u << d);
+  if (h + 1 == board->n_tiers) {
+    board->full |= 1u << d;
+  }
+}
+
+/*
+ * Operations on all 16 lanes, in which the padding never matches or counts
+ */
+#ifdef __SSE2__
+static inline __m128i load_lanes(const uint8_t *x) {
+  return _mm_loadu_si128((const __m128i *)x);
+}
+
+static inline int min_lanes(const uint8_t *x) {
+  __m128i v = load_lanes(x);
+  v = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+  v = _mm_min_epu8(v, _mm_srli_si128(v, 4));
+  v = _mm_min_epu8(v, _mm_srli_si128(v, 2));
+  v = _mm_min_epu8(v, _mm_srli_si128(v, 1));
+  return _mm_cvtsi128_si32(v) & 0xff;
+}
+
+static inline int max_open_lanes(const uint8_t *h, const uint8_t *x,
+                                 int n_tiers) {
+  __m128i vh = load_lanes(h);
+  __m128i open = _mm_cmpeq_epi8(_mm_min_epu8(vh, _mm_set1_epi8(n_tiers - 1)),
+                                vh); // h < n_tiers
+  __m128i v = _mm_and_si128(load_lanes(x), open);
+  v = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+  v = _mm_max_epu8(v, _mm_srli_si128(v, 4));
+  v = _mm_max_epu8(v, _mm_srli_si128(v, 2));
+  v = _mm_max_epu8(v, _mm_srli_si128(v, 1));
+  return _mm_cvtsi128_si32(v) & 0xff;
+}
+
+static inline int eq_lanes(const uint8_t *x, int y) {
+  return _mm_movemask_epi8(
+      _mm_cmpeq_epi8(load_lanes(x), _mm_set1_epi8((char)y)));
+}
+
+static inline int le_lanes(const uint8_t *x, int y) {
+  __m128i v = load_lanes(x);
+  return _mm_movemask_epi8(
+      _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8((char)y)), v));
+}
+#else
+static inline int min_lanes(const uint8_t *x) {
+  int y = x[0];
+  for (int s = 1; s < 16; s++) {
+    if (y > x[s]) {
+      y = x[s];
+    }
+  }
+  return y;
+}
+
+static inline int max_open_lanes(const uint8_t *h, const uint8_t *x,
+                                 int n_tiers) {
+  int y = 0;
+  for (int s = 0; s < 16; s++) {
+    if (h[s] < n_tiers && y < x[s]) {
+      y = x[s];
+    }
+  }
+  return y;
+}
+
+static inline int eq_lanes(const uint8_t *x, int y) {
+  int mask = 0;
+  for (int s = 0; s < 16; s++) {
+    mask |= (x[s] == y) << s;
+  }
+  return mask;
+}
+
+static inline int le_lanes(const uint8_t *x, int y) {
+  int mask = 0;
+  for (int s = 0; s < 16; s++) {
+    mask |= (x[s] <= y) << s;
+  }
+  return mask;
+}
+#endif
+
+/*
+ * A block can be retrieved if its priority is the smallest quality on top,
+ * and retrieving all those at once gives the same board as one by one
+ */
+void retrieve_board(board_t *board) {
+  while (board->n_blocks > 0) {
+    int mask = eq_lanes(board->tp, min_lanes(board->tq)) & ~board->empty;
+    if (mask == 0) {
+      break;
+    }
+    for (; mask != 0; mask &= mask - 1) {
+      int s = __builtin_ctz(mask);
+      int h = --board->h[s];
+      uint64_t keep = ~((uint64_t)0xff << (8 * h));
+      board->p[s] &= keep;
+      board->q[s] &= keep;
+      board->full &= ~(1u << s);
+      board->n_blocks--;
+      set_top(board, s);
+    }
+  }
+}
+
+/*
+ * LB-TS in rounds as the kernels of lower_bound.c, on working copies of the
+ * tops of the stacks
+ */
+typedef struct {
+  const board_t *board;
+  uint8_t h[16];
+  uint8_t tp[16];
+  uint8_t tq[16];
+  int bad_top;
+} tops_t;
+
+static inline bool peel_top(tops_t *tops, int s) {
+  int h = --tops->h[s];
+  if (h == 0) {
+    return false;
+  }
+  tops->tp[s] = get_byte(tops->board->p[s], h - 1);
+  tops->tq[s] = get_byte(tops->board->q[s], h - 1);
+  tops->bad_top = (tops->bad_top & ~(1 << s)) |
+                  ((tops->board->bad[s] >> (h - 1) & 1) << s);
+  return true;
+}
+
+static int lb_ts_tops(tops_t *tops, int n_bad, int max_k) {
+  int n_stacks = tops->board->n_stacks;
+  int n_tiers = tops->board->n_tiers;
+  int remain = n_bad;
+  int k = 0;
+  while (true) {
+    int q_min = min_lanes(tops->tq);
+    int q_max = max_open_lanes(tops->h, tops->tq, n_tiers);
+    while (true) {
+      int min_mask = eq_lanes(tops->tp, q_min);
+      int bad_mask = tops->bad_top & le_lanes(tops->tp, q_max);
+      if ((min_mask | bad_mask) == 0) {
+        break;
+      }
+      remain -= __builtin_popcount(bad_mask);
+      for (int mask = min_mask | bad_mask; mask != 0; mask &= mask - 1) {
+        if (!peel_top(tops, __builtin_ctz(mask))) {
+          return n_bad + k;
+        }
+      }
+      if (remain <= 0) {
+        return n_bad + k;
+      }
+      if (min_mask != 0) {
+        for (int mask = min_mask; mask != 0; mask &= mask - 1) {
+          int s = __builtin_ctz(mask);
+          if (q_max < tops->tq[s]) {
+            q_max = tops->tq[s];
+          }
+        }
+        q_min = min_lanes(tops->tq);
+      }
+    }
+
+    if (++k == max_k) {
+      return n_bad + k;
+    }
+    int last = eq_lanes(tops->h, 1);
+    if (__builtin_popcount(tops->bad_top) >= remain || last != 0) {
+      return n_bad + k;
+    }
+    remain -= __builtin_popcount(tops->bad_top);
+    for (int s = 0; s < n_stacks; s++) {
+      peel_top(tops, s);
+    }
+  }
+}
+
+static void load_tops(tops_t *tops, const board_t *board) {
+  tops->board = board;
+  memcpy(tops->h, board->h, sizeof(tops->h));
+  memcpy(tops->tp, board->tp, sizeof(tops->tp));
+  memcpy(tops->tq, board->tq, sizeof(tops->tq));
+  tops->bad_top = board->bad_top;
+}
+
+int lb_ts_board(const board_t *board, int max_k) {
+  if (board->n_bad == 0 || max_k == 0 || board->empty != 0) {
+    return board->n_bad;
+  }
+
+  tops_t tops;
+  load_tops(&tops, board);
+  return lb_ts_tops(&tops, board->n_bad, max_k);
+}
+
+/*
+ * Once the board in hand is retrieved, a child is the same board with one more
+ * block on top of d, unless the retrievals took blocks from d, which the block
+ * would have covered, or the block is retrievable itself. Its tops are those
+ * of the retrieved board but in lane d, and peeling the block from lane d
+ * uncovers the slots of the retrieved board again, so the child is never
+ * built.
+ */
+void lb_ts_board_children(const board_t *board, int p, const int *dsts,
+                          int n_dsts, int max_lb, int *lbs) {
+  board_t retrieved = *board;
+  retrieve_board(&retrieved);
+  int touched = 0;
+  for (int s = 0; s < board->n_stacks; s++) {
+    touched |= (retrieved.h[s] != board->h[s]) << s;
+  }
+  bool shared = p > min_lanes(retrieved.tq);
+
+  tops_t base;
+  load_tops(&base, &retrieved);
+  for (int i = 0; i < n_dsts; i++) {
+    int d = dsts[i];
+    if (!shared || (touched >> d & 1)) {
+      board_t child = *board;
+      push_board(&child, d, p);
+      retrieve_board(&child);
+      lbs[i] = lb_ts_board(&child, max_lb - child.n_bad);
+      continue;
+    }
+
+    int q = retrieved.tq[d];
+    bool is_bad = p > q;
+    int n_bad = retrieved.n_bad + is_bad;
+    int max_k = max_lb - n_bad;
+    if (n_bad == 0 || max_k == 0 || (retrieved.empty & ~(1u << d)) != 0) {
+      lbs[i] = n_bad;
+      continue;
+    }
+
+    tops_t tops = base;
+    tops.h[d]++;
+    tops.tp[d] = p;
+    tops.tq[d] = is_bad ? q : p;
+    tops.bad_top = (tops.bad_top & ~(1 << d)) | (is_bad << d);
+    lbs[i] = lb_ts_tops(&tops, n_bad, max_k);
+  }
+}
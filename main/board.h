@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#include "state.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BOARD_STACKS 16 // maximum number of stacks of a board
+#define BOARD_TIERS 8   // maximum number of tiers of a board
+
+/*
+ * Compact state of a small bay, with a byte per slot packed into one word
+ * per stack and a bit per stack in the masks. The lanes beyond n_stacks are
+ * padding, which never takes part: h = tp = tq = 255.
+ */
+typedef struct {
+  int n_stacks;        // number of stacks, at most BOARD_STACKS
+  int n_tiers;         // number of tiers, at most BOARD_TIERS
+  int n_blocks;        // number of blocks
+  int n_bad;           // number of badly-placed blocks
+  int ground;          // quality of the ground, i.e., max_prio + 1
+  uint16_t full;       // bit s: stack s is full
+  uint16_t empty;      // bit s: stack s is empty
+  uint16_t bad_top;    // bit s: the block on top of stack s is badly placed
+  uint8_t h[16];       // h[s]: height of stack s
+  uint8_t tp[16];      // tp[s]: priority on top of stack s, or ground
+  uint8_t tq[16];      // tq[s]: quality on top of stack s, or ground
+  uint8_t bad[16];     // bit t - 1 of bad[s]: p[s][t] is badly placed
+  uint64_t p[16];      // byte t - 1 of p[s]: priority p[s][t]
+  uint64_t q[16];      // byte t - 1 of q[s]: quality q[s][t]
+} board_t;
+
+/**
+ * Check if the bays of an instance fit in a board
+ *
+ * @param n_stacks number of stacks
+ * @param n_tiers number of tiers
+ * @param max_prio maximum priority value
+ * @return true if fitting
+ */
+bool fits_board(int n_stacks, int n_tiers, int max_prio);
+
+/**
+ * Load a board from a state, which must fit
+ *
+ * @param board the board
+ * @param state the state
+ * @param max_prio maximum priority value
+ */
+void load_board(board_t *board, state_t *state, int max_prio);
+
+/**
+ * Move the block on top of a stack out of the board
+ *
+ * @param board the board
+ * @param s source stack, not empty
+ */
+void pop_board(board_t *board, int s);
+
+/**
+ * Put a block on top of a stack of the board
+ *
+ * @param board the board
+ * @param d destination stack, not full
+ * @param p priority of the block
+ */
+void push_board(board_t *board, int d, int p);
+
+/**
+ * Retrieve blocks from the board as long as possible
+ *
+ * @param board the board
+ */
+void retrieve_board(board_t *board);
+
+/**
+ * Compute the value of LB-TS of a board, which equals lb_ts of the state
+ *
+ * @param board the board
+ * @param max_k maximum allowed number of blocking layers
+ * @return LB-TS
+ */
+int lb_ts_board(const board_t *board, int max_k);
+
+/**
+ * Compute the values of LB-TS of the children of a board with a block moved
+ * out, each with the block put on top of one destination stack and blocks
+ * retrieved as long as possible, from the tops they share
+ *
+ * @param board the board with the block moved out
+ * @param p priority of the block
+ * @param dsts destination stacks, not full
+ * @param n_dsts number of destination stacks
+ * @param max_lb maximum allowed value, which bounds the blocking layers of
+ * each child as max_k of lb_ts_board
+ * @param lbs LB-TS of each child
+ */
+void lb_ts_board_children(const board_t *board, int p, const int *dsts,
+                          int n_dsts, int max_lb, int *lbs);
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "instance.h"
+#include "timer.h"
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static void usage(void) {
+  fprintf(stdout, "usage: main-client -h\n");
+  fprintf(stdout, "usage: main-client"
+                  " --socket/-S socket_path"
+                  " --input/-i input_file"
+                  " [--time_limit/-t time_limit]\n");
+  fprintf(stdout, "\t--socket/-S: path of the socket of main-server\n");
+  fprintf(stdout, "\t--input/-i: input file with one or more instances"
+                  " (- for stdin)\n");
+  fprintf(stdout, "\t--time_limit/-t: time limit in seconds of each request"
+                  " (server default if omitted)\n");
+  fflush(stdout);
+}
+
+/*
+ * Send one instance and copy the answer to stdout
+ */
+static bool request(struct sockaddr_un *addr, instance_t *inst,
+                    double time_limit) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1 || connect(fd, (struct sockaddr *)addr, sizeof(*addr)) == -1) {
+    if (fd != -1) {
+      close(fd);
+    }
+    return false;
+  }
+
+  FILE *fp = fdopen(dup(fd), "w");
+  if (fp == NULL) {
+    close(fd);
+    return false;
+  }
+  if (time_limit >= 0) {
+    fprintf(fp, "time_limit %g\n", time_limit);
+  }
+  write_instance(fp, inst);
+  bool failed = fclose(fp) != 0 || shutdown(fd, SHUT_WR) == -1;
+
+  char buf[4096];
+  for (ssize_t n; !failed && (n = read(fd, buf, sizeof(buf))) != 0;) {
+    failed = n < 0 || fwrite(buf, 1, n, stdout) != (size_t)n;
+  }
+  close(fd);
+  return !failed;
+}
+
+int main(int argc, char **argv) {
+  char *opts = "hS:i:t:";
+  struct option options[] = {{"help", no_argument, NULL, 'h'},
+                             {"socket", required_argument, NULL, 'S'},
+                             {"input", required_argument, NULL, 'i'},
+                             {"time_limit", required_argument, NULL, 't'},
+                             {NULL, 0, NULL, 0}};
+
+  char *socket_path = NULL;
+  char *input = NULL;
+  double time_limit = -1;
+
+  for (int opt; (opt = getopt_long(argc, argv, opts, options, NULL)) != -1;) {
+    switch (opt) {
+    case 'h':
+      usage();
+      return EXIT_SUCCESS;
+    case 'S':
+      socket_path = optarg;
+      break;
+    case 'i':
+      input = optarg;
+      break;
+    case 't':
+      time_limit = strtod(optarg, NULL);
+      break;
+    default:
+      fprintf(stderr, "Unknown option: %c\n", opt);
+      return EXIT_FAILURE;
+    }
+  }
+  if (socket_path == NULL || input == NULL) {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", socket_path);
+    return EXIT_FAILURE;
+  }
+  strcpy(addr.sun_path, socket_path);
+
+  FILE *fp = strcmp(input, "-") == 0 ? stdin : fopen(input, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Failed to open file: %s\n", input);
+    return EXIT_FAILURE;
+  }
+
+  reader_t *reader = open_reader(fp);
+  int n_sent = 0;
+  int n_failed = 0;
+  double total_time = 0;
+  instance_t *inst;
+  for (int status; (status = read_next_instance(reader, &inst)) != 0;) {
+    if (status < 0) {
+      n_failed++;
+      continue;
+    }
+    double time = get_wall_time();
+    if (!request(&addr, inst, time_limit)) {
+      fprintf(stderr, "Request %d to %s failed\n", n_sent + n_failed,
+              socket_path);
+      n_failed++;
+      continue;
+    }
+    total_time += get_wall_time() - time;
+    n_sent++;
+    fflush(stdout);
+  }
+
+  close_reader(reader);
+  if (fp != stdin) {
+    fclose(fp);
+  }
+
+  fprintf(stderr, "Sent %d requests (%d failed), mean latency %.3f ms\n",
+          n_sent, n_failed, n_sent > 0 ? 1000 * total_time / n_sent : 0.0);
+  return n_sent > 0 && n_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "batch.h"
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(void) {
+  fprintf(stdout, "usage: main-convert -h\n");
+  fprintf(stdout, "usage: main-convert"
+                  " --input/-i input_file"
+                  " --output/-o output_file\n");
+  fprintf(stdout, "\t--input/-i: text file with one or more instances"
+                  " (- for stdin)\n");
+  fprintf(stdout, "\t--output/-o: binary batch file for main-solve\n");
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+  char *opts = "hi:o:";
+  struct option options[] = {{"help", no_argument, NULL, 'h'},
+                             {"input", required_argument, NULL, 'i'},
+                             {"output", required_argument, NULL, 'o'},
+                             {NULL, 0, NULL, 0}};
+
+  char *input = NULL;
+  char *output = NULL;
+
+  for (int opt; (opt = getopt_long(argc, argv, opts, options, NULL)) != -1;) {
+    switch (opt) {
+    case 'h':
+      usage();
+      return EXIT_SUCCESS;
+    case 'i':
+      input = optarg;
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    default:
+      fprintf(stderr, "Unknown option: %c\n", opt);
+      return EXIT_FAILURE;
+    }
+  }
+  if (input == NULL || output == NULL) {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  FILE *in = strcmp(input, "-") == 0 ? stdin : fopen(input, "r");
+  if (in == NULL) {
+    fprintf(stderr, "Failed to open file: %s\n", input);
+    return EXIT_FAILURE;
+  }
+  FILE *out = fopen(output, "wb");
+  if (out == NULL) {
+    fprintf(stderr, "Failed to open file: %s\n", output);
+    if (in != stdin) {
+      fclose(in);
+    }
+    return EXIT_FAILURE;
+  }
+
+  reader_t *reader = open_reader(in);
+  long n = write_batch(out, reader);
+  close_reader(reader);
+  if (in != stdin) {
+    fclose(in);
+  }
+  if (fclose(out) != 0) {
+    n = -1;
+  }
+
+  if (n < 0) {
+    fprintf(stderr, "Failed to write file: %s\n", output);
+    return EXIT_FAILURE;
+  }
+  fprintf(stdout, "Converted %ld instances from %s to %s\n", n, input, output);
+  return EXIT_SUCCESS;
+}
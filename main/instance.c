@@ -16,108 +16,271 @@
  */
 
 #include "instance.h"
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
 instance_t *malloc_instance(int n_stacks, int n_tiers) {
+  /*
+   * The states index the cells of a bay with int
+   */
+  size_t n_rows = (size_t)n_tiers + 1;
+  if (n_stacks < 1 || n_tiers < 1 || n_rows > INT_MAX / (size_t)n_stacks) {
+    return NULL;
+  }
+
   instance_t *inst = malloc(sizeof(instance_t));
   inst->n_stacks = n_stacks;
   inst->n_tiers = n_tiers;
-  inst->h = malloc(sizeof(int) * n_stacks);
-  inst->p = malloc(sizeof(int *) * n_stacks);
-  inst->p[0] = malloc(sizeof(int) * n_stacks * (n_tiers + 1));
-  for (int s = 1; s < n_stacks; s++) {
-    inst->p[s] = inst->p[0] + s * (n_tiers + 1);
+  inst->is_view = false;
+  inst->h = malloc(sizeof(int) * (size_t)n_stacks);
+  inst->p = malloc(sizeof(int *) * (size_t)n_stacks);
+  int *cells = malloc(sizeof(int) * (size_t)n_stacks * n_rows);
+  if (inst->h == NULL || inst->p == NULL || cells == NULL) {
+    free(inst->h);
+    free(inst->p);
+    free(cells);
+    free(inst);
+    return NULL;
+  }
+  for (int s = 0; s < n_stacks; s++) {
+    inst->p[s] = cells + (size_t)s * n_rows;
   }
   return inst;
 }
 
 void free_instance(instance_t *inst) {
-  free(inst->h);
-  free(inst->p[0]);
+  if (!inst->is_view) {
+    free(inst->h);
+    free(inst->p[0]);
+  }
   free(inst->p);
   free(inst);
 }
 
-static char *parse_int(char *iter, int *num) {
-  char *next;
-  *num = (int)strtol(iter, &next, 10);
-  return iter == next ? NULL : next;
+reader_t *open_reader(FILE *fp) {
+  reader_t *reader = malloc(sizeof(reader_t));
+  reader->fp = fp;
+  reader->cap = 1 << 16;
+  reader->buf = malloc(reader->cap);
+  reader->begin = 0;
+  reader->end = 0;
+  reader->line = 0;
+  reader->inst = NULL;
+  return reader;
 }
 
-instance_t *read_instance(char *input) {
-  FILE *fp = fopen(input, "r");
-  if (fp == NULL) {
-    fprintf(stderr, "Failed to open file: %s\n", input);
-    return NULL;
+reader_t *open_memory_reader(const char *data, size_t size) {
+  reader_t *reader = malloc(sizeof(reader_t));
+  reader->fp = NULL;
+  reader->cap = size;
+  reader->buf = (char *)data; // never written
+  reader->begin = 0;
+  reader->end = size;
+  reader->line = 0;
+  reader->inst = NULL;
+  return reader;
+}
+
+void close_reader(reader_t *reader) {
+  if (reader->fp != NULL) {
+    free(reader->buf);
+  }
+  if (reader->inst != NULL) {
+    free_instance(reader->inst);
   }
+  free(reader);
+}
 
-  char buf[BUFSIZ];
-  int line = 0;
-  char *iter;
+/*
+ * Get the next line that is neither blank nor a comment, refilling the buffer
+ * from the stream as needed, so lines of any length are read in full
+ */
+static bool next_line(reader_t *reader, const char **line, const char **end) {
+  while (true) {
+    char *iter = reader->buf + reader->begin;
+    char *stop = reader->buf + reader->end;
+    char *newline = memchr(iter, '\n', stop - iter);
 
-  do {
-    line++;
-    iter = fgets(buf, BUFSIZ, fp) + strspn(buf, " \t");
-  } while (*iter == '#' || *iter == '\0');
+    if (newline == NULL && reader->fp != NULL && !feof(reader->fp) &&
+        !ferror(reader->fp)) {
+      if (reader->begin > 0) {
+        memmove(reader->buf, iter, reader->end - reader->begin);
+        reader->end -= reader->begin;
+        reader->begin = 0;
+      } else if (reader->end == reader->cap) {
+        reader->cap *= 2;
+        reader->buf = realloc(reader->buf, reader->cap);
+      }
+      reader->end += fread(reader->buf + reader->end, 1,
+                           reader->cap - reader->end, reader->fp);
+      continue;
+    }
+    if (iter == stop) {
+      return false;
+    }
 
-  int n_stacks;
-  iter = parse_int(iter, &n_stacks);
-  if (iter == NULL) {
-    fprintf(stderr, "Failed to read n_stacks in line %d: %s\n", line, buf);
-    fclose(fp);
-    return NULL;
+    if (newline == NULL) {
+      newline = stop;
+    }
+    reader->begin = newline - reader->buf + (newline < stop);
+    reader->line++;
+
+    while (iter < newline && (*iter == ' ' || *iter == '\t')) {
+      iter++;
+    }
+    if (iter < newline && *iter != '#' && *iter != '\r') {
+      *line = iter;
+      *end = newline;
+      return true;
+    }
   }
-  int n_tiers;
-  iter = parse_int(iter, &n_tiers);
-  if (iter == NULL) {
-    fprintf(stderr, "Failed to read n_tiers in line %d: %s\n", line, buf);
-    fclose(fp);
-    return NULL;
+}
+
+static bool parse_int(const char **iter, const char *end, int *num) {
+  const char *c = *iter;
+  while (c < end && (*c == ' ' || *c == '\t' || *c == '\r')) {
+    c++;
+  }
+  bool negative = c < end && *c == '-';
+  if (c < end && (*c == '-' || *c == '+')) {
+    c++;
+  }
+  if (c == end || *c < '0' || *c > '9') {
+    return false;
+  }
+  long value = 0;
+  while (c < end && *c >= '0' && *c <= '9') {
+    value = value * 10 + (*c++ - '0');
+    if (value > INT_MAX) {
+      return false;
+    }
+  }
+  *num = negative ? (int)-value : (int)value;
+  *iter = c;
+  return true;
+}
+
+static bool at_line_end(const char *iter, const char *end) {
+  while (iter < end && (*iter == ' ' || *iter == '\t' || *iter == '\r')) {
+    iter++;
+  }
+  return iter == end;
+}
+
+int read_next_instance(reader_t *reader, instance_t **inst) {
+  const char *line;
+  const char *end;
+
+  if (!next_line(reader, &line, &end)) {
+    return 0;
   }
+
+  int n_stacks;
+  int n_tiers;
   int n_blocks;
-  iter = parse_int(iter, &n_blocks);
-  if (iter == NULL) {
-    fprintf(stderr, "Failed to read n_blocks in line %d: %s\n", line, buf);
-    fclose(fp);
-    return NULL;
+  if (!parse_int(&line, end, &n_stacks) || n_stacks < 1) {
+    fprintf(stderr, "Failed to read n_stacks in line %d\n", reader->line);
+    return -1;
+  }
+  if (!parse_int(&line, end, &n_tiers) || n_tiers < 1) {
+    fprintf(stderr, "Failed to read n_tiers in line %d\n", reader->line);
+    return -1;
+  }
+  if (!parse_int(&line, end, &n_blocks) || n_blocks < 0) {
+    fprintf(stderr, "Failed to read n_blocks in line %d\n", reader->line);
+    return -1;
   }
 
-  instance_t *inst = malloc_instance(n_stacks, n_tiers);
-  inst->n_blocks = n_blocks;
-  inst->max_prio = 0;
+  if (reader->inst == NULL || reader->inst->n_stacks != n_stacks ||
+      reader->inst->n_tiers != n_tiers) {
+    if (reader->inst != NULL) {
+      free_instance(reader->inst);
+    }
+    reader->inst = malloc_instance(n_stacks, n_tiers);
+    if (reader->inst == NULL) {
+      fprintf(stderr, "Failed to allocate a %d x %d bay in line %d\n",
+              n_stacks, n_tiers, reader->line);
+      return -1;
+    }
+  }
+  instance_t *curr = reader->inst;
+  curr->n_blocks = n_blocks;
+  curr->max_prio = 0;
 
+  /*
+   * Consume one line per stack even after an error, so that the next
+   * instance starts at its header line
+   */
+  bool failed = !at_line_end(line, end);
+  if (failed) {
+    fprintf(stderr, "Found extra tokens in line %d\n", reader->line);
+  }
+  long n_total = 0;
   for (int s = 0; s < n_stacks; s++) {
-    do {
-      line++;
-      iter = fgets(buf, BUFSIZ, fp) + strspn(buf, " \t");
-    } while (*iter == '#' || *iter == '\0');
-
-    iter = parse_int(iter, &inst->h[s]);
-    if (iter == NULL) {
-      fprintf(stderr, "Failed to read h[%d] in line %d: %s\n", s + 1, line,
-              buf);
-      fclose(fp);
-      free_instance(inst);
-      return NULL;
+    if (!next_line(reader, &line, &end)) {
+      fprintf(stderr, "Failed to read h[%d] at the end of input\n", s + 1);
+      return -1;
+    }
+    if (failed) {
+      continue;
     }
 
-    for (int t = 1; t <= inst->h[s]; t++) {
-      iter = parse_int(iter, &inst->p[s][t]);
-      if (iter == NULL) {
-        fprintf(stderr, "Failed to read p[%d][%d] in line %d: %s\n", s + 1, t,
-                line, buf);
-        fclose(fp);
-        free_instance(inst);
-        return NULL;
-      }
+    if (!parse_int(&line, end, &curr->h[s]) || curr->h[s] < 0 ||
+        curr->h[s] > n_tiers) {
+      fprintf(stderr, "Failed to read h[%d] in line %d\n", s + 1,
+              reader->line);
+      failed = true;
+      continue;
+    }
+    n_total += curr->h[s];
 
-      if (inst->max_prio < inst->p[s][t]) {
-        inst->max_prio = inst->p[s][t];
+    for (int t = 1; t <= curr->h[s]; t++) {
+      if (!parse_int(&line, end, &curr->p[s][t]) || curr->p[s][t] < 1) {
+        fprintf(stderr, "Failed to read p[%d][%d] in line %d\n", s + 1, t,
+                reader->line);
+        failed = true;
+        break;
+      }
+      if (curr->max_prio < curr->p[s][t]) {
+        curr->max_prio = curr->p[s][t];
       }
     }
+    if (!failed && !at_line_end(line, end)) {
+      fprintf(stderr, "Found extra tokens in line %d\n", reader->line);
+      failed = true;
+    }
   }
 
+  if (!failed && n_total != n_blocks) {
+    fprintf(stderr,
+            "Found %ld blocks instead of n_blocks = %d before line %d\n",
+            n_total, n_blocks, reader->line + 1);
+    failed = true;
+  }
+  if (failed) {
+    return -1;
+  }
+
+  *inst = curr;
+  return 1;
+}
+
+instance_t *read_instance(char *input) {
+  FILE *fp = fopen(input, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Failed to open file: %s\n", input);
+    return NULL;
+  }
+
+  reader_t *reader = open_reader(fp);
+  instance_t *inst = NULL;
+  if (read_next_instance(reader, &inst) == 1) {
+    reader->inst = NULL; // handed over to the caller
+  } else {
+    inst = NULL;
+  }
+  close_reader(reader);
   fclose(fp);
 
   return inst;
@@ -145,3 +308,14 @@ void print_instance(FILE *fp, instance_t *inst) {
   }
   fprintf(fp, "\n");
 }
+
+void write_instance(FILE *fp, instance_t *inst) {
+  fprintf(fp, "%d %d %d\n", inst->n_stacks, inst->n_tiers, inst->n_blocks);
+  for (int s = 0; s < inst->n_stacks; s++) {
+    fprintf(fp, "%d", inst->h[s]);
+    for (int t = 1; t <= inst->h[s]; t++) {
+      fprintf(fp, " %d", inst->p[s][t]);
+    }
+    fprintf(fp, "\n");
+  }
+}
@@ -18,15 +18,18 @@
 #ifndef INSTANCE_H
 #define INSTANCE_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 
-typedef struct {
+typedef struct instance {
   int n_stacks; // number of stacks, indexed from 0 to n_stacks - 1
   int n_tiers;  // number of tiers, indexed from 1 to n_tiers
   int n_blocks; // number of blocks
   int max_prio; // maximum priority
   int *h;       // height array
   int **p;      // priority matrix
+  bool is_view; // true if h and p[0] point into memory owned by others
 } instance_t;
 
 /**
@@ -34,7 +37,7 @@ typedef struct {
  *
  * @param n_stacks number of stacks
  * @param n_tiers number of tiers
- * @return created instance
+ * @return created instance or NULL if the sizes are invalid or too large
  */
 instance_t *malloc_instance(int n_stacks, int n_tiers);
 
@@ -45,6 +48,53 @@ instance_t *malloc_instance(int n_stacks, int n_tiers);
  */
 void free_instance(instance_t *inst);
 
+typedef struct {
+  FILE *fp;         // input stream, or NULL if reading from memory
+  char *buf;        // buffered data
+  size_t cap;       // capacity of the buffer
+  size_t begin;     // offset of the first unread byte
+  size_t end;       // offset past the last buffered byte
+  int line;         // number of the last line read
+  instance_t *inst; // instance reused between reads
+} reader_t;
+
+/**
+ * Create a reader of instances from a stream
+ *
+ * @param fp input stream
+ * @return created reader
+ */
+reader_t *open_reader(FILE *fp);
+
+/**
+ * Create a reader of instances from a memory buffer, which must stay valid
+ * and unchanged while the reader is used
+ *
+ * @param data the buffer
+ * @param size size of the buffer in bytes
+ * @return created reader
+ */
+reader_t *open_memory_reader(const char *data, size_t size);
+
+/**
+ * Free the space of a reader, including its instance; the stream is not closed
+ *
+ * @param reader the reader
+ */
+void close_reader(reader_t *reader);
+
+/**
+ * Read the next instance. A malformed instance is reported and skipped as a
+ * whole, so reading can continue with the instance after it.
+ *
+ * @param reader the reader
+ * @param inst set to the instance read, which is owned by the reader and only
+ * valid until the next read
+ * @return 1 if an instance is read, 0 at the end of input, or -1 if a
+ * malformed instance is skipped
+ */
+int read_next_instance(reader_t *reader, instance_t **inst);
+
 /**
  * Read an instance from file
  *
@@ -61,4 +111,12 @@ instance_t *read_instance(char *input);
  */
 void print_instance(FILE *fp, instance_t *inst);
 
+/**
+ * Write an instance in the input format
+ *
+ * @param fp output stream
+ * @param inst the instance
+ */
+void write_instance(FILE *fp, instance_t *inst);
+
 #endif
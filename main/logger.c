@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "logger.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+struct logger {
+  FILE *fp;              // output stream
+  log_event_t *events;   // ring buffer of queued events
+  int capacity;          // capacity of the ring buffer
+  long n_logged;         // number of events queued so far
+  long n_printed;        // number of events printed and flushed so far
+  long n_dropped;        // number of events dropped on a full buffer
+  bool closed;           // true if the thread should finish
+  pthread_t thread;      // background thread
+  pthread_mutex_t mutex; // protects the fields above
+  pthread_cond_t queued; // signaled when an event is queued or on close
+  pthread_cond_t done;   // signaled when events are printed
+};
+
+void print_event(FILE *fp, log_event_t *event) {
+  fprintf(fp,
+          "[%s] best_lb = %d @ %.3f / best_ub = %d @ %.3f / time = %.3f / "
+          "nodes = %ld / probe = %ld / skip = %ld / cache = %ld/%ld\n",
+          event->status, event->best_lb, event->time_to_best_lb,
+          event->best_ub, event->time_to_best_ub, event->time, event->n_nodes,
+          event->n_probe, event->n_probe_skip, event->n_cache_hit,
+          event->n_cache_lookup);
+}
+
+static void *run_logger(void *arg) {
+  logger_t *logger = arg;
+  pthread_mutex_lock(&logger->mutex);
+  for (;;) {
+    bool idle = logger->n_printed == logger->n_logged && logger->n_dropped == 0;
+    if (idle && logger->closed) {
+      break;
+    }
+    if (idle) {
+      pthread_cond_wait(&logger->queued, &logger->mutex);
+      continue;
+    }
+
+    /*
+     * Print without holding the lock, so that logging does not wait for the
+     * stream; slots are not reused before n_printed moves past them
+     */
+    long begin = logger->n_printed;
+    long end = logger->n_logged;
+    long n_dropped = logger->n_dropped;
+    logger->n_dropped = 0;
+    pthread_mutex_unlock(&logger->mutex);
+    if (n_dropped > 0) {
+      fprintf(logger->fp, "[log] %ld events dropped\n", n_dropped);
+    }
+    for (long i = begin; i < end; i++) {
+      print_event(logger->fp, &logger->events[i % logger->capacity]);
+    }
+    fflush(logger->fp);
+    pthread_mutex_lock(&logger->mutex);
+
+    logger->n_printed = end;
+    pthread_cond_broadcast(&logger->done);
+  }
+  pthread_mutex_unlock(&logger->mutex);
+  return NULL;
+}
+
+logger_t *open_logger(FILE *fp, int capacity) {
+  logger_t *logger = malloc(sizeof(logger_t));
+  logger->fp = fp;
+  logger->capacity = capacity > 0 ? capacity : 1;
+  logger->events = malloc(sizeof(log_event_t) * logger->capacity);
+  logger->n_logged = 0;
+  logger->n_printed = 0;
+  logger->n_dropped = 0;
+  logger->closed = false;
+  pthread_mutex_init(&logger->mutex, NULL);
+  pthread_cond_init(&logger->queued, NULL);
+  pthread_cond_init(&logger->done, NULL);
+  pthread_create(&logger->thread, NULL, run_logger, logger);
+  return logger;
+}
+
+void close_logger(logger_t *logger) {
+  pthread_mutex_lock(&logger->mutex);
+  logger->closed = true;
+  pthread_cond_signal(&logger->queued);
+  pthread_mutex_unlock(&logger->mutex);
+  pthread_join(logger->thread, NULL);
+
+  pthread_mutex_destroy(&logger->mutex);
+  pthread_cond_destroy(&logger->queued);
+  pthread_cond_destroy(&logger->done);
+  free(logger->events);
+  free(logger);
+}
+
+void log_event(logger_t *logger, log_event_t *event) {
+  pthread_mutex_lock(&logger->mutex);
+  if (logger->n_logged - logger->n_printed == logger->capacity) {
+    logger->n_dropped++;
+  } else {
+    logger->events[logger->n_logged++ % logger->capacity] = *event;
+  }
+  pthread_cond_signal(&logger->queued);
+  pthread_mutex_unlock(&logger->mutex);
+}
+
+void flush_logger(logger_t *logger) {
+  pthread_mutex_lock(&logger->mutex);
+  while (logger->n_printed < logger->n_logged) {
+    pthread_cond_wait(&logger->done, &logger->mutex);
+  }
+  pthread_mutex_unlock(&logger->mutex);
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdio.h>
+
+typedef struct {
+  const char *status;     // event name, e.g. "update" or "deepen"
+  int best_lb;            // best lower bound
+  int best_ub;            // best upper bound
+  double time_to_best_lb; // time to the best lower bound
+  double time_to_best_ub; // time to the best upper bound
+  double time;            // time elapsed
+  long n_nodes;           // number of nodes explored
+  long n_probe;           // number of nodes probed
+  long n_probe_skip;      // number of nodes whose probing was skipped
+  long n_cache_lookup;    // number of probe cache lookups
+  long n_cache_hit;       // number of probe cache hits
+} log_event_t;
+
+typedef struct logger logger_t;
+
+/**
+ * Start a background thread that prints logged events to a stream, so that
+ * logging never waits for the stream
+ *
+ * @param fp output stream
+ * @param capacity number of events buffered; more events are dropped
+ * @return created logger
+ */
+logger_t *open_logger(FILE *fp, int capacity);
+
+/**
+ * Print the remaining events and stop the background thread
+ *
+ * @param logger the logger
+ */
+void close_logger(logger_t *logger);
+
+/**
+ * Queue an event to be printed
+ *
+ * @param logger the logger
+ * @param event the event, which is copied
+ */
+void log_event(logger_t *logger, log_event_t *event);
+
+/**
+ * Wait until all queued events are printed and flushed
+ *
+ * @param logger the logger
+ */
+void flush_logger(logger_t *logger);
+
+/**
+ * Print an event as one line
+ *
+ * @param fp output stream
+ * @param event the event
+ */
+void print_event(FILE *fp, log_event_t *event);
+
+#endif
@@ -19,15 +19,16 @@
 #include <limits.h>
 #include <string.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LB_TS_X86
+#include <immintrin.h>
+#endif
+
 /*
  * LB-TS
  */
 
-int lb_ts(state_t *state, int max_k, int *h) {
-  if (state->n_bad == 0 || max_k == 0 || has_empty_stack(state)) {
-    return state->n_bad;
-  }
-
+static int lb_ts_scalar(state_t *state, int max_k, int *h) {
   int n_stacks = state->n_stacks;
   int n_tiers = state->n_tiers;
   int **p = state->p; // p[s][t]: priority
@@ -105,3 +106,386 @@ int lb_ts(state_t *state, int max_k, int *h) {
     }
   }
 }
+
+/*
+ * LB-TS on dense vectors of the blocks on top of the stacks, h, tp, tq and tb,
+ * each of n_pad >= n_stacks entries, in which padding never takes part:
+ * h = INT_MAX, tp = tq = INT_MAX and tb = 0.
+ *
+ * Within a layer, lb_ts_scalar peels blocks until none has priority q_min or
+ * is badly placed with priority at most q_max. Peeling a block never makes
+ * another block unpeelable, as q_min and q_max only grow and a stack of
+ * priority q_min on top keeps q_min from growing, so the blocks peeled, and
+ * hence the value, do not depend on the order of peeling. The kernels below
+ * peel every peelable block at once in rounds, 4 or 8 stacks per instruction.
+ */
+#ifdef LB_TS_X86
+
+enum { PEEL_NONE, PEEL_SOME, PEEL_END };
+
+typedef struct {
+  int n_stacks; // number of stacks
+  int n_tiers;  // number of tiers
+  int n_pad;    // length of the vectors, a multiple of 8
+  int stride;   // distance between stacks in p[0], q[0] and b[0]
+  int *p;       // p[0] of the state
+  int *q;       // q[0] of the state
+  int *b;       // b[0] of the state
+  int *h;       // height of each stack
+  int *tp;      // priority on top of each stack
+  int *tq;      // quality on top of each stack
+  int *tb;      // badness on top of each stack
+} tops_t;
+
+static inline void load_top(tops_t *tops, int s) {
+  int i = s * tops->stride + tops->h[s];
+  tops->tp[s] = tops->p[i];
+  tops->tq[s] = tops->q[i];
+  tops->tb[s] = tops->b[i];
+}
+
+static bool init_tops(tops_t *tops, state_t *state, int *temp) {
+  int n_stacks = state->n_stacks;
+  int stride = state->n_tiers + 1;
+  if (state->p[n_stacks - 1] != state->p[0] + (n_stacks - 1) * stride ||
+      state->q[n_stacks - 1] != state->q[0] + (n_stacks - 1) * stride ||
+      state->b[n_stacks - 1] != state->b[0] + (n_stacks - 1) * stride) {
+    return false; // rows are not evenly spaced
+  }
+  tops->n_stacks = n_stacks;
+  tops->n_tiers = state->n_tiers;
+  tops->n_pad = (n_stacks + 7) & ~7;
+  tops->stride = stride;
+  tops->p = state->p[0];
+  tops->q = state->q[0];
+  tops->b = state->b[0];
+  tops->h = temp;
+  tops->tp = tops->h + tops->n_pad;
+  tops->tq = tops->tp + tops->n_pad;
+  tops->tb = tops->tq + tops->n_pad;
+  for (int s = 0; s < n_stacks; s++) {
+    tops->h[s] = state->h[s];
+    load_top(tops, s);
+  }
+  for (int s = n_stacks; s < tops->n_pad; s++) {
+    tops->h[s] = INT_MAX;
+    tops->tp[s] = INT_MAX;
+    tops->tq[s] = INT_MAX;
+    tops->tb[s] = 0;
+  }
+  return true;
+}
+
+/*
+ * Peel the blocks of a block of stacks given by masks of lanes: those of
+ * priority q_min, which raise q_max, and the badly-placed ones
+ */
+static inline int peel_lanes(tops_t *tops, int s, int min_mask, int bad_mask,
+                             int *q_max, int *remain) {
+  *remain -= __builtin_popcount(bad_mask);
+  for (int mask = min_mask | bad_mask; mask != 0; mask &= mask - 1) {
+    int v = s + __builtin_ctz(mask);
+    if (--tops->h[v] == 0) {
+      return PEEL_END;
+    }
+    load_top(tops, v);
+  }
+  for (int mask = min_mask; mask != 0; mask &= mask - 1) {
+    int v = s + __builtin_ctz(mask);
+    if (*q_max < tops->tq[v]) {
+      *q_max = tops->tq[v];
+    }
+  }
+  return PEEL_SOME;
+}
+
+/*
+ * Kernels for one instruction set:
+ * - reduce: the smallest quality on top of a stack and, if q_max is not NULL,
+ *   the largest on top of a stack that is not full
+ * - peel: one round of peeling, which returns PEEL_NONE if no block is
+ *   peelable, or PEEL_END if the bound is reached
+ * - peel_layer: remove the top layer, and return true if the bound is reached
+ */
+typedef void (*reduce_fn)(tops_t *tops, int *q_min, int *q_max);
+typedef int (*peel_fn)(tops_t *tops, int q_min, int *q_max, int *remain,
+                       bool *min_peeled);
+typedef bool (*peel_layer_fn)(tops_t *tops, int *remain);
+
+static inline __attribute__((always_inline)) int
+lb_ts_dense(state_t *state, int max_k, tops_t *tops, reduce_fn reduce,
+            peel_fn peel, peel_layer_fn peel_layer) {
+  int remain = state->n_bad;
+  int k = 0;
+  while (true) {
+    int q_min;
+    int q_max;
+    reduce(tops, &q_min, &q_max);
+    while (true) {
+      bool min_peeled = false;
+      int status = peel(tops, q_min, &q_max, &remain, &min_peeled);
+      if (status == PEEL_NONE) {
+        break;
+      }
+      if (status == PEEL_END || remain <= 0) {
+        return state->n_bad + k;
+      }
+      if (min_peeled) {
+        reduce(tops, &q_min, NULL);
+      }
+    }
+    if (++k == max_k || peel_layer(tops, &remain)) {
+      return state->n_bad + k;
+    }
+  }
+}
+
+/*
+ * SSE4.1
+ */
+#define SSE4 __attribute__((target("sse4.1")))
+
+static inline SSE4 __m128i load_sse4(const int *x) {
+  return _mm_loadu_si128((const __m128i *)x);
+}
+
+static inline SSE4 int mask_sse4(__m128i x) {
+  return _mm_movemask_ps(_mm_castsi128_ps(x));
+}
+
+static inline SSE4 void reduce_sse4(tops_t *tops, int *q_min, int *q_max) {
+  __m128i min_q = _mm_set1_epi32(INT_MAX);
+  __m128i max_q = _mm_setzero_si128();
+  __m128i n_tiers = _mm_set1_epi32(tops->n_tiers);
+  for (int s = 0; s < tops->n_pad; s += 4) {
+    __m128i tq = load_sse4(tops->tq + s);
+    min_q = _mm_min_epi32(min_q, tq);
+    __m128i open = _mm_cmpgt_epi32(n_tiers, load_sse4(tops->h + s));
+    max_q = _mm_max_epi32(max_q, _mm_and_si128(open, tq));
+  }
+  min_q = _mm_min_epi32(min_q, _mm_shuffle_epi32(min_q, 0x4e));
+  min_q = _mm_min_epi32(min_q, _mm_shuffle_epi32(min_q, 0xb1));
+  *q_min = _mm_cvtsi128_si32(min_q);
+  if (q_max != NULL) {
+    max_q = _mm_max_epi32(max_q, _mm_shuffle_epi32(max_q, 0x4e));
+    max_q = _mm_max_epi32(max_q, _mm_shuffle_epi32(max_q, 0xb1));
+    *q_max = _mm_cvtsi128_si32(max_q);
+  }
+}
+
+static inline SSE4 int peel_sse4(tops_t *tops, int q_min, int *q_max,
+                                 int *remain, bool *min_peeled) {
+  __m128i q = _mm_set1_epi32(q_min);
+  __m128i q_bad = _mm_set1_epi32(*q_max);
+  __m128i zero = _mm_setzero_si128();
+  int status = PEEL_NONE;
+  for (int s = 0; s < tops->n_pad; s += 4) {
+    __m128i tp = load_sse4(tops->tp + s);
+    __m128i bad = _mm_cmpgt_epi32(load_sse4(tops->tb + s), zero);
+    int min_mask = mask_sse4(_mm_cmpeq_epi32(tp, q));
+    int bad_mask =
+        mask_sse4(_mm_andnot_si128(_mm_cmpgt_epi32(tp, q_bad), bad));
+    if ((min_mask | bad_mask) != 0) {
+      *min_peeled = *min_peeled || min_mask != 0;
+      if ((status = peel_lanes(tops, s, min_mask, bad_mask, q_max,
+                               remain)) == PEEL_END) {
+        break;
+      }
+    }
+  }
+  return status;
+}
+
+static inline SSE4 bool peel_layer_sse4(tops_t *tops, int *remain) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i one = _mm_set1_epi32(1);
+  __m128i n_bad = zero;
+  __m128i last = zero;
+  for (int s = 0; s < tops->n_pad; s += 4) {
+    n_bad = _mm_sub_epi32(n_bad,
+                          _mm_cmpgt_epi32(load_sse4(tops->tb + s), zero));
+    last = _mm_or_si128(last, _mm_cmpeq_epi32(load_sse4(tops->h + s), one));
+  }
+  n_bad = _mm_add_epi32(n_bad, _mm_shuffle_epi32(n_bad, 0x4e));
+  n_bad = _mm_add_epi32(n_bad, _mm_shuffle_epi32(n_bad, 0xb1));
+  if (_mm_cvtsi128_si32(n_bad) >= *remain || mask_sse4(last) != 0) {
+    return true;
+  }
+  *remain -= _mm_cvtsi128_si32(n_bad);
+  for (int s = 0; s < tops->n_stacks; s++) {
+    tops->h[s]--;
+    load_top(tops, s);
+  }
+  return false;
+}
+
+static SSE4 int lb_ts_sse4(state_t *state, int max_k, int *temp) {
+  tops_t tops;
+  if (!init_tops(&tops, state, temp)) {
+    return lb_ts_scalar(state, max_k, temp);
+  }
+  return lb_ts_dense(state, max_k, &tops, reduce_sse4, peel_sse4,
+                     peel_layer_sse4);
+}
+
+/*
+ * AVX2
+ */
+#define AVX2 __attribute__((target("avx2")))
+
+static inline AVX2 __m256i load_avx2(const int *x) {
+  return _mm256_loadu_si256((const __m256i *)x);
+}
+
+static inline AVX2 int mask_avx2(__m256i x) {
+  return _mm256_movemask_ps(_mm256_castsi256_ps(x));
+}
+
+static inline AVX2 void reduce_avx2(tops_t *tops, int *q_min, int *q_max) {
+  __m256i min_q = _mm256_set1_epi32(INT_MAX);
+  __m256i max_q = _mm256_setzero_si256();
+  __m256i n_tiers = _mm256_set1_epi32(tops->n_tiers);
+  for (int s = 0; s < tops->n_pad; s += 8) {
+    __m256i tq = load_avx2(tops->tq + s);
+    min_q = _mm256_min_epi32(min_q, tq);
+    __m256i open = _mm256_cmpgt_epi32(n_tiers, load_avx2(tops->h + s));
+    max_q = _mm256_max_epi32(max_q, _mm256_and_si256(open, tq));
+  }
+  __m128i x = _mm_min_epi32(_mm256_castsi256_si128(min_q),
+                            _mm256_extracti128_si256(min_q, 1));
+  x = _mm_min_epi32(x, _mm_shuffle_epi32(x, 0x4e));
+  x = _mm_min_epi32(x, _mm_shuffle_epi32(x, 0xb1));
+  *q_min = _mm_cvtsi128_si32(x);
+  if (q_max != NULL) {
+    __m128i y = _mm_max_epi32(_mm256_castsi256_si128(max_q),
+                              _mm256_extracti128_si256(max_q, 1));
+    y = _mm_max_epi32(y, _mm_shuffle_epi32(y, 0x4e));
+    y = _mm_max_epi32(y, _mm_shuffle_epi32(y, 0xb1));
+    *q_max = _mm_cvtsi128_si32(y);
+  }
+}
+
+static inline AVX2 int peel_avx2(tops_t *tops, int q_min, int *q_max,
+                                 int *remain, bool *min_peeled) {
+  __m256i q = _mm256_set1_epi32(q_min);
+  __m256i q_bad = _mm256_set1_epi32(*q_max);
+  __m256i zero = _mm256_setzero_si256();
+  int status = PEEL_NONE;
+  for (int s = 0; s < tops->n_pad; s += 8) {
+    __m256i tp = load_avx2(tops->tp + s);
+    __m256i bad = _mm256_cmpgt_epi32(load_avx2(tops->tb + s), zero);
+    int min_mask = mask_avx2(_mm256_cmpeq_epi32(tp, q));
+    int bad_mask =
+        mask_avx2(_mm256_andnot_si256(_mm256_cmpgt_epi32(tp, q_bad), bad));
+    if ((min_mask | bad_mask) != 0) {
+      *min_peeled = *min_peeled || min_mask != 0;
+      if ((status = peel_lanes(tops, s, min_mask, bad_mask, q_max,
+                               remain)) == PEEL_END) {
+        break;
+      }
+    }
+  }
+  return status;
+}
+
+static inline AVX2 bool peel_layer_avx2(tops_t *tops, int *remain) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i one = _mm256_set1_epi32(1);
+  __m256i n_bad = zero;
+  __m256i last = zero;
+  for (int s = 0; s < tops->n_pad; s += 8) {
+    n_bad = _mm256_sub_epi32(
+        n_bad, _mm256_cmpgt_epi32(load_avx2(tops->tb + s), zero));
+    last = _mm256_or_si256(last,
+                           _mm256_cmpeq_epi32(load_avx2(tops->h + s), one));
+  }
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(n_bad),
+                              _mm256_extracti128_si256(n_bad, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+  if (_mm_cvtsi128_si32(sum) >= *remain || mask_avx2(last) != 0) {
+    return true;
+  }
+  *remain -= _mm_cvtsi128_si32(sum);
+
+  /*
+   * Gather the new tops of all stacks but the padding
+   */
+  __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  __m256i stride = _mm256_set1_epi32(tops->stride);
+  __m256i n_stacks = _mm256_set1_epi32(tops->n_stacks);
+  for (int s = 0; s < tops->n_pad; s += 8) {
+    __m256i index = _mm256_add_epi32(lane, _mm256_set1_epi32(s));
+    __m256i real = _mm256_cmpgt_epi32(n_stacks, index);
+    __m256i h = _mm256_add_epi32(load_avx2(tops->h + s), real);
+    __m256i cell = _mm256_add_epi32(_mm256_mullo_epi32(index, stride), h);
+    _mm256_storeu_si256((__m256i *)(tops->h + s), h);
+    _mm256_storeu_si256(
+        (__m256i *)(tops->tp + s),
+        _mm256_mask_i32gather_epi32(load_avx2(tops->tp + s), tops->p, cell,
+                                    real, 4));
+    _mm256_storeu_si256(
+        (__m256i *)(tops->tq + s),
+        _mm256_mask_i32gather_epi32(load_avx2(tops->tq + s), tops->q, cell,
+                                    real, 4));
+    _mm256_storeu_si256(
+        (__m256i *)(tops->tb + s),
+        _mm256_mask_i32gather_epi32(load_avx2(tops->tb + s), tops->b, cell,
+                                    real, 4));
+  }
+  return false;
+}
+
+static AVX2 int lb_ts_avx2(state_t *state, int max_k, int *temp) {
+  tops_t tops;
+  if (!init_tops(&tops, state, temp)) {
+    return lb_ts_scalar(state, max_k, temp);
+  }
+  return lb_ts_dense(state, max_k, &tops, reduce_avx2, peel_avx2,
+                     peel_layer_avx2);
+}
+
+#endif
+
+/*
+ * Dispatch
+ */
+static int lb_ts_kernel = LB_TS_SCALAR;
+
+#ifdef LB_TS_X86
+static void __attribute__((constructor)) init_lb_ts_kernel(void) {
+  __builtin_cpu_init();
+  select_lb_ts_kernel(LB_TS_AVX2);
+}
+#endif
+
+int select_lb_ts_kernel(int kernel) {
+#ifdef LB_TS_X86
+  if (kernel == LB_TS_AVX2 && !__builtin_cpu_supports("avx2")) {
+    kernel = LB_TS_SSE4;
+  }
+  if (kernel == LB_TS_SSE4 && !__builtin_cpu_supports("sse4.1")) {
+    kernel = LB_TS_SCALAR;
+  }
+#else
+  kernel = LB_TS_SCALAR;
+#endif
+  return lb_ts_kernel = kernel;
+}
+
+int lb_ts_temp_size(int n_stacks) { return 4 * ((n_stacks + 7) & ~7); }
+
+int lb_ts(state_t *state, int max_k, int *temp) {
+  if (state->n_bad == 0 || max_k == 0 || has_empty_stack(state)) {
+    return state->n_bad;
+  }
+#ifdef LB_TS_X86
+  switch (lb_ts_kernel) {
+  case LB_TS_AVX2:
+    return lb_ts_avx2(state, max_k, temp);
+  case LB_TS_SSE4:
+    return lb_ts_sse4(state, max_k, temp);
+  }
+#endif
+  return lb_ts_scalar(state, max_k, temp);
+}
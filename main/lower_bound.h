@@ -20,14 +20,33 @@
 
 #include "state.h"
 
+enum { LB_TS_SCALAR, LB_TS_SSE4, LB_TS_AVX2 };
+
 /**
  * Compute the value of LB-TS
  *
  * @param state the state
  * @param max_k maximum allowed number of blocking layers
- * @param h temporary array
+ * @param temp temporary array of lb_ts_temp_size(n_stacks) entries
  * @return LB-TS
  */
-int lb_ts(state_t *state, int max_k, int *h);
+int lb_ts(state_t *state, int max_k, int *temp);
+
+/**
+ * Get the size of the temporary array of lb_ts
+ *
+ * @param n_stacks number of stacks
+ * @return number of entries
+ */
+int lb_ts_temp_size(int n_stacks);
+
+/**
+ * Select the kernel of lb_ts for all threads. The best kernel the CPU
+ * supports is selected at startup; all kernels give the same values.
+ *
+ * @param kernel LB_TS_SCALAR, LB_TS_SSE4 or LB_TS_AVX2
+ * @return the kernel selected, which falls back to one the CPU supports
+ */
+int select_lb_ts_kernel(int kernel);
 
 #endif
@@ -17,6 +17,8 @@
 
 #include "move.h"
 #include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
 
 void print_moves(FILE *fp, move_t *path, int len) {
   if (len == INT_MAX) {
@@ -30,3 +32,85 @@ void print_moves(FILE *fp, move_t *path, int len) {
     fprintf(fp, "]\n");
   }
 }
+
+/*
+ * Tokens of move lists, read with getc since fscanf dominates the time of
+ * checking many solutions
+ */
+static int next_char(FILE *fp) {
+  int c;
+  while ((c = getc_unlocked(fp)) == ' ' || c == '\t' || c == '\r' ||
+         c == '\n') {
+  }
+  return c;
+}
+
+static bool expect(FILE *fp, const char *token) {
+  if (next_char(fp) != *token) {
+    return false;
+  }
+  while (*++token != '\0') {
+    if (getc_unlocked(fp) != *token) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool read_int(FILE *fp, int *x) {
+  int c = next_char(fp);
+  bool negative = c == '-';
+  if (negative) {
+    c = getc_unlocked(fp);
+  }
+  if (c < '0' || c > '9') {
+    return false;
+  }
+  long value = 0;
+  for (; c >= '0' && c <= '9'; c = getc_unlocked(fp)) {
+    value = value * 10 + (c - '0');
+    if (value > INT_MAX) {
+      return false;
+    }
+  }
+  ungetc(c, fp);
+  *x = negative ? -(int)value : (int)value;
+  return true;
+}
+
+move_t *read_moves(FILE *fp, int *len) {
+  if (!expect(fp, "[")) {
+    return NULL;
+  }
+
+  int cap = 64;
+  move_t *path = malloc(sizeof(move_t) * cap);
+  *len = 0;
+  for (;;) {
+    int c = next_char(fp);
+    if (c == ']') {
+      return path;
+    }
+    if (*len > 0) {
+      if (c != ',') {
+        break;
+      }
+      c = next_char(fp);
+    }
+
+    move_t move;
+    if (c != '(' || !read_int(fp, &move.p) || !expect(fp, ":") ||
+        !read_int(fp, &move.s) || !expect(fp, "->") ||
+        !read_int(fp, &move.d) || !expect(fp, ")")) {
+      break;
+    }
+    if (*len == cap) {
+      cap *= 2;
+      path = realloc(path, sizeof(move_t) * cap);
+    }
+    path[(*len)++] = move;
+  }
+
+  free(path);
+  return NULL;
+}
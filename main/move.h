@@ -35,4 +35,13 @@ typedef struct {
  */
 void print_moves(FILE *fp, move_t *path, int len);
 
+/**
+ * Read moves in the format of print_moves
+ *
+ * @param fp input stream
+ * @param len set to the number of moves read
+ * @return created array of moves or NULL if the input is malformed
+ */
+move_t *read_moves(FILE *fp, int *len);
+
 #endif
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "param.h"
+#include <unistd.h>
+
+void init_param(param_t *param) {
+  long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  param->time_limit = 1800;
+  param->n_threads = n_cpus > 0 ? (int)n_cpus : 1;
+  param->beam_width = 0;
+  param->n_restarts = 0;
+  param->restart_time = 1.0;
+  param->seed = 1;
+  param->heuristic_only = false;
+  param->probe_policy = PROBE_ALWAYS;
+  param->probe_threshold = 64;
+  param->probe_cache_size = 1 << 16;
+  param->log_level = LOG_NORMAL;
+  param->logger = NULL;
+  param->progress = NULL;
+  param->progress_data = NULL;
+  param->heartbeat_nodes = 1000000;
+  param->initial_sol = NULL;
+  param->initial_len = 0;
+  param->specialized = true;
+  param->calibration_nodes = 0;
+  param->check_profile = NULL;
+  param->lazy_order = false;
+  param->engine = ENGINE_IDBB;
+  param->node_memory = 1024;
+}
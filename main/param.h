@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARAM_H
+#define PARAM_H
+
+#include "logger.h"
+#include "move.h"
+#include <stdbool.h>
+
+enum { ENGINE_IDBB, ENGINE_ASTAR, ENGINE_FRINGE };
+enum { PROBE_ALWAYS, PROBE_ADAPTIVE };
+enum { LOG_QUIET, LOG_NORMAL, LOG_PROGRESS };
+enum { PROGRESS_START, PROGRESS_UPDATE, PROGRESS_DEEPEN, PROGRESS_HEARTBEAT };
+
+typedef struct progress {
+  int type;               // PROGRESS_START, PROGRESS_UPDATE, ...
+  int best_lb;            // best lower bound
+  int best_ub;            // best upper bound
+  const move_t *best_sol; // best solution, only valid during the callback
+  double time;            // time elapsed in seconds
+  long n_nodes;           // number of nodes explored
+} progress_t;
+
+/**
+ * Callback on the progress of iterative deepening, which fires once at the
+ * start, on every improved upper bound, on every deepening and every
+ * heartbeat_nodes nodes
+ *
+ * @param progress the progress
+ * @param data user data given in the parameters
+ * @return true to stop the search and report the best solution so far
+ */
+typedef bool (*progress_fn)(const progress_t *progress, void *data);
+
+typedef struct param {
+  double time_limit;   // wall-clock time limit in seconds
+  int n_threads;       // number of worker threads
+  int beam_width;      // beam width for the initial upper bound (0 to disable)
+  int n_restarts;      // number of randomized restarts (0 to disable)
+  double restart_time; // wall-clock time limit of the restarts in seconds
+  unsigned seed;       // random seed of the restarts
+  bool heuristic_only; // true if skipping iterative deepening
+  int probe_policy;    // PROBE_ALWAYS or PROBE_ADAPTIVE
+  int probe_threshold; // misses in a row before adaptive probing backs off
+  int probe_cache_size; // entries of the probe cache (0 to disable)
+  int log_level;        // LOG_QUIET, LOG_NORMAL or LOG_PROGRESS
+  logger_t *logger;     // sink of progress events, or NULL to print them
+  progress_fn progress; // progress callback, or NULL
+  void *progress_data;  // user data passed to the progress callback
+  long heartbeat_nodes; // nodes between heartbeats, and between time limit
+                        // checks if fewer than 1000
+  move_t *initial_sol;  // incumbent to start from instead of JZW and SM-2
+  int initial_len;      // number of moves of initial_sol
+  bool specialized;     // true to search with the kernel built for the bay
+                        // shape, if any
+  long calibration_nodes;    // nodes to time the dominance checks before
+                             // ordering them (0 to keep the rule order)
+  const char *check_profile; // file to load the dominance check order from,
+                             // or to record it in, or NULL
+  bool lazy_order;  // true to sort the stacks of a child only once expanded
+  int engine;       // ENGINE_IDBB, ENGINE_ASTAR or ENGINE_FRINGE
+  int node_memory;  // megabytes of nodes stored by ENGINE_ASTAR or
+                    // ENGINE_FRINGE before they fall back to iterative
+                    // deepening
+} param_t;
+
+/**
+ * Initialize parameters with default values
+ *
+ * @param param the parameters
+ */
+void init_param(param_t *param);
+
+#endif
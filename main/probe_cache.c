@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "probe_cache.h"
+#include <stdlib.h>
+
+probe_cache_t *malloc_probe_cache(int size) {
+  probe_cache_t *cache = malloc(sizeof(probe_cache_t));
+  cache->size = 1;
+  while (cache->size <= size / 2) {
+    cache->size *= 2;
+  }
+  cache->entries = calloc(cache->size, sizeof(probe_entry_t));
+  clear_probe_cache(cache);
+  return cache;
+}
+
+void clear_probe_cache(probe_cache_t *cache) {
+  for (int i = 0; i < cache->size; i++) {
+    cache->entries[i].key = ~(uint64_t)i; // never maps to slot i
+  }
+}
+
+void free_probe_cache(probe_cache_t *cache) {
+  free(cache->entries);
+  free(cache);
+}
+
+probe_entry_t *find_probe_entry(probe_cache_t *cache, uint64_t key) {
+  probe_entry_t *entry = &cache->entries[key & (uint64_t)(cache->size - 1)];
+  if (entry->key != key) {
+    entry->key = key;
+    entry->min_len[0] = 0;
+    entry->min_len[1] = 0;
+    entry->exact[0] = false;
+    entry->exact[1] = false;
+  }
+  return entry;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROBE_CACHE_H
+#define PROBE_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+  uint64_t key;   // hash of the probed state
+  int min_len[2]; // min_len[k]: lower bound on the moves needed by heuristic k
+  bool exact[2];  // exact[k]: true if min_len[k] was achieved by heuristic k
+} probe_entry_t;
+
+typedef struct {
+  int size;               // number of entries, a power of two
+  probe_entry_t *entries; // direct-mapped entries
+} probe_cache_t;
+
+/**
+ * Create space for a cache of heuristic outcomes
+ *
+ * @param size number of entries, rounded down to a power of two
+ * @return created cache
+ */
+probe_cache_t *malloc_probe_cache(int size);
+
+/**
+ * Forget all entries of a cache of heuristic outcomes
+ *
+ * @param cache the cache
+ */
+void clear_probe_cache(probe_cache_t *cache);
+
+/**
+ * Free the space of a cache of heuristic outcomes
+ *
+ * @param cache the cache
+ */
+void free_probe_cache(probe_cache_t *cache);
+
+/**
+ * Find the entry of a state, replacing whatever occupies its slot by an entry
+ * with nothing known if the key does not match
+ *
+ * @param cache the cache
+ * @param key hash of the state
+ * @return entry of the state
+ */
+probe_entry_t *find_probe_entry(probe_cache_t *cache, uint64_t key);
+
+#endif
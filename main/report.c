@@ -16,13 +16,15 @@
  */
 
 #include "report.h"
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
 report_t *new_report(int init_lb, int init_ub, int best_lb, int best_ub,
                      move_t *best_sol, double time_to_best_lb,
                      double time_to_best_ub, double time_used, long n_nodes,
-                     long n_probe) {
+                     long n_probe, long n_probe_skip, long n_cache_lookup,
+                     long n_cache_hit) {
   report_t *report = malloc(sizeof(report_t));
   report->init_lb = init_lb;
   report->init_ub = init_ub;
@@ -37,6 +39,9 @@ report_t *new_report(int init_lb, int init_ub, int best_lb, int best_ub,
   report->time_used = time_used;
   report->n_nodes = n_nodes;
   report->n_probe = n_probe;
+  report->n_probe_skip = n_probe_skip;
+  report->n_cache_lookup = n_cache_lookup;
+  report->n_cache_hit = n_cache_hit;
   return report;
 }
 
@@ -46,3 +51,96 @@ void free_report(report_t *report) {
   }
   free(report);
 }
+
+/*
+ * Structured output
+ */
+static const char *report_fields[] = {
+    "id",           "status",      "init_lb",         "init_ub",
+    "best_lb",      "best_ub",     "time_to_best_lb", "time_to_best_ub",
+    "time_used",    "n_nodes",     "n_probe",         "n_probe_skip",
+    "n_cache_lookup", "n_cache_hit", "solution"};
+
+static const int n_report_fields =
+    sizeof(report_fields) / sizeof(report_fields[0]);
+
+static void print_key(FILE *fp, int format, int k) {
+  if (format == OUTPUT_JSON) {
+    fprintf(fp, "%s\"%s\": ", k == 0 ? "{" : ", ", report_fields[k]);
+  } else if (k > 0) {
+    fprintf(fp, ",");
+  }
+}
+
+void print_report_header(FILE *fp, int format) {
+  if (format != OUTPUT_CSV) {
+    return;
+  }
+  for (int k = 0; k < n_report_fields; k++) {
+    fprintf(fp, "%s%s", k == 0 ? "" : ",", report_fields[k]);
+  }
+  fprintf(fp, "\n");
+}
+
+void print_report(FILE *fp, int format, long id, report_t *report) {
+  bool json = format == OUTPUT_JSON;
+  const char *status = report == NULL                        ? "infeasible"
+                       : report->best_lb == report->best_ub ? "optimal"
+                                                            : "feasible";
+  int k = 0;
+  print_key(fp, format, k++);
+  fprintf(fp, "%ld", id);
+  print_key(fp, format, k++);
+  fprintf(fp, json ? "\"%s\"" : "%s", status);
+
+  if (report == NULL) {
+    while (k < n_report_fields) {
+      print_key(fp, format, k++);
+      if (json) {
+        fprintf(fp, "null");
+      }
+    }
+  } else {
+    int ints[] = {report->init_lb, report->init_ub, report->best_lb,
+                  report->best_ub};
+    for (int i = 0; i < 4; i++) {
+      print_key(fp, format, k++);
+      fprintf(fp, "%d", ints[i]);
+    }
+    double times[] = {report->time_to_best_lb, report->time_to_best_ub,
+                      report->time_used};
+    for (int i = 0; i < 3; i++) {
+      print_key(fp, format, k++);
+      fprintf(fp, "%.6f", times[i]);
+    }
+    long counts[] = {report->n_nodes, report->n_probe, report->n_probe_skip,
+                     report->n_cache_lookup, report->n_cache_hit};
+    for (int i = 0; i < 5; i++) {
+      print_key(fp, format, k++);
+      fprintf(fp, "%ld", counts[i]);
+    }
+
+    /*
+     * Solution as [[p, s, d], ...] in JSON and p:s:d;... in CSV
+     */
+    print_key(fp, format, k++);
+    if (json) {
+      fprintf(fp, "[");
+    }
+    for (int i = 0; i < report->best_ub; i++) {
+      move_t *move = &report->best_sol[i];
+      if (json) {
+        fprintf(fp, "%s[%d, %d, %d]", i == 0 ? "" : ", ", move->p, move->s,
+                move->d);
+      } else {
+        fprintf(fp, "%s%d:%d:%d", i == 0 ? "" : ";", move->p, move->s,
+                move->d);
+      }
+    }
+    if (json) {
+      fprintf(fp, "]");
+    }
+  }
+
+  fprintf(fp, json ? "}\n" : "\n");
+}
@@ -19,8 +19,11 @@
 #define REPORT_H
 
 #include "move.h"
+#include <stdio.h>
 
-typedef struct {
+enum { OUTPUT_TEXT, OUTPUT_JSON, OUTPUT_CSV };
+
+typedef struct report {
   int init_lb;            // initial lower bound
   int init_ub;            // initial upper bound
   int best_lb;            // best lower bound
@@ -28,9 +31,12 @@ typedef struct {
   move_t *best_sol;       // best solution
   double time_to_best_lb; // time to the best lower bound
   double time_to_best_ub; // time to the best upper bound
-  double time_used;       // total time used in seconds
+  double time_used;       // total wall-clock time used in seconds
   long n_nodes;           // number of nodes explored
   long n_probe;           // number of nodes probed
+  long n_probe_skip;      // number of nodes whose probing was skipped
+  long n_cache_lookup;    // number of probe cache lookups
+  long n_cache_hit;       // number of probe cache hits
 } report_t;
 
 /**
@@ -43,15 +49,19 @@ typedef struct {
  * @param best_sol best solution
  * @param time_to_best_lb time to the best lower bound
  * @param time_to_best_ub time to the best upper bound
- * @param time_used total time used in seconds
+ * @param time_used total wall-clock time used in seconds
  * @param n_nodes number of nodes explored
  * @param n_probe number of nodes probed
+ * @param n_probe_skip number of nodes whose probing was skipped
+ * @param n_cache_lookup number of probe cache lookups
+ * @param n_cache_hit number of probe cache hits
  * @return created report
  */
 report_t *new_report(int init_lb, int init_ub, int best_lb, int best_ub,
                      move_t *best_sol, double time_to_best_lb,
                      double time_to_best_ub, double time_used, long n_nodes,
-                     long n_probe);
+                     long n_probe, long n_probe_skip, long n_cache_lookup,
+                     long n_cache_hit);
 
 /**
  * Free the space of a report
@@ -60,4 +70,23 @@ report_t *new_report(int init_lb, int init_ub, int best_lb, int best_ub,
  */
 void free_report(report_t *report);
 
+/**
+ * Print the header line of structured reports, if the format has one
+ *
+ * @param fp output stream
+ * @param format OUTPUT_JSON or OUTPUT_CSV
+ */
+void print_report_header(FILE *fp, int format);
+
+/**
+ * Print all fields of a report and its solution as one JSON object or CSV
+ * row on a single line
+ *
+ * @param fp output stream
+ * @param format OUTPUT_JSON or OUTPUT_CSV
+ * @param id position of the instance in the input, from 0
+ * @param report the report, or NULL if the instance has no solution
+ */
+void print_report(FILE *fp, int format, long id, report_t *report);
+
 #endif
@@ -0,0 +1,567 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "result_cache.h"
+#include "verifier.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC "UCRPRES1"
+#define INDEX_MAGIC "UCRPIDX1"
+#define CACHE_BYTE_ORDER 0x01020304
+#define INDEX_INIT_CAPACITY 1024
+
+typedef struct {
+  char magic[8];
+  int32_t byte_order;
+  int32_t reserved;
+} cache_header_t;
+
+/*
+ * A record is followed by the heights of the canonical stacks, the ranks of
+ * their blocks stack by stack from the bottom, and the moves of the solution
+ * as (rank, source, destination) triples
+ */
+typedef struct {
+  uint64_t key;     // fingerprint of the canonical instance
+  int32_t n_stacks; // number of stacks
+  int32_t n_tiers;  // number of tiers
+  int32_t n_blocks; // number of blocks
+  int32_t best_lb;  // best lower bound
+  int32_t best_ub;  // best upper bound
+  int32_t len;      // number of moves of the solution
+} record_header_t;
+
+typedef struct {
+  char magic[8];
+  int32_t byte_order;
+  int32_t reserved;
+  int64_t capacity;  // number of slots, a power of 2
+  int64_t count;     // number of used slots
+  int64_t data_size; // size of the cache file covered by the index
+} index_header_t;
+
+typedef struct {
+  uint64_t key;   // fingerprint of the canonical instance
+  int64_t offset; // offset of the latest record of the key, or 0 if empty
+} index_slot_t;
+
+struct result_cache {
+  int fd;                // cache file
+  int index_fd;          // index file
+  index_header_t *index; // mapped index file, or NULL
+  size_t index_size;     // size of the mapping
+};
+
+typedef struct {
+  int n_stacks;  // number of stacks
+  int n_tiers;   // number of tiers
+  int n_blocks;  // number of blocks
+  int *h;        // height of each canonical stack
+  int *blocks;   // ranks of the blocks stack by stack from the bottom
+  int *perm;     // stack of the instance of each canonical stack
+  int *prios;    // priority of the instance of each rank, from rank 1
+  int n_prios;   // number of distinct priorities
+  uint64_t key;  // fingerprint
+} canonical_t;
+
+typedef struct {
+  int s;      // stack of the instance
+  int h;      // height
+  int *ranks; // ranks of the blocks from the bottom
+} column_t;
+
+/*
+ * Canonical form
+ */
+static int compare_int(const void *a, const void *b) {
+  int x = *(const int *)a;
+  int y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+static int compare_column(const void *a, const void *b) {
+  const column_t *x = a;
+  const column_t *y = b;
+  if (x->h != y->h) {
+    return x->h - y->h;
+  }
+  for (int t = 0; t < x->h; t++) {
+    if (x->ranks[t] != y->ranks[t]) {
+      return x->ranks[t] - y->ranks[t];
+    }
+  }
+  return x->s - y->s;
+}
+
+static int get_rank(canonical_t *canon, int p) {
+  int *found = bsearch(&p, canon->prios, canon->n_prios, sizeof(int),
+                       compare_int);
+  return found == NULL ? 0 : (int)(found - canon->prios) + 1;
+}
+
+static uint64_t mix(uint64_t key, int value) {
+  return (key ^ (uint64_t)(uint32_t)value) * 0x100000001b3u;
+}
+
+static void make_canonical(canonical_t *canon, instance_t *inst) {
+  int n_stacks = inst->n_stacks;
+  int n_blocks = 0;
+  for (int s = 0; s < n_stacks; s++) {
+    n_blocks += inst->h[s];
+  }
+  canon->n_stacks = n_stacks;
+  canon->n_tiers = inst->n_tiers;
+  canon->n_blocks = n_blocks;
+  canon->h = malloc(sizeof(int) * (2 * n_stacks + 2 * n_blocks + 1));
+  canon->perm = canon->h + n_stacks;
+  canon->blocks = canon->perm + n_stacks;
+  canon->prios = canon->blocks + n_blocks;
+
+  int k = 0;
+  for (int s = 0; s < n_stacks; s++) {
+    for (int t = 1; t <= inst->h[s]; t++) {
+      canon->prios[k++] = inst->p[s][t];
+    }
+  }
+  qsort(canon->prios, n_blocks, sizeof(int), compare_int);
+  canon->n_prios = 0;
+  for (int i = 0; i < n_blocks; i++) {
+    if (canon->n_prios == 0 ||
+        canon->prios[i] != canon->prios[canon->n_prios - 1]) {
+      canon->prios[canon->n_prios++] = canon->prios[i];
+    }
+  }
+
+  column_t *columns = malloc(sizeof(column_t) * n_stacks);
+  int *ranks = malloc(sizeof(int) * (n_blocks + 1));
+  k = 0;
+  for (int s = 0; s < n_stacks; s++) {
+    columns[s].s = s;
+    columns[s].h = inst->h[s];
+    columns[s].ranks = ranks + k;
+    for (int t = 1; t <= inst->h[s]; t++) {
+      ranks[k++] = get_rank(canon, inst->p[s][t]);
+    }
+  }
+  qsort(columns, n_stacks, sizeof(column_t), compare_column);
+
+  uint64_t key = 0xcbf29ce484222325u;
+  key = mix(mix(key, n_stacks), inst->n_tiers);
+  k = 0;
+  for (int i = 0; i < n_stacks; i++) {
+    canon->perm[i] = columns[i].s;
+    canon->h[i] = columns[i].h;
+    key = mix(key, columns[i].h);
+    for (int t = 0; t < columns[i].h; t++) {
+      key = mix(key, canon->blocks[k++] = columns[i].ranks[t]);
+    }
+  }
+  canon->key = key ^ (key >> 29);
+  free(ranks);
+  free(columns);
+}
+
+static void free_canonical(canonical_t *canon) { free(canon->h); }
+
+/*
+ * Index
+ */
+static index_slot_t *get_slots(result_cache_t *cache) {
+  return (index_slot_t *)(cache->index + 1);
+}
+
+static bool map_index(result_cache_t *cache, size_t size) {
+  if (cache->index != NULL) {
+    munmap(cache->index, cache->index_size);
+    cache->index = NULL;
+  }
+  if (size < sizeof(index_header_t)) {
+    return false;
+  }
+  void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    cache->index_fd, 0);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  cache->index = data;
+  cache->index_size = size;
+  return true;
+}
+
+static bool reset_index(result_cache_t *cache, int64_t capacity) {
+  size_t size = sizeof(index_header_t) + sizeof(index_slot_t) * capacity;
+  if (ftruncate(cache->index_fd, size) == -1 || !map_index(cache, size)) {
+    return false;
+  }
+  memset(cache->index, 0, size);
+  memcpy(cache->index->magic, INDEX_MAGIC, 8);
+  cache->index->byte_order = CACHE_BYTE_ORDER;
+  cache->index->capacity = capacity;
+  cache->index->data_size = sizeof(cache_header_t);
+  return true;
+}
+
+static bool insert_slot(result_cache_t *cache, uint64_t key, int64_t offset);
+
+static bool grow_index(result_cache_t *cache) {
+  int64_t capacity = cache->index->capacity;
+  int64_t data_size = cache->index->data_size;
+  index_slot_t *slots = malloc(sizeof(index_slot_t) * capacity);
+  memcpy(slots, get_slots(cache), sizeof(index_slot_t) * capacity);
+  bool grown = reset_index(cache, 2 * capacity);
+  if (grown) {
+    cache->index->data_size = data_size;
+    for (int64_t i = 0; i < capacity; i++) {
+      if (slots[i].offset != 0) {
+        insert_slot(cache, slots[i].key, slots[i].offset);
+      }
+    }
+  }
+  free(slots);
+  return grown;
+}
+
+static bool insert_slot(result_cache_t *cache, uint64_t key, int64_t offset) {
+  if ((cache->index->count + 1) * 2 > cache->index->capacity &&
+      !grow_index(cache)) {
+    return false;
+  }
+  index_slot_t *slots = get_slots(cache);
+  uint64_t mask = cache->index->capacity - 1;
+  for (uint64_t i = key & mask;; i = (i + 1) & mask) {
+    if (slots[i].offset == 0) {
+      slots[i].key = key;
+      slots[i].offset = offset;
+      cache->index->count++;
+      return true;
+    }
+    if (slots[i].key == key) {
+      slots[i].offset = offset;
+      return true;
+    }
+  }
+}
+
+static int64_t find_slot(result_cache_t *cache, uint64_t key) {
+  index_slot_t *slots = get_slots(cache);
+  uint64_t mask = cache->index->capacity - 1;
+  for (uint64_t i = key & mask; slots[i].offset != 0; i = (i + 1) & mask) {
+    if (slots[i].key == key) {
+      return slots[i].offset;
+    }
+  }
+  return 0;
+}
+
+static bool is_valid_record(record_header_t *rec) {
+  return rec->n_stacks >= 1 && rec->n_tiers >= 1 && rec->n_blocks >= 0 &&
+         rec->len >= 0 && rec->n_stacks <= (1 << 16) &&
+         rec->n_tiers <= (1 << 16) &&
+         (int64_t)rec->n_blocks <= (int64_t)rec->n_stacks * rec->n_tiers &&
+         rec->len <= (1 << 24);
+}
+
+static int64_t get_body_size(record_header_t *rec) {
+  return (int64_t)rec->n_stacks + rec->n_blocks + 3 * (int64_t)rec->len;
+}
+
+/*
+ * Bring the index up to date with the cache file, which other processes may
+ * have appended to. Must be called with the cache file locked.
+ */
+static bool sync_index(result_cache_t *cache) {
+  struct stat st;
+  if (fstat(cache->index_fd, &st) == -1) {
+    return false;
+  }
+  if (cache->index == NULL || (size_t)st.st_size != cache->index_size) {
+    map_index(cache, st.st_size);
+  }
+  index_header_t *index = cache->index;
+  if (index == NULL || memcmp(index->magic, INDEX_MAGIC, 8) != 0 ||
+      index->byte_order != CACHE_BYTE_ORDER || index->capacity <= 0 ||
+      (index->capacity & (index->capacity - 1)) != 0 ||
+      cache->index_size != sizeof(index_header_t) +
+                               sizeof(index_slot_t) * index->capacity ||
+      index->data_size < (int64_t)sizeof(cache_header_t)) {
+    if (!reset_index(cache, INDEX_INIT_CAPACITY)) {
+      return false;
+    }
+  }
+
+  if (fstat(cache->fd, &st) == -1) {
+    return false;
+  }
+  if (cache->index->data_size > st.st_size &&
+      !reset_index(cache, cache->index->capacity)) {
+    return false;
+  }
+  while (cache->index->data_size < st.st_size) {
+    int64_t offset = cache->index->data_size;
+    record_header_t rec;
+    if (pread(cache->fd, &rec, sizeof(rec), offset) != sizeof(rec) ||
+        !is_valid_record(&rec)) {
+      break;
+    }
+    int64_t size = sizeof(rec) + sizeof(int32_t) * get_body_size(&rec);
+    if (offset + size > st.st_size || !insert_slot(cache, rec.key, offset)) {
+      break;
+    }
+    cache->index->data_size = offset + size;
+  }
+  return true;
+}
+
+/*
+ * Read the record of a canonical instance and return its body, or NULL if
+ * none is cached
+ */
+static int *read_record(result_cache_t *cache, canonical_t *canon,
+                        record_header_t *rec) {
+  int64_t offset = find_slot(cache, canon->key);
+  if (offset == 0 || pread(cache->fd, rec, sizeof(*rec), offset) !=
+                         sizeof(*rec)) {
+    return NULL;
+  }
+  if (!is_valid_record(rec) || rec->key != canon->key ||
+      rec->n_stacks != canon->n_stacks || rec->n_tiers != canon->n_tiers ||
+      rec->n_blocks != canon->n_blocks || rec->len != rec->best_ub) {
+    return NULL;
+  }
+  size_t size = sizeof(int32_t) * get_body_size(rec);
+  int *body = malloc(size + sizeof(int32_t));
+  if ((size_t)pread(cache->fd, body, size, offset + sizeof(*rec)) != size ||
+      memcmp(body, canon->h, sizeof(int) * canon->n_stacks) != 0 ||
+      memcmp(body + canon->n_stacks, canon->blocks,
+             sizeof(int) * canon->n_blocks) != 0) {
+    free(body);
+    return NULL;
+  }
+  return body;
+}
+
+/*
+ * Cache
+ */
+result_cache_t *open_result_cache(char *path) {
+  if (sizeof(int) != sizeof(int32_t)) {
+    fprintf(stderr, "Result caches need 32-bit int\n");
+    return NULL;
+  }
+
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd == -1) {
+    fprintf(stderr, "Failed to open file: %s\n", path);
+    return NULL;
+  }
+  flock(fd, LOCK_EX);
+  struct stat st;
+  cache_header_t header;
+  bool valid = fstat(fd, &st) != -1;
+  if (valid && st.st_size == 0) {
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, 8);
+    header.byte_order = CACHE_BYTE_ORDER;
+    valid = pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+  } else {
+    valid = valid && pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+            memcmp(header.magic, CACHE_MAGIC, 8) == 0 &&
+            header.byte_order == CACHE_BYTE_ORDER;
+  }
+  flock(fd, LOCK_UN);
+  if (!valid) {
+    fprintf(stderr, "Invalid result cache: %s\n", path);
+    close(fd);
+    return NULL;
+  }
+
+  char *index_path = malloc(strlen(path) + 5);
+  sprintf(index_path, "%s.idx", path);
+  int index_fd = open(index_path, O_RDWR | O_CREAT, 0644);
+  if (index_fd == -1) {
+    fprintf(stderr, "Failed to open file: %s\n", index_path);
+    free(index_path);
+    close(fd);
+    return NULL;
+  }
+  free(index_path);
+
+  result_cache_t *cache = malloc(sizeof(result_cache_t));
+  cache->fd = fd;
+  cache->index_fd = index_fd;
+  cache->index = NULL;
+  cache->index_size = 0;
+  return cache;
+}
+
+void close_result_cache(result_cache_t *cache) {
+  if (cache->index != NULL) {
+    munmap(cache->index, cache->index_size);
+  }
+  close(cache->index_fd);
+  close(cache->fd);
+  free(cache);
+}
+
+report_t *lookup_result(result_cache_t *cache, instance_t *inst) {
+  canonical_t canon;
+  make_canonical(&canon, inst);
+  record_header_t rec;
+  flock(cache->fd, LOCK_EX);
+  int *body = sync_index(cache) ? read_record(cache, &canon, &rec) : NULL;
+  flock(cache->fd, LOCK_UN);
+  if (body == NULL) {
+    free_canonical(&canon);
+    return NULL;
+  }
+
+  /*
+   * Map the moves back to the instance, and replay them to be sure
+   */
+  move_t *sol = malloc(sizeof(move_t) * (rec.len + 1));
+  int *moves = body + canon.n_stacks + canon.n_blocks;
+  bool valid = true;
+  for (int i = 0; valid && i < rec.len; i++) {
+    int r = moves[3 * i];
+    int s = moves[3 * i + 1];
+    int d = moves[3 * i + 2];
+    valid = r >= 1 && r <= canon.n_prios && s >= 0 && s < canon.n_stacks &&
+            d >= 0 && d < canon.n_stacks;
+    if (valid) {
+      sol[i].p = canon.prios[r - 1];
+      sol[i].s = canon.perm[s];
+      sol[i].d = canon.perm[d];
+    }
+  }
+  if (valid) {
+    state_t *state =
+        malloc_state(inst->n_stacks, inst->n_tiers, true, true, false);
+    verify_t result;
+    valid = verify_moves(state, inst, sol, rec.len, NULL, &result);
+    free_state(state);
+  }
+
+  report_t *report = valid ? new_report(rec.best_lb, rec.best_ub, rec.best_lb,
+                                        rec.best_ub, sol, 0, 0, 0, 0, 0, 0, 0,
+                                        0)
+                           : NULL;
+  free(sol);
+  free(body);
+  free_canonical(&canon);
+  return report;
+}
+
+bool store_result(result_cache_t *cache, instance_t *inst, report_t *report) {
+  if (report->best_sol == NULL) {
+    return false;
+  }
+  canonical_t canon;
+  make_canonical(&canon, inst);
+
+  /*
+   * Map the moves to the canonical instance
+   */
+  int *inverse = malloc(sizeof(int) * canon.n_stacks);
+  for (int i = 0; i < canon.n_stacks; i++) {
+    inverse[canon.perm[i]] = i;
+  }
+  int len = report->best_ub;
+  int *moves = malloc(sizeof(int) * (3 * len + 1));
+  bool valid = true;
+  for (int i = 0; valid && i < len; i++) {
+    move_t *move = &report->best_sol[i];
+    valid = move->s >= 0 && move->s < canon.n_stacks && move->d >= 0 &&
+            move->d < canon.n_stacks &&
+            (moves[3 * i] = get_rank(&canon, move->p)) != 0;
+    if (valid) {
+      moves[3 * i + 1] = inverse[move->s];
+      moves[3 * i + 2] = inverse[move->d];
+    }
+  }
+  free(inverse);
+  if (!valid) {
+    free(moves);
+    free_canonical(&canon);
+    return false;
+  }
+
+  record_header_t rec;
+  rec.key = canon.key;
+  rec.n_stacks = canon.n_stacks;
+  rec.n_tiers = canon.n_tiers;
+  rec.n_blocks = canon.n_blocks;
+  rec.best_lb = report->best_lb;
+  rec.best_ub = rec.len = len;
+
+  bool written = false;
+  flock(cache->fd, LOCK_EX);
+  if (sync_index(cache)) {
+    record_header_t old;
+    int *old_body = read_record(cache, &canon, &old);
+    bool found = old_body != NULL;
+    if (found) {
+      if (old.best_lb > rec.best_lb) {
+        rec.best_lb = old.best_lb;
+      }
+      if (old.best_ub <= rec.best_ub) {
+        rec.best_ub = rec.len = old.len;
+        memcpy(moves, old_body + canon.n_stacks + canon.n_blocks,
+               sizeof(int) * 3 * old.len);
+      }
+      free(old_body);
+    }
+
+    if (found && old.best_lb == rec.best_lb &&
+        old.best_ub == rec.best_ub) {
+      written = true; // nothing new
+    } else {
+      size_t size = sizeof(rec) + sizeof(int32_t) * get_body_size(&rec);
+      char *buf = malloc(size);
+      memcpy(buf, &rec, sizeof(rec));
+      int *body = (int *)(buf + sizeof(rec));
+      memcpy(body, canon.h, sizeof(int) * canon.n_stacks);
+      memcpy(body + canon.n_stacks, canon.blocks,
+             sizeof(int) * canon.n_blocks);
+      memcpy(body + canon.n_stacks + canon.n_blocks, moves,
+             sizeof(int) * 3 * rec.len);
+
+      /*
+       * Drop what a crashed writer may have left after the last record
+       */
+      int64_t offset = cache->index->data_size;
+      written = ftruncate(cache->fd, offset) == 0 &&
+                pwrite(cache->fd, buf, size, offset) == (ssize_t)size &&
+                insert_slot(cache, rec.key, offset);
+      if (written) {
+        cache->index->data_size = offset + size;
+      }
+      free(buf);
+    }
+  }
+  flock(cache->fd, LOCK_UN);
+
+  free(moves);
+  free_canonical(&canon);
+  return written;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "instance.h"
+#include "report.h"
+#include <stdbool.h>
+
+/*
+ * Results are keyed by a canonical form of the instance, in which priorities
+ * are relabelled to their dense ranks and stacks are sorted, so that a result
+ * also serves instances which differ only in the order of stacks or in
+ * priority values of the same order. Results are appended to the cache file,
+ * and a hash index of it is kept in a second file with the suffix .idx, which
+ * is mapped into memory and rebuilt from the cache file when out of date.
+ */
+typedef struct result_cache result_cache_t;
+
+/**
+ * Open a result cache, creating its files if they do not exist
+ *
+ * @param path name of the cache file
+ * @return opened cache or NULL if the files cannot be opened
+ */
+result_cache_t *open_result_cache(char *path);
+
+/**
+ * Close a result cache
+ *
+ * @param cache the cache
+ */
+void close_result_cache(result_cache_t *cache);
+
+/**
+ * Look up the best known result of an instance
+ *
+ * @param cache the cache
+ * @param inst the instance
+ * @return created report with the best known bounds and the solution mapped
+ * to the stacks and priorities of the instance, whose times and counters are
+ * 0, or NULL if no valid result is cached
+ */
+report_t *lookup_result(result_cache_t *cache, instance_t *inst);
+
+/**
+ * Store the result of an instance, merged with the result already cached so
+ * that the cache keeps the highest lower bound and the shortest solution
+ *
+ * @param cache the cache
+ * @param inst the instance
+ * @param report the result
+ * @return true if the result is written
+ */
+bool store_result(result_cache_t *cache, instance_t *inst, report_t *report);
+
+#endif
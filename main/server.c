@@ -0,0 +1,465 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "instance.h"
+#include "param.h"
+#include "report.h"
+#include "timer.h"
+#include "ucrp.h"
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Protocol
+ *
+ * A client connects, sends an optional line "time_limit <seconds>", where
+ * the seconds may be fractional, followed by one instance in the input
+ * format, and shuts down its writing side within the read timeout of the
+ * server. The time limit is a wall-clock deadline set when the solve of the
+ * request starts, shared by the restarts, the beam search and the search.
+ * The server answers with the lines
+ *
+ *   status optimal|feasible|infeasible
+ *   lb <best_lb>
+ *   ub <best_ub>
+ *   time <time_used>
+ *   nodes <n_nodes>
+ *   moves [(p: s -> d), ...]
+ *
+ * or with a single line "status error <message>", and closes the connection.
+ */
+
+#define MAX_REQUEST_SIZE (16 << 20)
+#define DEFAULT_HEARTBEAT_NODES 100
+
+typedef struct {
+  int n_stacks;          // number of stacks of the instances served
+  int n_tiers;           // number of tiers of the instances served
+  long last_used;        // request counter when the solver was last used
+  ucrp_solver_t *solver; // warm solver, or NULL if the slot is free
+} context_t;
+
+typedef struct {
+  int *fds;                 // connections waiting to be served
+  int cap;                  // capacity of the queue
+  int head;                 // index of the first connection
+  int size;                 // number of connections
+  bool closed;              // true if no more connections will be queued
+  pthread_mutex_t mutex;     // protects the queue
+  pthread_cond_t not_empty;  // signaled when a connection is queued
+  pthread_cond_t not_full;   // signaled when a connection is taken
+} queue_t;
+
+typedef struct {
+  queue_t *queue;      // connections to serve
+  param_t *param;      // default parameters
+  double read_timeout; // seconds to receive a request in
+  int n_contexts;      // number of warm solvers kept
+  context_t *contexts; // warm solvers
+  long n_served;       // number of requests served
+} worker_t;
+
+static volatile sig_atomic_t stopped = 0;
+
+static void stop(int sig) {
+  (void)sig;
+  stopped = 1;
+}
+
+static void usage(void) {
+  fprintf(stdout, "usage: main-server -h\n");
+  fprintf(stdout, "usage: main-server"
+                  " --socket/-S socket_path"
+                  " [--workers/-w n_workers]"
+                  " [--time_limit/-t time_limit]"
+                  " [--heartbeat/-B heartbeat_nodes]"
+                  " [--read_timeout/-T read_timeout]"
+                  " [--contexts/-C n_contexts]\n");
+  fprintf(stdout, "\t--socket/-S: path of the Unix domain socket\n");
+  fprintf(stdout, "\t--workers/-w: number of requests served at a time\n");
+  fprintf(stdout, "\t--time_limit/-t: default time limit in seconds of a"
+                  " request, fractional allowed\n");
+  fprintf(stdout, "\t--heartbeat/-B: nodes between time limit checks of a"
+                  " request (default %d)\n",
+          DEFAULT_HEARTBEAT_NODES);
+  fprintf(stdout, "\t--read_timeout/-T: seconds to receive a request in,"
+                  " after which the connection is dropped\n");
+  fprintf(stdout, "\t--contexts/-C: warm solvers kept by each worker, one per"
+                  " (n_stacks, n_tiers)\n");
+  fprintf(stdout, "request format:\n");
+  fprintf(stdout, "\t[time_limit seconds]\n");
+  fprintf(stdout, "\tone instance in the input format of main-solve\n");
+  fflush(stdout);
+}
+
+/*
+ * Connection queue
+ */
+static void push_connection(queue_t *queue, int fd) {
+  pthread_mutex_lock(&queue->mutex);
+  while (queue->size == queue->cap) {
+    pthread_cond_wait(&queue->not_full, &queue->mutex);
+  }
+  queue->fds[(queue->head + queue->size++) % queue->cap] = fd;
+  pthread_cond_signal(&queue->not_empty);
+  pthread_mutex_unlock(&queue->mutex);
+}
+
+static int pop_connection(queue_t *queue) {
+  pthread_mutex_lock(&queue->mutex);
+  while (queue->size == 0 && !queue->closed) {
+    pthread_cond_wait(&queue->not_empty, &queue->mutex);
+  }
+  int fd = -1;
+  if (queue->size > 0) {
+    fd = queue->fds[queue->head];
+    queue->head = (queue->head + 1) % queue->cap;
+    queue->size--;
+    pthread_cond_signal(&queue->not_full);
+  }
+  pthread_mutex_unlock(&queue->mutex);
+  return fd;
+}
+
+/*
+ * Warm solvers
+ */
+static ucrp_solver_t *find_solver(worker_t *worker, int n_stacks,
+                                  int n_tiers) {
+  context_t *victim = &worker->contexts[0];
+  for (int i = 0; i < worker->n_contexts; i++) {
+    context_t *context = &worker->contexts[i];
+    if (context->solver != NULL && context->n_stacks == n_stacks &&
+        context->n_tiers == n_tiers) {
+      context->last_used = worker->n_served;
+      return context->solver;
+    }
+    if (victim->solver != NULL &&
+        (context->solver == NULL || context->last_used < victim->last_used)) {
+      victim = context;
+    }
+  }
+
+  if (victim->solver != NULL) {
+    ucrp_free_solver(victim->solver);
+  }
+  victim->n_stacks = n_stacks;
+  victim->n_tiers = n_tiers;
+  victim->last_used = worker->n_served;
+  victim->solver = ucrp_new_solver(n_stacks, n_tiers);
+  return victim->solver;
+}
+
+/*
+ * Requests
+ */
+static char *read_request(int fd, size_t *size, double timeout) {
+  size_t cap = 4096;
+  char *data = malloc(cap);
+  *size = 0;
+  double end_time = get_wall_time() + timeout;
+  for (;;) {
+    double time_left = end_time - get_wall_time();
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int ready =
+        time_left > 0 ? poll(&pfd, 1, (int)(time_left * 1000) + 1) : 0;
+    if (ready == 0 || (ready < 0 && errno != EINTR)) {
+      free(data);
+      return NULL;
+    }
+    if (ready < 0) {
+      continue;
+    }
+
+    if (*size == cap) {
+      if (cap >= MAX_REQUEST_SIZE) {
+        free(data);
+        return NULL;
+      }
+      cap *= 2;
+      data = realloc(data, cap);
+    }
+    ssize_t n = read(fd, data + *size, cap - *size);
+    if (n == 0) {
+      return data;
+    }
+    if (n < 0 && errno != EINTR) {
+      free(data);
+      return NULL;
+    }
+    if (n > 0) {
+      *size += n;
+    }
+  }
+}
+
+static void serve(worker_t *worker, int fd) {
+  FILE *fp = fdopen(fd, "w");
+  if (fp == NULL) {
+    close(fd);
+    return;
+  }
+
+  size_t size;
+  char *data = read_request(fd, &size, worker->read_timeout);
+  if (data == NULL) {
+    fprintf(fp, "status error failed to read request\n");
+    fclose(fp);
+    return;
+  }
+
+  /*
+   * Optional header
+   */
+  param_t param = *worker->param;
+  size_t begin = 0;
+  while (begin < size && (data[begin] == ' ' || data[begin] == '\t' ||
+                          data[begin] == '\r' || data[begin] == '\n')) {
+    begin++;
+  }
+  if (size - begin >= 10 && memcmp(data + begin, "time_limit", 10) == 0) {
+    char *end = memchr(data + begin, '\n', size - begin);
+    if (end == NULL) {
+      end = data + size;
+    }
+    char line[64];
+    size_t len = end - (data + begin) < 63 ? end - (data + begin) : 63;
+    memcpy(line, data + begin, len);
+    line[len] = '\0';
+    char *rest;
+    double time_limit = strtod(line + 10, &rest);
+    if (rest == line + 10 || !(time_limit >= 0 && time_limit <= INT_MAX)) {
+      fprintf(fp, "status error invalid time limit\n");
+      fclose(fp);
+      free(data);
+      return;
+    }
+    param.time_limit = time_limit;
+    begin = end - data;
+  }
+
+  /*
+   * Instance
+   */
+  reader_t *reader = open_memory_reader(data + begin, size - begin);
+  instance_t *inst;
+  if (read_next_instance(reader, &inst) != 1) {
+    fprintf(fp, "status error failed to read instance\n");
+  } else {
+    ucrp_solver_t *solver =
+        find_solver(worker, inst->n_stacks, inst->n_tiers);
+    report_t *report =
+        solver != NULL ? ucrp_run_solver(solver, inst, &param) : NULL;
+    worker->n_served++;
+    if (solver == NULL) {
+      fprintf(fp, "status error cannot allocate the solver\n");
+    } else if (report == NULL) {
+      fprintf(fp, "status infeasible\n");
+      fprintf(fp, "moves ");
+      print_moves(fp, NULL, INT_MAX);
+    } else {
+      fprintf(fp, "status %s\n",
+              report->best_lb == report->best_ub ? "optimal" : "feasible");
+      fprintf(fp, "lb %d\n", report->best_lb);
+      fprintf(fp, "ub %d\n", report->best_ub);
+      fprintf(fp, "time %.3f\n", report->time_used);
+      fprintf(fp, "nodes %ld\n", report->n_nodes);
+      fprintf(fp, "moves ");
+      print_moves(fp, report->best_sol, report->best_ub);
+      ucrp_free_report(report);
+    }
+  }
+  close_reader(reader);
+  free(data);
+  fclose(fp);
+}
+
+static void *run_worker(void *arg) {
+  worker_t *worker = arg;
+  for (int fd; (fd = pop_connection(worker->queue)) != -1;) {
+    serve(worker, fd);
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  char *opts = "hS:w:t:B:T:C:";
+  struct option options[] = {{"help", no_argument, NULL, 'h'},
+                             {"socket", required_argument, NULL, 'S'},
+                             {"workers", required_argument, NULL, 'w'},
+                             {"time_limit", required_argument, NULL, 't'},
+                             {"heartbeat", required_argument, NULL, 'B'},
+                             {"read_timeout", required_argument, NULL, 'T'},
+                             {"contexts", required_argument, NULL, 'C'},
+                             {NULL, 0, NULL, 0}};
+
+  char *socket_path = NULL;
+  int n_contexts = 8;
+  double read_timeout = 5;
+  param_t param;
+  init_param(&param);
+  int n_workers = param.n_threads;
+  param.time_limit = 1;
+  param.n_threads = 1;
+  param.log_level = LOG_QUIET;
+  param.heartbeat_nodes = DEFAULT_HEARTBEAT_NODES;
+
+  for (int opt; (opt = getopt_long(argc, argv, opts, options, NULL)) != -1;) {
+    switch (opt) {
+    case 'h':
+      usage();
+      return EXIT_SUCCESS;
+    case 'S':
+      socket_path = optarg;
+      break;
+    case 'w':
+      n_workers = (int)strtol(optarg, NULL, 10);
+      break;
+    case 't':
+      param.time_limit = strtod(optarg, NULL);
+      break;
+    case 'B':
+      param.heartbeat_nodes = strtol(optarg, NULL, 10);
+      break;
+    case 'T':
+      read_timeout = strtod(optarg, NULL);
+      break;
+    case 'C':
+      n_contexts = (int)strtol(optarg, NULL, 10);
+      break;
+    default:
+      fprintf(stderr, "Unknown option: %c\n", opt);
+      return EXIT_FAILURE;
+    }
+  }
+  if (socket_path == NULL || n_workers < 1 || n_contexts < 1 ||
+      param.heartbeat_nodes < 1 ||
+      !(read_timeout > 0 && read_timeout <= INT_MAX / 1000)) {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  /*
+   * Listen on the socket
+   */
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", socket_path);
+    return EXIT_FAILURE;
+  }
+  strcpy(addr.sun_path, socket_path);
+
+  int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socket_path);
+  if (server_fd == -1 ||
+      bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+      listen(server_fd, SOMAXCONN) == -1) {
+    fprintf(stderr, "Failed to listen on socket: %s\n", socket_path);
+    return EXIT_FAILURE;
+  }
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stop;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  /*
+   * Start workers
+   */
+  queue_t queue;
+  queue.cap = 4 * n_workers;
+  queue.fds = malloc(sizeof(int) * queue.cap);
+  queue.head = 0;
+  queue.size = 0;
+  queue.closed = false;
+  pthread_mutex_init(&queue.mutex, NULL);
+  pthread_cond_init(&queue.not_empty, NULL);
+  pthread_cond_init(&queue.not_full, NULL);
+
+  pthread_t *threads = malloc(sizeof(pthread_t) * n_workers);
+  worker_t *workers = malloc(sizeof(worker_t) * n_workers);
+  for (int i = 0; i < n_workers; i++) {
+    workers[i].queue = &queue;
+    workers[i].param = &param;
+    workers[i].read_timeout = read_timeout;
+    workers[i].n_contexts = n_contexts;
+    workers[i].contexts = calloc(n_contexts, sizeof(context_t));
+    workers[i].n_served = 0;
+    pthread_create(&threads[i], NULL, run_worker, &workers[i]);
+  }
+
+  fprintf(stdout, "Listening on %s with %d workers\n", socket_path, n_workers);
+  fflush(stdout);
+
+  /*
+   * Accept connections until interrupted
+   */
+  while (!stopped) {
+    int fd = accept(server_fd, NULL, NULL);
+    if (fd == -1) {
+      if (errno != EINTR) {
+        fprintf(stderr, "Failed to accept connection: %s\n", strerror(errno));
+      }
+      continue;
+    }
+    push_connection(&queue, fd);
+  }
+
+  /*
+   * Finish queued requests and shut down
+   */
+  pthread_mutex_lock(&queue.mutex);
+  queue.closed = true;
+  pthread_cond_broadcast(&queue.not_empty);
+  pthread_mutex_unlock(&queue.mutex);
+
+  long n_served = 0;
+  for (int i = 0; i < n_workers; i++) {
+    pthread_join(threads[i], NULL);
+    for (int j = 0; j < n_contexts; j++) {
+      if (workers[i].contexts[j].solver != NULL) {
+        ucrp_free_solver(workers[i].contexts[j].solver);
+      }
+    }
+    free(workers[i].contexts);
+    n_served += workers[i].n_served;
+  }
+  free(workers);
+  free(threads);
+  free(queue.fds);
+  pthread_mutex_destroy(&queue.mutex);
+  pthread_cond_destroy(&queue.not_empty);
+  pthread_cond_destroy(&queue.not_full);
+
+  close(server_fd);
+  unlink(socket_path);
+  fprintf(stdout, "Served %ld requests\n", n_served);
+  return EXIT_SUCCESS;
+}
@@ -15,8 +15,12 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
-#include "algorithm.h"
+#include "batch.h"
+#include "param.h"
+#include "result_cache.h"
+#include "ucrp.h"
 #include <getopt.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -24,27 +28,176 @@ static void usage(void) {
   fprintf(stdout, "usage: main-solve -h\n");
   fprintf(stdout, "usage: main-solve"
                   " --input/-i input_file"
-                  " --time_limit/-t time_limit\n");
-  fprintf(stdout, "\t--input/-i: input file\n");
-  fprintf(stdout, "\t--time_limit/-t: time limit in seconds\n");
+                  " --time_limit/-t time_limit"
+                  " [--threads/-j n_threads]"
+                  " [--beam_width/-b beam_width]"
+                  " [--restarts/-r n_restarts]"
+                  " [--restart_time/-R restart_time]"
+                  " [--seed/-s seed]"
+                  " [--heuristic_only/-H]"
+                  " [--probe/-p always|adaptive]"
+                  " [--probe_threshold/-P probe_threshold]"
+                  " [--probe_cache/-c probe_cache_size]"
+                  " [--calibration/-k calibration_nodes]"
+                  " [--check_profile/-K profile_file]"
+                  " [--lazy_order/-L]"
+                  " [--engine/-e idbb|astar|fringe]"
+                  " [--node_memory/-M megabytes]"
+                  " [--initial_solution/-I solution_file]"
+                  " [--result_cache/-C cache_file]"
+                  " [--output_format/-o text|json|csv]"
+                  " [--quiet/-q | --progress/-v]\n");
+  fprintf(stdout, "\t--input/-i: input file with one or more instances\n");
+  fprintf(stdout, "\t--time_limit/-t: wall-clock time limit in seconds\n");
+  fprintf(stdout, "\t--threads/-j: number of worker threads\n");
+  fprintf(stdout, "\t--beam_width/-b: beam width for the initial upper bound"
+                  " (0 to disable)\n");
+  fprintf(stdout, "\t--restarts/-r: number of randomized JZW/SM-2 restarts"
+                  " (0 to disable)\n");
+  fprintf(stdout, "\t--restart_time/-R: time limit of the restarts in"
+                  " seconds\n");
+  fprintf(stdout, "\t--seed/-s: random seed of the restarts\n");
+  fprintf(stdout, "\t--heuristic_only/-H: skip iterative deepening\n");
+  fprintf(stdout, "\t--probe/-p: probing policy\n");
+  fprintf(stdout, "\t--probe_threshold/-P: misses in a row before adaptive"
+                  " probing backs off\n");
+  fprintf(stdout, "\t--probe_cache/-c: entries of the probe cache"
+                  " (0 to disable)\n");
+  fprintf(stdout, "\t--calibration/-k: nodes to time the dominance checks"
+                  " before ordering them by prunes per cycle (0, the"
+                  " default, to keep the rule order)\n");
+  fprintf(stdout, "\t--check_profile/-K: file to load the order of the"
+                  " dominance checks from, or to record the calibrated one"
+                  " in\n");
+  fprintf(stdout, "\t--lazy_order/-L: sort the stacks of a child by"
+                  " priority only once it is expanded, hashed or probed\n");
+  fprintf(stdout, "\t--engine/-e: iterative deepening, best-first search"
+                  " by the lower bound, or iterative deepening restarting"
+                  " from the nodes cut in the previous iteration\n");
+  fprintf(stdout, "\t--node_memory/-M: megabytes of nodes stored by astar"
+                  " or fringe before they fall back to iterative"
+                  " deepening\n");
+  fprintf(stdout, "\t--initial_solution/-I: moves in the output format to"
+                  " start from instead of JZW and SM-2\n");
+  fprintf(stdout, "\t--result_cache/-C: file of results to reuse and"
+                  " extend; instances proven optimal before are not solved"
+                  " again\n");
+  fprintf(stdout, "\t--output_format/-o: text prints the board and the"
+                  " search progress; json and csv print one line of report"
+                  " fields per instance\n");
+  fprintf(stdout, "\t--quiet/-q: print the solutions only\n");
+  fprintf(stdout, "\t--progress/-v: also print the search progress"
+                  " periodically\n");
   fprintf(stdout, "input format:\n");
   fprintf(stdout, "\tline 0: n_stacks n_tiers n_blocks\n");
   fprintf(stdout, "\tline 1: h1 p[1][1] ... p[1][h1]\n");
   fprintf(stdout, "\tline 2: h2 p[2][1] ... p[2][h2]\n");
   fprintf(stdout, "\t...\n");
   fprintf(stdout, "\tline S: hS p[S][1] ... p[S][hS]\n");
+  fprintf(stdout, "\tmore instances may follow in the same format;"
+                  " use - as input_file for stdin\n");
+  fprintf(stdout, "\tbinary batch files from main-convert are also accepted\n");
   fflush(stdout);
 }
 
+/*
+ * Solve an instance, unless the cache proves it optimal. A cached solution
+ * which is not proven optimal is the incumbent, and the result is merged back
+ * into the cache.
+ */
+static report_t *solve_cached(instance_t *inst, param_t *param,
+                              result_cache_t *cache) {
+  if (cache == NULL) {
+    return ucrp_solve(inst, param);
+  }
+  report_t *cached = lookup_result(cache, inst);
+  if (cached != NULL && cached->best_lb == cached->best_ub) {
+    if (param->log_level != LOG_QUIET) {
+      fprintf(stdout, "[cache] best_lb = %d / best_ub = %d\n",
+              cached->best_lb, cached->best_ub);
+    }
+    return cached;
+  }
+
+  param_t cached_param = *param;
+  if (cached != NULL && param->initial_sol == NULL) {
+    cached_param.initial_sol = cached->best_sol;
+    cached_param.initial_len = cached->best_ub;
+  }
+  report_t *report = ucrp_solve(inst, &cached_param);
+  if (report != NULL) {
+    store_result(cache, inst, report);
+  }
+  if (cached != NULL) {
+    ucrp_free_report(cached);
+  }
+  return report;
+}
+
+static void solve_instance(instance_t *inst, param_t *param,
+                           result_cache_t *cache, long id, int format) {
+  if (format != OUTPUT_TEXT) {
+    report_t *report = solve_cached(inst, param, cache);
+    print_report(stdout, format, id, report);
+    if (report != NULL) {
+      ucrp_free_report(report);
+    }
+    return;
+  }
+
+  if (param->log_level != LOG_QUIET) {
+    print_instance(stdout, inst);
+    fflush(stdout);
+  }
+
+  report_t *report = solve_cached(inst, param, cache);
+  if (param->logger != NULL) {
+    flush_logger(param->logger); // progress lines go before the solution
+  }
+  if (report == NULL) {
+    print_moves(stdout, NULL, INT_MAX);
+  } else {
+    print_moves(stdout, report->best_sol, report->best_ub);
+    ucrp_free_report(report);
+  }
+  if (param->log_level != LOG_QUIET) {
+    fflush(stdout);
+  }
+}
+
 int main(int argc, char **argv) {
-  char *opts = "hi:t:";
+  char *opts = "hi:t:j:b:r:R:s:Hp:P:c:k:K:Le:M:I:C:o:qv";
   struct option options[] = {{"help", no_argument, NULL, 'h'},
                              {"input", required_argument, NULL, 'i'},
                              {"time_limit", required_argument, NULL, 't'},
+                             {"threads", required_argument, NULL, 'j'},
+                             {"beam_width", required_argument, NULL, 'b'},
+                             {"restarts", required_argument, NULL, 'r'},
+                             {"restart_time", required_argument, NULL, 'R'},
+                             {"seed", required_argument, NULL, 's'},
+                             {"heuristic_only", no_argument, NULL, 'H'},
+                             {"probe", required_argument, NULL, 'p'},
+                             {"probe_threshold", required_argument, NULL, 'P'},
+                             {"probe_cache", required_argument, NULL, 'c'},
+                             {"calibration", required_argument, NULL, 'k'},
+                             {"check_profile", required_argument, NULL, 'K'},
+                             {"lazy_order", no_argument, NULL, 'L'},
+                             {"engine", required_argument, NULL, 'e'},
+                             {"node_memory", required_argument, NULL, 'M'},
+                             {"initial_solution", required_argument, NULL,
+                              'I'},
+                             {"result_cache", required_argument, NULL, 'C'},
+                             {"output_format", required_argument, NULL, 'o'},
+                             {"quiet", no_argument, NULL, 'q'},
+                             {"progress", no_argument, NULL, 'v'},
                              {NULL, 0, NULL, 0}};
 
   char *input = "data/test.txt";
-  int time_limit = 1800;
+  char *initial_solution = NULL;
+  char *result_cache = NULL;
+  int format = OUTPUT_TEXT;
+  param_t param;
+  init_param(&param);
 
   for (int opt; (opt = getopt_long(argc, argv, opts, options, NULL)) != -1;) {
     switch (opt) {
@@ -55,7 +208,89 @@ int main(int argc, char **argv) {
       input = optarg;
       break;
     case 't':
-      time_limit = (int)strtol(optarg, NULL, 10);
+      param.time_limit = strtod(optarg, NULL);
+      break;
+    case 'j':
+      param.n_threads = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'b':
+      param.beam_width = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'r':
+      param.n_restarts = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'R':
+      param.restart_time = strtod(optarg, NULL);
+      break;
+    case 's':
+      param.seed = (unsigned)strtoul(optarg, NULL, 10);
+      break;
+    case 'H':
+      param.heuristic_only = true;
+      break;
+    case 'p':
+      if (strcmp(optarg, "always") == 0) {
+        param.probe_policy = PROBE_ALWAYS;
+      } else if (strcmp(optarg, "adaptive") == 0) {
+        param.probe_policy = PROBE_ADAPTIVE;
+      } else {
+        fprintf(stderr, "Unknown probing policy: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'P':
+      param.probe_threshold = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'c':
+      param.probe_cache_size = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'k':
+      param.calibration_nodes = strtol(optarg, NULL, 10);
+      break;
+    case 'K':
+      param.check_profile = optarg;
+      break;
+    case 'L':
+      param.lazy_order = true;
+      break;
+    case 'e':
+      if (strcmp(optarg, "idbb") == 0) {
+        param.engine = ENGINE_IDBB;
+      } else if (strcmp(optarg, "astar") == 0) {
+        param.engine = ENGINE_ASTAR;
+      } else if (strcmp(optarg, "fringe") == 0) {
+        param.engine = ENGINE_FRINGE;
+      } else {
+        fprintf(stderr, "Unknown engine: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'M':
+      param.node_memory = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'I':
+      initial_solution = optarg;
+      break;
+    case 'C':
+      result_cache = optarg;
+      break;
+    case 'o':
+      if (strcmp(optarg, "text") == 0) {
+        format = OUTPUT_TEXT;
+      } else if (strcmp(optarg, "json") == 0) {
+        format = OUTPUT_JSON;
+      } else if (strcmp(optarg, "csv") == 0) {
+        format = OUTPUT_CSV;
+      } else {
+        fprintf(stderr, "Unknown output format: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'q':
+      param.log_level = LOG_QUIET;
+      break;
+    case 'v':
+      param.log_level = LOG_PROGRESS;
       break;
     default:
       fprintf(stderr, "Unknown option: %c\n", opt);
@@ -63,29 +298,145 @@ int main(int argc, char **argv) {
     }
   }
 
-  fprintf(stdout,
-          "Parameters:\n"
-          "\tinput = %s\n"
-          "\ttime_limit = %d\n",
-          input, time_limit);
-  fflush(stdout);
+  if (initial_solution != NULL) {
+    FILE *fp = fopen(initial_solution, "r");
+    if (fp == NULL) {
+      fprintf(stderr, "Failed to open file: %s\n", initial_solution);
+      return EXIT_FAILURE;
+    }
+    param.initial_sol = read_moves(fp, &param.initial_len);
+    fclose(fp);
+    if (param.initial_sol == NULL) {
+      fprintf(stderr, "Failed to read moves from: %s\n", initial_solution);
+      return EXIT_FAILURE;
+    }
+  }
 
-  instance_t *inst = read_instance(input);
-  if (inst == NULL) {
-    fprintf(stderr, "Failed to read instance from: %s\n", input);
-    return EXIT_FAILURE;
+  /*
+   * Structured or quiet output gets a large buffer and no progress lines in
+   * between
+   */
+  if (format != OUTPUT_TEXT) {
+    param.log_level = LOG_QUIET;
+  }
+  if (param.log_level == LOG_QUIET) {
+    setvbuf(stdout, NULL, _IOFBF, 1 << 20);
+    print_report_header(stdout, format);
+  } else {
+    fprintf(stdout,
+            "Parameters:\n"
+            "\tinput = %s\n"
+            "\ttime_limit = %g\n"
+            "\tn_threads = %d\n"
+            "\tbeam_width = %d\n"
+            "\tn_restarts = %d\n"
+            "\trestart_time = %.3f\n"
+            "\tseed = %u\n"
+            "\theuristic_only = %s\n"
+            "\tprobe_policy = %s\n"
+            "\tprobe_threshold = %d\n"
+            "\tprobe_cache_size = %d\n"
+            "\tcalibration_nodes = %ld\n"
+            "\tcheck_profile = %s\n"
+            "\tlazy_order = %s\n"
+            "\tengine = %s\n"
+            "\tnode_memory = %d\n"
+            "\tinitial_solution = %s\n"
+            "\tresult_cache = %s\n"
+            "\tlog_level = %s\n",
+            input, param.time_limit, param.n_threads, param.beam_width,
+            param.n_restarts, param.restart_time, param.seed,
+            param.heuristic_only ? "true" : "false",
+            param.probe_policy == PROBE_ALWAYS ? "always" : "adaptive",
+            param.probe_threshold, param.probe_cache_size,
+            param.calibration_nodes,
+            param.check_profile != NULL ? param.check_profile : "none",
+            param.lazy_order ? "true" : "false",
+            param.engine == ENGINE_IDBB    ? "idbb"
+            : param.engine == ENGINE_ASTAR ? "astar"
+                                           : "fringe",
+            param.node_memory,
+            initial_solution != NULL ? initial_solution : "none",
+            result_cache != NULL ? result_cache : "none",
+            param.log_level == LOG_NORMAL ? "normal" : "progress");
+    fflush(stdout);
   }
 
-  print_instance(stdout, inst);
-  fflush(stdout);
+  batch_t *batch = NULL;
+  FILE *fp = NULL;
+  if (strcmp(input, "-") != 0 && is_batch_file(input)) {
+    batch = open_batch(input);
+    if (batch == NULL) {
+      return EXIT_FAILURE;
+    }
+  } else {
+    fp = strcmp(input, "-") == 0 ? stdin : fopen(input, "r");
+    if (fp == NULL) {
+      fprintf(stderr, "Failed to open file: %s\n", input);
+      return EXIT_FAILURE;
+    }
+  }
 
-  report_t *report = solve(inst, time_limit);
+  result_cache_t *cache = NULL;
+  if (result_cache != NULL) {
+    cache = open_result_cache(result_cache);
+    if (cache == NULL) {
+      return EXIT_FAILURE;
+    }
+  }
 
-  print_moves(stdout, report->best_sol, report->best_ub);
-  fflush(stdout);
+  /*
+   * Progress lines are printed by a background thread
+   */
+  if (param.log_level != LOG_QUIET) {
+    param.logger = open_logger(stdout, 1024);
+  }
 
-  free_instance(inst);
-  free_report(report);
+  int n_read = 0;
+  int n_failed = 0;
+  if (batch != NULL) {
+    for (long i = 0; i < batch->n_instances; i++) {
+      instance_t *inst = get_batch_instance(batch, i);
+      if (inst == NULL) {
+        fprintf(stderr, "Skipped corrupt instance %ld from: %s\n", i, input);
+        n_failed++;
+        continue;
+      }
+      n_read++;
+      solve_instance(inst, &param, cache, i, format);
+      free_instance(inst);
+    }
+    close_batch(batch);
+  } else {
+    reader_t *reader = open_reader(fp);
+    instance_t *inst;
+    for (int status; (status = read_next_instance(reader, &inst)) != 0;) {
+      if (status < 0) {
+        fprintf(stderr, "Skipped malformed instance %d from: %s\n",
+                n_read + n_failed, input);
+        n_failed++;
+        continue;
+      }
+      solve_instance(inst, &param, cache, n_read + n_failed, format);
+      n_read++;
+    }
 
-  return EXIT_SUCCESS;
+    close_reader(reader);
+    if (fp != stdin) {
+      fclose(fp);
+    }
+  }
+
+  if (param.logger != NULL) {
+    close_logger(param.logger);
+  }
+  if (cache != NULL) {
+    close_result_cache(cache);
+  }
+  free(param.initial_sol);
+
+  if (n_read == 0 && n_failed == 0) {
+    fprintf(stderr, "Failed to read instance from: %s\n", input);
+  }
+  return n_read > 0 && n_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -19,6 +19,19 @@
 #include <stdlib.h>
 #include <string.h>
 
+/*
+ * Head arrays are allocated in one block, masks first, so that a head without
+ * tracking information is a prefix of one with it
+ */
+static int mask_words(int n_stacks) {
+  return (n_stacks + 63) / 64;
+}
+
+static size_t head_size(state_t *state) {
+  return sizeof(uint64_t) * 3 * mask_words(state->n_stacks) +
+         sizeof(int) * (state->tracked ? 7 : 3) * state->n_stacks;
+}
+
 state_t *malloc_state(int n_stacks, int n_tiers, bool has_head, bool has_body,
                       bool tracked) {
   state_t *state = malloc(sizeof(state_t));
@@ -27,19 +40,21 @@ state_t *malloc_state(int n_stacks, int n_tiers, bool has_head, bool has_body,
   state->has_head = has_head;
   state->has_body = has_body;
   state->tracked = tracked;
+  state->lazy = false;
+  state->ordered = true;
   if (has_head) {
+    state->not_empty = malloc(head_size(state));
+    state->not_full = state->not_empty + mask_words(n_stacks);
+    state->changed = state->not_full + mask_words(n_stacks);
+    state->h = (int *)(state->changed + mask_words(n_stacks));
+    state->list = state->h + 1 * n_stacks;
+    state->rank = state->h + 2 * n_stacks;
     if (tracked) {
-      state->h = malloc(sizeof(int) * 7 * n_stacks);
-      state->list = state->h + 1 * n_stacks;
-      state->rank = state->h + 2 * n_stacks;
       state->last_change_time = state->h + 3 * n_stacks;
       state->last_change_type = state->h + 4 * n_stacks;
       state->last_move_out_time = state->h + 5 * n_stacks;
       state->last_move_in_time = state->h + 6 * n_stacks;
     } else {
-      state->h = malloc(sizeof(int) * 3 * n_stacks);
-      state->list = state->h + 1 * n_stacks;
-      state->rank = state->h + 2 * n_stacks;
       state->last_change_time = NULL;
       state->last_change_type = NULL;
       state->last_move_out_time = NULL;
@@ -82,7 +97,7 @@ state_t *malloc_state(int n_stacks, int n_tiers, bool has_head, bool has_body,
 
 void free_state(state_t *state) {
   if (state->has_head) {
-    free(state->h);
+    free(state->not_empty);
   }
   if (state->has_body) {
     free(state->p[0]);
@@ -94,11 +109,8 @@ void free_state(state_t *state) {
 void copy_state_head(state_t *dst_state, state_t *src_state) {
   dst_state->n_blocks = src_state->n_blocks;
   dst_state->n_bad = src_state->n_bad;
-  if (dst_state->tracked) {
-    memcpy(dst_state->h, src_state->h, sizeof(int) * 7 * dst_state->n_stacks);
-  } else {
-    memcpy(dst_state->h, src_state->h, sizeof(int) * 3 * dst_state->n_stacks);
-  }
+  dst_state->ordered = src_state->ordered;
+  memcpy(dst_state->not_empty, src_state->not_empty, head_size(dst_state));
 }
 
 void copy_state_body(state_t *dst_state, state_t *src_state) {
@@ -114,11 +126,15 @@ void copy_state_body(state_t *dst_state, state_t *src_state) {
 void copy_state(state_t *dst_state, state_t *src_state) {
   copy_state_head(dst_state, src_state);
   copy_state_body(dst_state, src_state);
+  if (!dst_state->lazy) {
+    order_stacks(dst_state);
+  }
 }
 
 void reuse_state_head(state_t *dst_state, state_t *src_state) {
   dst_state->n_blocks = src_state->n_blocks;
   dst_state->n_bad = src_state->n_bad;
+  dst_state->ordered = src_state->ordered;
   dst_state->h = src_state->h;
   dst_state->list = src_state->list;
   dst_state->rank = src_state->rank;
@@ -126,6 +142,9 @@ void reuse_state_head(state_t *dst_state, state_t *src_state) {
   dst_state->last_change_type = src_state->last_change_type;
   dst_state->last_move_out_time = src_state->last_move_out_time;
   dst_state->last_move_in_time = src_state->last_move_in_time;
+  dst_state->not_empty = src_state->not_empty;
+  dst_state->not_full = src_state->not_full;
+  dst_state->changed = src_state->changed;
 }
 
 void reuse_state_body(state_t *dst_state, state_t *src_state) {
@@ -135,19 +154,16 @@ void reuse_state_body(state_t *dst_state, state_t *src_state) {
   dst_state->l = src_state->l;
 }
 
-bool is_retrievable(state_t *state) {
-  return state->n_blocks > 0 &&
-         state->b[state->list[0]][state->h[state->list[0]]] == 0;
-}
-
-bool has_empty_stack(state_t *state) {
-  return state->h[state->list[state->n_stacks - 1]] == 0;
-}
-
+/*
+ * Order of the list of stacks, which has no ties, so that sorting on every
+ * change and sorting on demand give the same list whatever the changes
+ */
 static int compare(state_t *state, int s1, int s2) {
   return state->q[s1][state->h[s1]] != state->q[s2][state->h[s2]]
              ? state->q[s1][state->h[s1]] - state->q[s2][state->h[s2]]
-             : state->b[s1][state->h[s1]] - state->b[s2][state->h[s2]];
+         : state->b[s1][state->h[s1]] != state->b[s2][state->h[s2]]
+             ? state->b[s1][state->h[s1]] - state->b[s2][state->h[s2]]
+             : s1 - s2;
 }
 
 static void adjust_left(state_t *state, int s) {
@@ -168,6 +184,111 @@ static void adjust_right(state_t *state, int s) {
   state->list[state->rank[s] = i] = s;
 }
 
+/*
+ * Lazy ordering
+ *
+ * A lazy state leaves list and rank as they were at its last sort, and marks
+ * the stacks that change in the meantime. The stacks not marked keep their
+ * order in the stale list, so the first of them and the marked ones are the
+ * only candidates for the first stack, of which the sort would put the
+ * smallest first.
+ */
+void set_lazy_order(state_t *state, bool lazy) {
+  state->lazy = lazy;
+}
+
+static inline void mark_stack(state_t *state, int s) {
+  state->ordered = false;
+  state->changed[s >> 6] |= (uint64_t)1 << (s & 63);
+}
+
+static inline bool is_marked(state_t *state, int s) {
+  return state->changed[s >> 6] >> (s & 63) & 1;
+}
+
+void order_stacks(state_t *state) {
+  if (state->ordered) {
+    return;
+  }
+  for (int i = 1; i < state->n_stacks; i++) {
+    adjust_left(state, state->list[i]);
+  }
+  memset(state->changed, 0, sizeof(uint64_t) * mask_words(state->n_stacks));
+  state->ordered = true;
+}
+
+int first_stack(state_t *state) {
+  if (state->ordered) {
+    return state->list[0];
+  }
+  int first = -1;
+  for (int i = 0; i < state->n_stacks && first == -1; i++) {
+    if (!is_marked(state, state->list[i])) {
+      first = state->list[i];
+    }
+  }
+  for (int s = next_stack(state->changed, 0, state->n_stacks);
+       s < state->n_stacks;
+       s = next_stack(state->changed, s + 1, state->n_stacks)) {
+    if (first == -1 || compare(state, s, first) < 0) {
+      first = s;
+    }
+  }
+  return first;
+}
+
+bool is_retrievable(state_t *state) {
+  if (state->n_blocks == 0) {
+    return false;
+  }
+  int s = first_stack(state);
+  return state->b[s][state->h[s]] == 0;
+}
+
+bool has_empty_stack(state_t *state) {
+  if (state->ordered) {
+    return state->h[state->list[state->n_stacks - 1]] == 0;
+  }
+  for (int w = 0; w < mask_words(state->n_stacks); w++) {
+    int n_bits = state->n_stacks - 64 * w;
+    uint64_t all = n_bits >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << n_bits) - 1;
+    if (state->not_empty[w] != all) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint64_t hash_state(state_t *state) {
+  order_stacks(state);
+  uint64_t key = 0xcbf29ce484222325u;
+  for (int s = 0; s < state->n_stacks; s++) {
+    key = (key ^ (uint64_t)state->h[s]) * 0x100000001b3u;
+    for (int t = 1; t <= state->h[s]; t++) {
+      key = (key ^ (uint64_t)state->p[s][t]) * 0x100000001b3u;
+    }
+  }
+  for (int i = 0; i < state->n_stacks; i++) {
+    key = (key ^ (uint64_t)state->list[i]) * 0x100000001b3u;
+  }
+  return key ^ (key >> 29);
+}
+
+/*
+ * Update not_empty and not_full after the height of a stack drops or rises
+ * by one
+ */
+static inline void lower_stack(state_t *state, int s) {
+  state->not_full[s >> 6] |= (uint64_t)1 << (s & 63);
+  state->not_empty[s >> 6] &= ~((uint64_t)(state->h[s] == 0) << (s & 63));
+}
+
+static inline void raise_stack(state_t *state, int s) {
+  state->not_empty[s >> 6] |= (uint64_t)1 << (s & 63);
+  state->not_full[s >> 6] &=
+      ~((uint64_t)(state->h[s] == state->n_tiers) << (s & 63));
+}
+
 void update_slot(state_t *state, int s, int t, int p, int l) {
   state->p[s][t] = p;
   if (t == 0 || p <= state->q[s][t - 1]) {
@@ -185,8 +306,17 @@ void update_slot(state_t *state, int s, int t, int p, int l) {
 void init_state(state_t *state, instance_t *inst) {
   state->n_blocks = inst->n_blocks;
   state->n_bad = 0;
+  state->ordered = true;
+  memset(state->not_empty, 0,
+         sizeof(uint64_t) * 3 * mask_words(state->n_stacks));
   for (int s = 0; s < state->n_stacks; s++) {
     state->h[s] = inst->h[s];
+    if (state->h[s] > 0) {
+      state->not_empty[s >> 6] |= (uint64_t)1 << (s & 63);
+    }
+    if (state->h[s] < state->n_tiers) {
+      state->not_full[s >> 6] |= (uint64_t)1 << (s & 63);
+    }
     update_slot(state, s, 0, inst->max_prio + 1, 0);
     for (int t = 1; t <= state->h[s]; t++) {
       update_slot(state, s, t, inst->p[s][t], 0);
@@ -205,12 +335,16 @@ void init_state(state_t *state, instance_t *inst) {
 }
 
 void move_out(state_t *state, int s, int l) {
-  if (state->b[s][state->h[s]--] > 0) {
-    state->n_bad--;
+  bool is_bad = state->b[s][state->h[s]--] > 0;
+  state->n_bad -= is_bad;
+  if (state->lazy) {
+    mark_stack(state, s);
+  } else if (is_bad) {
     adjust_left(state, s);
   } else {
     adjust_right(state, s);
   }
+  lower_stack(state, s);
   if (state->tracked) {
     state->last_change_time[s] = l;
     state->last_change_type[s] = MOVE_OUT;
@@ -220,12 +354,16 @@ void move_out(state_t *state, int s, int l) {
 
 void move_in(state_t *state, int d, int p, int l) {
   update_slot(state, d, ++state->h[d], p, l);
-  if (state->b[d][state->h[d]] > 0) {
-    state->n_bad++;
+  bool is_bad = state->b[d][state->h[d]] > 0;
+  state->n_bad += is_bad;
+  if (state->lazy) {
+    mark_stack(state, d);
+  } else if (is_bad) {
     adjust_right(state, d);
   } else {
     adjust_left(state, d);
   }
+  raise_stack(state, d);
   if (state->tracked) {
     state->last_change_time[d] = l;
     state->last_change_type[d] = MOVE_IN;
@@ -240,12 +378,55 @@ void relocate(state_t *state, int s, int d, int l) {
 }
 
 void retrieve(state_t *state, int l) {
-  int s = state->list[0];
+  int s = first_stack(state);
   state->n_blocks--;
   state->h[s]--;
-  adjust_right(state, s);
+  if (state->lazy) {
+    mark_stack(state, s);
+  } else {
+    adjust_right(state, s);
+  }
+  lower_stack(state, s);
   if (state->tracked) {
     state->last_change_time[s] = l;
     state->last_change_type[s] = RETRIEVE;
   }
 }
+
+int replay_moves(state_t *state, move_t *path, int len) {
+  while (is_retrievable(state)) {
+    retrieve(state, 0);
+  }
+  for (int i = 0; i < len; i++) {
+    int s = path[i].s;
+    int d = path[i].d;
+    if (s < 0 || s >= state->n_stacks || d < 0 || d >= state->n_stacks ||
+        s == d || state->h[s] == 0 || state->p[s][state->h[s]] != path[i].p ||
+        state->h[d] == state->n_tiers) {
+      return i;
+    }
+    relocate(state, s, d, i + 1);
+    while (is_retrievable(state)) {
+      retrieve(state, i + 1);
+    }
+  }
+  return len;
+}
+
+void print_state(FILE *fp, state_t *state) {
+  for (int t = state->n_tiers; t >= 1; t--) {
+    for (int s = 0; s < state->n_stacks; s++) {
+      if (state->h[s] < t) {
+        fprintf(fp, "[   ]");
+      } else {
+        fprintf(fp, "[%3d]", state->p[s][t]);
+      }
+    }
+    fprintf(fp, "\n");
+  }
+
+  for (int s = 0; s < state->n_stacks; s++) {
+    fprintf(fp, "-----");
+  }
+  fprintf(fp, "\n");
+}
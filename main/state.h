@@ -19,7 +19,9 @@
 #define STATE_H
 
 #include "instance.h"
+#include "move.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 enum { NEVER, MOVE_OUT, MOVE_IN, RETRIEVE };
 
@@ -29,11 +31,15 @@ typedef struct {
   bool has_head; // true if including head arrays
   bool has_body; // true if including body matrices
   bool tracked;  // true if including tracking information
+  bool lazy;     // true if sorting list and rank only on demand
+  bool ordered;  // true if list and rank are sorted
 
   int n_blocks;          // number of blocks
   int n_bad;             // number of badly-placed blocks
   int *h;                // h[s]: height of stack s
-  int *list;             // list[i]: i-th stack in the ordered list
+  int *list;             // list[i]: i-th stack in the ordered list, by the
+                         // quality then the badness of the top block, then
+                         // by index
   int *rank;             // rank[s]: rank of stack s
   int *last_change_time; // last_change_time[s]: time of last change to stack s
   int *last_change_type; // last_change_type[s]: type of last change to stack s
@@ -41,6 +47,10 @@ typedef struct {
                            // moving out of stack s
   int *last_move_in_time;  // last_move_in_time[s]: time of last relocation
                            // moving into stack s
+  uint64_t *not_empty; // bit s % 64 of not_empty[s / 64]: h[s] > 0
+  uint64_t *not_full;  // bit s % 64 of not_full[s / 64]: h[s] < n_tiers
+  uint64_t *changed;   // bit s % 64 of changed[s / 64]: stack s changed since
+                       // list and rank were last sorted
 
   int **p; // p[s][t]: priority
   int **q; // q[s][t]: quality, i.e., smallest among p[s][1...h[s]]
@@ -85,7 +95,8 @@ void copy_state_head(state_t *dst_state, state_t *src_state);
 void copy_state_body(state_t *dst_state, state_t *src_state);
 
 /**
- * Fully copy a state
+ * Fully copy a state, whose list of stacks gets sorted unless the destination
+ * state is lazy
  *
  * @param dst_state destination state
  * @param src_state source state
@@ -108,6 +119,32 @@ void reuse_state_head(state_t *dst_state, state_t *src_state);
  */
 void reuse_state_body(state_t *dst_state, state_t *src_state);
 
+/**
+ * Let a state sort its list of stacks only on demand, or again on every
+ * change, which is the default
+ *
+ * @param state the state
+ * @param lazy true to sort on demand
+ */
+void set_lazy_order(state_t *state, bool lazy);
+
+/**
+ * Sort the list of stacks of a lazy state, starting from the order it had
+ * the last time, into the order a state sorting on every change has
+ *
+ * @param state the state
+ */
+void order_stacks(state_t *state);
+
+/**
+ * Find the stack whose top block is the target, i.e., the first stack in the
+ * ordered list
+ *
+ * @param state the state
+ * @return the stack
+ */
+int first_stack(state_t *state);
+
 /**
  * Check if the target block is retrievable
  *
@@ -124,6 +161,38 @@ bool is_retrievable(state_t *state);
  */
 bool has_empty_stack(state_t *state);
 
+/**
+ * Find the next stack in a mask of stacks, such as not_empty or not_full
+ *
+ * @param mask the mask
+ * @param s first stack to consider
+ * @param n_stacks number of stacks
+ * @return smallest stack s' >= s in the mask, or n_stacks if none
+ */
+static inline int next_stack(const uint64_t *mask, int s, int n_stacks) {
+  if (s >= n_stacks) {
+    return n_stacks;
+  }
+  int w = s >> 6;
+  uint64_t bits = mask[w] & (~(uint64_t)0 << (s & 63));
+  while (bits == 0) {
+    if (++w << 6 >= n_stacks) {
+      return n_stacks;
+    }
+    bits = mask[w];
+  }
+  return (w << 6) + __builtin_ctzll(bits);
+}
+
+/**
+ * Hash the configuration and the stack order of a state, sorting the list of
+ * a lazy state first
+ *
+ * @param state the state
+ * @return 64-bit hash value
+ */
+uint64_t hash_state(state_t *state);
+
 /**
  * Update matrix information for a slot
  *
@@ -180,4 +249,25 @@ void relocate(state_t *state, int s, int d, int l);
  */
 void retrieve(state_t *state, int l);
 
+/**
+ * Replay moves on a state, performing all possible retrievals before the
+ * first move and after each move. Replaying stops at the first move that is
+ * not legal: a source stack without the given block on top, or a destination
+ * stack that is the source or full.
+ *
+ * @param state the state
+ * @param path array of moves
+ * @param len number of moves
+ * @return number of moves replayed, which is len if all moves are legal
+ */
+int replay_moves(state_t *state, move_t *path, int len);
+
+/**
+ * Print the bay of a state
+ *
+ * @param fp output stream
+ * @param state the state
+ */
+void print_state(FILE *fp, state_t *state);
+
 #endif
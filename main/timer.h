@@ -25,4 +25,20 @@
  */
 double get_time(void);
 
+/**
+ * Get the current wall-clock time, which unlike get_time() does not add up
+ * the processor time of concurrent threads
+ *
+ * @return current timestamp in seconds
+ */
+double get_wall_time(void);
+
+/**
+ * Get the processor time of the calling thread, which unlike get_time() is
+ * not affected by other threads of the process
+ *
+ * @return current timestamp in seconds
+ */
+double get_thread_time(void);
+
 #endif
@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ucrp.h"
+#include "algorithm.h"
+#include "lower_bound.h"
+#include "timer.h"
+#include "upper_bound.h"
+#include "verifier.h"
+#include <limits.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/*
+ * The public constants and moves mirror the internal ones, which the
+ * handles are cast to; a mismatch makes an array of negative size
+ */
+#define SAME(name, a, b) typedef char same_##name[(int)(a) == (int)(b) ? 1 : -1]
+SAME(engine_idbb, UCRP_ENGINE_IDBB, ENGINE_IDBB);
+SAME(engine_astar, UCRP_ENGINE_ASTAR, ENGINE_ASTAR);
+SAME(engine_fringe, UCRP_ENGINE_FRINGE, ENGINE_FRINGE);
+SAME(probe_always, UCRP_PROBE_ALWAYS, PROBE_ALWAYS);
+SAME(probe_adaptive, UCRP_PROBE_ADAPTIVE, PROBE_ADAPTIVE);
+SAME(log_quiet, UCRP_LOG_QUIET, LOG_QUIET);
+SAME(log_normal, UCRP_LOG_NORMAL, LOG_NORMAL);
+SAME(log_progress, UCRP_LOG_PROGRESS, LOG_PROGRESS);
+SAME(progress_start, UCRP_PROGRESS_START, PROGRESS_START);
+SAME(progress_update, UCRP_PROGRESS_UPDATE, PROGRESS_UPDATE);
+SAME(progress_deepen, UCRP_PROGRESS_DEEPEN, PROGRESS_DEEPEN);
+SAME(progress_heartbeat, UCRP_PROGRESS_HEARTBEAT, PROGRESS_HEARTBEAT);
+SAME(verify_valid, UCRP_VERIFY_VALID, VERIFY_VALID);
+SAME(verify_illegal, UCRP_VERIFY_ILLEGAL, VERIFY_ILLEGAL);
+SAME(verify_unfinished, UCRP_VERIFY_UNFINISHED, VERIFY_UNFINISHED);
+SAME(move_size, sizeof(ucrp_move_t), sizeof(move_t));
+SAME(move_p, offsetof(ucrp_move_t, p), offsetof(move_t, p));
+SAME(move_s, offsetof(ucrp_move_t, s), offsetof(move_t, s));
+SAME(move_d, offsetof(ucrp_move_t, d), offsetof(move_t, d));
+
+/*
+ * Instances
+ */
+
+ucrp_instance_t *ucrp_new_instance(int n_stacks, int n_tiers, const int *h,
+                                   const int *p) {
+  if (n_stacks < 1 || n_tiers < 1) {
+    return NULL;
+  }
+
+  instance_t *inst = malloc_instance(n_stacks, n_tiers);
+  if (inst == NULL) {
+    return NULL;
+  }
+  inst->n_blocks = 0;
+  inst->max_prio = 0;
+  for (int s = 0; s < n_stacks; s++) {
+    if (h[s] < 0 || h[s] > n_tiers) {
+      free_instance(inst);
+      return NULL;
+    }
+    inst->h[s] = h[s];
+    inst->n_blocks += h[s];
+    for (int t = 1; t <= h[s]; t++) {
+      inst->p[s][t] = p[(size_t)s * n_tiers + t - 1];
+      if (inst->p[s][t] < 1) {
+        free_instance(inst);
+        return NULL;
+      }
+      if (inst->max_prio < inst->p[s][t]) {
+        inst->max_prio = inst->p[s][t];
+      }
+    }
+  }
+  return inst;
+}
+
+void ucrp_free_instance(ucrp_instance_t *inst) { free_instance(inst); }
+
+/*
+ * Parameters
+ */
+
+ucrp_param_t *ucrp_new_param(void) {
+  param_t *param = malloc(sizeof(param_t));
+  init_param(param);
+  return param;
+}
+
+void ucrp_free_param(ucrp_param_t *param) { free(param); }
+
+void ucrp_param_set_time_limit(ucrp_param_t *param, double time_limit) {
+  param->time_limit = time_limit;
+}
+
+void ucrp_param_set_threads(ucrp_param_t *param, int n_threads) {
+  param->n_threads = n_threads;
+}
+
+void ucrp_param_set_beam_width(ucrp_param_t *param, int beam_width) {
+  param->beam_width = beam_width;
+}
+
+void ucrp_param_set_restarts(ucrp_param_t *param, int n_restarts,
+                             double restart_time, unsigned seed) {
+  param->n_restarts = n_restarts;
+  param->restart_time = restart_time;
+  param->seed = seed;
+}
+
+void ucrp_param_set_heuristic_only(ucrp_param_t *param, bool heuristic_only) {
+  param->heuristic_only = heuristic_only;
+}
+
+void ucrp_param_set_probe(ucrp_param_t *param, int policy, int threshold,
+                          int cache_size) {
+  param->probe_policy = policy;
+  param->probe_threshold = threshold;
+  param->probe_cache_size = cache_size;
+}
+
+void ucrp_param_set_engine(ucrp_param_t *param, int engine, int node_memory) {
+  param->engine = engine;
+  param->node_memory = node_memory;
+}
+
+void ucrp_param_set_calibration(ucrp_param_t *param, long calibration_nodes,
+                                const char *check_profile) {
+  param->calibration_nodes = calibration_nodes;
+  param->check_profile = check_profile;
+}
+
+void ucrp_param_set_progress(ucrp_param_t *param, int log_level,
+                             ucrp_progress_fn progress, void *data,
+                             long heartbeat_nodes) {
+  param->log_level = log_level;
+  param->progress = progress;
+  param->progress_data = data;
+  param->heartbeat_nodes = heartbeat_nodes;
+}
+
+void ucrp_param_set_initial_solution(ucrp_param_t *param,
+                                     const ucrp_move_t *moves, int len) {
+  param->initial_sol = (move_t *)moves; // only read
+  param->initial_len = moves != NULL ? len : 0;
+}
+
+/*
+ * Solving
+ */
+
+ucrp_report_t *ucrp_solve(ucrp_instance_t *inst, ucrp_param_t *param) {
+  if (param != NULL) {
+    return solve(inst, param);
+  }
+  param_t defaults;
+  init_param(&defaults);
+  return solve(inst, &defaults);
+}
+
+ucrp_solver_t *ucrp_new_solver(int n_stacks, int n_tiers) {
+  return malloc_solver(n_stacks, n_tiers);
+}
+
+ucrp_report_t *ucrp_run_solver(ucrp_solver_t *solver, ucrp_instance_t *inst,
+                               ucrp_param_t *param) {
+  if (param != NULL) {
+    return run_solver(solver, inst, param);
+  }
+  param_t defaults;
+  init_param(&defaults);
+  return run_solver(solver, inst, &defaults);
+}
+
+void ucrp_free_solver(ucrp_solver_t *solver) { free_solver(solver); }
+
+/*
+ * Root state after the retrievals that need no relocation
+ */
+static state_t *new_root_state(instance_t *inst) {
+  state_t *state =
+      malloc_state(inst->n_stacks, inst->n_tiers, true, true, false);
+  init_state(state, inst);
+  while (is_retrievable(state)) {
+    retrieve(state, 0);
+  }
+  return state;
+}
+
+ucrp_report_t *ucrp_solve_heuristic(ucrp_instance_t *inst, int heuristic) {
+  double start_time = get_wall_time();
+  int (*run)(state_t *, move_t *, int, int) =
+      heuristic == UCRP_JZW ? jzw : sm2;
+
+  state_t *root_state = new_root_state(inst);
+  state_t *state =
+      malloc_state(inst->n_stacks, inst->n_tiers, true, true, false);
+  int *array_s1 = malloc(sizeof(int) * lb_ts_temp_size(inst->n_stacks));
+  int lb =
+      root_state->n_blocks == 0 ? 0 : lb_ts(root_state, INT_MAX, array_s1);
+
+  copy_state(state, root_state);
+  int len = run(state, NULL, 0, INT_MAX);
+  report_t *report = NULL;
+  if (len != INT_MAX) {
+    move_t *sol = malloc(sizeof(move_t) * (len > 0 ? len : 1));
+    copy_state(state, root_state);
+    run(state, sol, 0, INT_MAX);
+    double time_used = get_wall_time() - start_time;
+    report = new_report(lb, len, lb, len, sol, 0, time_used, time_used, 0, 0,
+                        0, 0, 0);
+    free(sol);
+  }
+
+  free_state(root_state);
+  free_state(state);
+  free(array_s1);
+  return report;
+}
+
+int ucrp_lower_bound(ucrp_instance_t *inst) {
+  state_t *root_state = new_root_state(inst);
+  int *array_s1 = malloc(sizeof(int) * lb_ts_temp_size(inst->n_stacks));
+  int lb =
+      root_state->n_blocks == 0 ? 0 : lb_ts(root_state, INT_MAX, array_s1);
+  free_state(root_state);
+  free(array_s1);
+  return lb;
+}
+
+/*
+ * Reports and progress events
+ */
+
+int ucrp_report_lb(const ucrp_report_t *report) { return report->best_lb; }
+
+int ucrp_report_ub(const ucrp_report_t *report) { return report->best_ub; }
+
+const ucrp_move_t *ucrp_report_moves(const ucrp_report_t *report) {
+  return (const ucrp_move_t *)report->best_sol;
+}
+
+double ucrp_report_time(const ucrp_report_t *report) {
+  return report->time_used;
+}
+
+long ucrp_report_nodes(const ucrp_report_t *report) {
+  return report->n_nodes;
+}
+
+void ucrp_free_report(ucrp_report_t *report) { free_report(report); }
+
+int ucrp_progress_type(const ucrp_progress_t *progress) {
+  return progress->type;
+}
+
+int ucrp_progress_lb(const ucrp_progress_t *progress) {
+  return progress->best_lb;
+}
+
+int ucrp_progress_ub(const ucrp_progress_t *progress) {
+  return progress->best_ub;
+}
+
+const ucrp_move_t *ucrp_progress_moves(const ucrp_progress_t *progress) {
+  return (const ucrp_move_t *)progress->best_sol;
+}
+
+double ucrp_progress_time(const ucrp_progress_t *progress) {
+  return progress->time;
+}
+
+long ucrp_progress_nodes(const ucrp_progress_t *progress) {
+  return progress->n_nodes;
+}
+
+/*
+ * Verification
+ */
+
+int ucrp_verify(ucrp_instance_t *inst, const ucrp_move_t *moves, int len,
+                FILE *trace) {
+  verify_t result;
+  state_t *state =
+      malloc_state(inst->n_stacks, inst->n_tiers, true, true, false);
+  verify_moves(state, inst, (move_t *)moves, len, trace, &result);
+  free_state(state);
+  return result.status;
+}
+
+long ucrp_verify_batch(FILE *instances, FILE *solutions, FILE *out,
+                       FILE *trace) {
+  reader_t *reader = open_reader(instances);
+  long n_invalid = verify_batch(reader, solutions, out, trace);
+  close_reader(reader);
+  return n_invalid;
+}
@@ -0,0 +1,399 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef UCRP_H
+#define UCRP_H
+
+/*
+ * Stable interface of the ucrp library, the only header installed with it.
+ * Instances, parameters, reports, progress events and solvers are opaque
+ * handles, only created and read through the functions below, so that the
+ * fields added to them later do not change the interface.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+
+enum { UCRP_JZW, UCRP_SM2 };
+enum { UCRP_ENGINE_IDBB, UCRP_ENGINE_ASTAR, UCRP_ENGINE_FRINGE };
+enum { UCRP_PROBE_ALWAYS, UCRP_PROBE_ADAPTIVE };
+enum { UCRP_LOG_QUIET, UCRP_LOG_NORMAL, UCRP_LOG_PROGRESS };
+enum {
+  UCRP_PROGRESS_START,
+  UCRP_PROGRESS_UPDATE,
+  UCRP_PROGRESS_DEEPEN,
+  UCRP_PROGRESS_HEARTBEAT
+};
+enum { UCRP_VERIFY_VALID, UCRP_VERIFY_ILLEGAL, UCRP_VERIFY_UNFINISHED };
+
+typedef struct {
+  int p; // priority of the block relocated
+  int s; // source stack, from 0
+  int d; // destination stack, from 0
+} ucrp_move_t;
+
+typedef struct instance ucrp_instance_t;
+typedef struct param ucrp_param_t;
+typedef struct report ucrp_report_t;
+typedef struct progress ucrp_progress_t;
+typedef struct solver ucrp_solver_t;
+
+/**
+ * Callback on the progress of the search, which fires once at the start, on
+ * every improved upper bound, on every deepening and every heartbeat
+ *
+ * @param progress the progress, only valid during the callback
+ * @param data user data given with the callback
+ * @return true to stop the search and report the best solution so far
+ */
+typedef bool (*ucrp_progress_fn)(const ucrp_progress_t *progress, void *data);
+
+/*
+ * Instances
+ */
+
+/**
+ * Create an instance from arrays
+ *
+ * @param n_stacks number of stacks
+ * @param n_tiers number of tiers
+ * @param h h[s]: height of stack s
+ * @param p p[s * n_tiers + t - 1]: priority of the block at tier t of stack s,
+ * counted from 1 at the bottom; entries above the height are ignored
+ * @return created instance or NULL if the arrays are not a valid instance
+ */
+ucrp_instance_t *ucrp_new_instance(int n_stacks, int n_tiers, const int *h,
+                                   const int *p);
+
+/**
+ * Free the space of an instance
+ *
+ * @param inst the instance
+ */
+void ucrp_free_instance(ucrp_instance_t *inst);
+
+/*
+ * Parameters
+ */
+
+/**
+ * Create parameters with default values; progress is printed to stdout
+ * unless the log level is set to UCRP_LOG_QUIET
+ *
+ * @return created parameters
+ */
+ucrp_param_t *ucrp_new_param(void);
+
+/**
+ * Free the space of parameters
+ *
+ * @param param the parameters
+ */
+void ucrp_free_param(ucrp_param_t *param);
+
+/**
+ * Set the time limit
+ *
+ * @param param the parameters
+ * @param time_limit wall-clock time limit in seconds, fractional allowed
+ */
+void ucrp_param_set_time_limit(ucrp_param_t *param, double time_limit);
+
+/**
+ * Set the number of worker threads of the heuristics
+ *
+ * @param param the parameters
+ * @param n_threads number of worker threads
+ */
+void ucrp_param_set_threads(ucrp_param_t *param, int n_threads);
+
+/**
+ * Set the beam width of the initial upper bound
+ *
+ * @param param the parameters
+ * @param beam_width beam width (0 to disable)
+ */
+void ucrp_param_set_beam_width(ucrp_param_t *param, int beam_width);
+
+/**
+ * Set the randomized restarts of the initial upper bound
+ *
+ * @param param the parameters
+ * @param n_restarts number of restarts (0 to disable)
+ * @param restart_time wall-clock time limit of the restarts in seconds
+ * @param seed random seed
+ */
+void ucrp_param_set_restarts(ucrp_param_t *param, int n_restarts,
+                             double restart_time, unsigned seed);
+
+/**
+ * Set whether to stop after the initial upper bound
+ *
+ * @param param the parameters
+ * @param heuristic_only true to skip the search
+ */
+void ucrp_param_set_heuristic_only(ucrp_param_t *param, bool heuristic_only);
+
+/**
+ * Set the probing of the heuristics in the search
+ *
+ * @param param the parameters
+ * @param policy UCRP_PROBE_ALWAYS or UCRP_PROBE_ADAPTIVE
+ * @param threshold misses in a row before adaptive probing backs off
+ * @param cache_size entries of the probe cache (0 to disable)
+ */
+void ucrp_param_set_probe(ucrp_param_t *param, int policy, int threshold,
+                          int cache_size);
+
+/**
+ * Set the search engine
+ *
+ * @param param the parameters
+ * @param engine UCRP_ENGINE_IDBB, UCRP_ENGINE_ASTAR or UCRP_ENGINE_FRINGE
+ * @param node_memory megabytes of nodes stored by UCRP_ENGINE_ASTAR or
+ * UCRP_ENGINE_FRINGE before they fall back to iterative deepening
+ */
+void ucrp_param_set_engine(ucrp_param_t *param, int engine, int node_memory);
+
+/**
+ * Set the ordering of the dominance checks
+ *
+ * @param param the parameters
+ * @param calibration_nodes nodes to time the checks before ordering them, or
+ * 0, the default, to keep the rule order, as timing pays off only on bays
+ * searched for far more nodes
+ * @param check_profile file to load the order from, or to record it in, or
+ * NULL; the name must stay valid while the parameters are used
+ */
+void ucrp_param_set_calibration(ucrp_param_t *param, long calibration_nodes,
+                                const char *check_profile);
+
+/**
+ * Set the log level and the progress callback
+ *
+ * @param param the parameters
+ * @param log_level UCRP_LOG_QUIET, UCRP_LOG_NORMAL or UCRP_LOG_PROGRESS
+ * @param progress progress callback, or NULL
+ * @param data user data passed to the callback
+ * @param heartbeat_nodes nodes between heartbeats
+ */
+void ucrp_param_set_progress(ucrp_param_t *param, int log_level,
+                             ucrp_progress_fn progress, void *data,
+                             long heartbeat_nodes);
+
+/**
+ * Set the incumbent to start from instead of JZW and SM-2
+ *
+ * @param param the parameters
+ * @param moves the moves, which must stay valid while the parameters are
+ * used, or NULL
+ * @param len number of moves
+ */
+void ucrp_param_set_initial_solution(ucrp_param_t *param,
+                                     const ucrp_move_t *moves, int len);
+
+/*
+ * Solving
+ */
+
+/**
+ * Solve an instance by iterative deepening branch-and-bound
+ *
+ * @param inst the instance
+ * @param param parameters, or NULL for the defaults
+ * @return solution report, or NULL if there is no solution or out of memory
+ */
+ucrp_report_t *ucrp_solve(ucrp_instance_t *inst, ucrp_param_t *param);
+
+/**
+ * Create a solver for repeated solves of instances of one size, which keeps
+ * its temporary variables between solves
+ *
+ * @param n_stacks number of stacks
+ * @param n_tiers number of tiers
+ * @return created solver, or NULL if out of memory
+ */
+ucrp_solver_t *ucrp_new_solver(int n_stacks, int n_tiers);
+
+/**
+ * Solve an instance with a solver of the same size
+ *
+ * @param solver the solver
+ * @param inst the instance
+ * @param param parameters, or NULL for the defaults
+ * @return solution report, or NULL if there is no solution or out of memory
+ */
+ucrp_report_t *ucrp_run_solver(ucrp_solver_t *solver, ucrp_instance_t *inst,
+                               ucrp_param_t *param);
+
+/**
+ * Free the space of a solver
+ *
+ * @param solver the solver
+ */
+void ucrp_free_solver(ucrp_solver_t *solver);
+
+/**
+ * Solve an instance by a single heuristic, without search
+ *
+ * @param inst the instance
+ * @param heuristic UCRP_JZW or UCRP_SM2
+ * @return report whose upper bound is the heuristic solution and whose lower
+ * bound is LB-TS, or NULL if the heuristic fails
+ */
+ucrp_report_t *ucrp_solve_heuristic(ucrp_instance_t *inst, int heuristic);
+
+/**
+ * Compute the lower bound LB-TS of an instance
+ *
+ * @param inst the instance
+ * @return lower bound on the number of relocations
+ */
+int ucrp_lower_bound(ucrp_instance_t *inst);
+
+/*
+ * Reports and progress events
+ */
+
+/**
+ * Get the best lower bound of a report
+ *
+ * @param report the report
+ * @return best lower bound
+ */
+int ucrp_report_lb(const ucrp_report_t *report);
+
+/**
+ * Get the best upper bound of a report, which is the number of its moves
+ *
+ * @param report the report
+ * @return best upper bound
+ */
+int ucrp_report_ub(const ucrp_report_t *report);
+
+/**
+ * Get the best solution of a report
+ *
+ * @param report the report
+ * @return ucrp_report_ub(report) moves, valid until the report is freed
+ */
+const ucrp_move_t *ucrp_report_moves(const ucrp_report_t *report);
+
+/**
+ * Get the time used by the solve of a report
+ *
+ * @param report the report
+ * @return wall-clock time used in seconds
+ */
+double ucrp_report_time(const ucrp_report_t *report);
+
+/**
+ * Get the number of nodes explored by the solve of a report
+ *
+ * @param report the report
+ * @return number of nodes
+ */
+long ucrp_report_nodes(const ucrp_report_t *report);
+
+/**
+ * Free the space of a report
+ *
+ * @param report the report
+ */
+void ucrp_free_report(ucrp_report_t *report);
+
+/**
+ * Get the type of a progress event
+ *
+ * @param progress the progress
+ * @return UCRP_PROGRESS_START, UCRP_PROGRESS_UPDATE, ...
+ */
+int ucrp_progress_type(const ucrp_progress_t *progress);
+
+/**
+ * Get the best lower bound at a progress event
+ *
+ * @param progress the progress
+ * @return best lower bound
+ */
+int ucrp_progress_lb(const ucrp_progress_t *progress);
+
+/**
+ * Get the best upper bound at a progress event
+ *
+ * @param progress the progress
+ * @return best upper bound
+ */
+int ucrp_progress_ub(const ucrp_progress_t *progress);
+
+/**
+ * Get the best solution at a progress event
+ *
+ * @param progress the progress
+ * @return ucrp_progress_ub(progress) moves, only valid during the callback
+ */
+const ucrp_move_t *ucrp_progress_moves(const ucrp_progress_t *progress);
+
+/**
+ * Get the time elapsed at a progress event
+ *
+ * @param progress the progress
+ * @return time elapsed in seconds
+ */
+double ucrp_progress_time(const ucrp_progress_t *progress);
+
+/**
+ * Get the number of nodes explored at a progress event
+ *
+ * @param progress the progress
+ * @return number of nodes
+ */
+long ucrp_progress_nodes(const ucrp_progress_t *progress);
+
+/*
+ * Verification
+ */
+
+/**
+ * Check that moves solve an instance, e.g. the moves of a report
+ *
+ * @param inst the instance
+ * @param moves array of moves
+ * @param len number of moves
+ * @param trace stream for the bay after each move, or NULL
+ * @return UCRP_VERIFY_VALID, UCRP_VERIFY_ILLEGAL if a move is not legal, or
+ * UCRP_VERIFY_UNFINISHED if blocks are left after the moves
+ */
+int ucrp_verify(ucrp_instance_t *inst, const ucrp_move_t *moves, int len,
+                FILE *trace);
+
+/**
+ * Check one solution per instance, and print one line per instance: its
+ * position in the input, the status, the number of legal relocations and the
+ * number of retrievals
+ *
+ * @param instances stream of instances in the input format
+ * @param solutions stream of move lists in the format of main-solve, one per
+ * instance in the same order
+ * @param out stream for the results
+ * @param trace stream for the bay after each move, or NULL
+ * @return number of invalid solutions, or -1 if the counts differ
+ */
+long ucrp_verify_batch(FILE *instances, FILE *solutions, FILE *out,
+                       FILE *trace);
+
+#endif
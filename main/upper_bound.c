@@ -16,76 +16,209 @@
  */
 
 #include "upper_bound.h"
+#include "lower_bound.h"
+#include "timer.h"
 #include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
 
-int jzw(state_t *state, move_t *path, int len, int max_len) {
-  if (len + state->n_bad > max_len) {
-    return INT_MAX;
-  }
+/*
+ * Random tie-breaking
+ */
 
+static unsigned next_random(unsigned *seed) {
+  unsigned x = *seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *seed = x;
+}
+
+static bool break_tie(unsigned *seed, int *n_ties) {
+  return seed != NULL && next_random(seed) % (unsigned)++*n_ties == 0;
+}
+
+/*
+ * Common analysis of JZW and SM-2
+ */
+
+typedef struct {
+  int q_min;            // smallest quality
+  int i_next;           // rank of the next stack to be handled
+  int i_max;            // rank of the non-full stack with the largest quality
+  int q_max;            // quality of the stack at rank i_max
+  bool has_multi_q_max; // true if another non-full stack has quality q_max
+} step_t;
+
+static bool prepare_step(state_t *state, int len, step_t *step) {
   int n_stacks = state->n_stacks;
   int n_tiers = state->n_tiers;
   int *h = state->h;
   int *list = state->list;
-  int *rank = state->rank;
-  int **p = state->p;
   int **q = state->q;
   int **b = state->b;
 
-  while (state->n_bad > 0) {
-    while (is_retrievable(state)) {
-      retrieve(state, len);
+  while (is_retrievable(state)) {
+    retrieve(state, len);
+  }
+
+  int q_min = q[list[0]][h[list[0]]];
+  int i_next = -1;
+  for (int i = 0; i < n_stacks; i++) {
+    int s = list[i];
+    if (q[s][h[s]] > q_min) {
+      break;
     }
+    int n_empty_slots = (n_stacks - 1) * n_tiers - (state->n_blocks - h[s]);
+    if (b[s][h[s]] <= n_empty_slots) {
+      i_next = i;
+      break;
+    }
+  }
+  if (i_next == -1) {
+    return false;
+  }
 
-    int q_min = q[list[0]][h[list[0]]];
-    int i_next = -1;
-    for (int i = 0; i < n_stacks; i++) {
+  int i_max;
+  int q_max;
+  for (int i = n_stacks - 1;; i--) {
+    int s = list[i];
+    if (i != i_next && h[s] < n_tiers) {
+      i_max = i;
+      q_max = q[s][h[s]];
+      break;
+    }
+  }
+
+  bool has_multi_q_max = false;
+  if (q_min < q_max) {
+    for (int i = i_max - 1;; i--) {
       int s = list[i];
-      if (q[s][h[s]] > q_min) {
+      if (q[s][h[s]] < q_max) {
         break;
       }
-      int n_empty_slots = (n_stacks - 1) * n_tiers - (state->n_blocks - h[s]);
-      if (b[s][h[s]] <= n_empty_slots) {
-        i_next = i;
+      if (h[s] < n_tiers) {
+        has_multi_q_max = true;
         break;
       }
     }
-    if (i_next == -1) {
-      return INT_MAX;
-    }
+  }
+
+  step->q_min = q_min;
+  step->i_next = i_next;
+  step->i_max = i_max;
+  step->q_max = q_max;
+  step->has_multi_q_max = has_multi_q_max;
+  return true;
+}
+
+/*
+ * JZW
+ */
 
-    int i_max;
-    int q_max;
-    for (int i = n_stacks - 1;; i--) {
+static bool jzw_step(state_t *state, step_t *step, int len, int max_len,
+                     unsigned *seed, move_t *move) {
+  int n_stacks = state->n_stacks;
+  int n_tiers = state->n_tiers;
+  int *h = state->h;
+  int *list = state->list;
+  int *rank = state->rank;
+  int **p = state->p;
+  int **q = state->q;
+  int **b = state->b;
+  int q_min = step->q_min;
+  int i_next = step->i_next;
+  int i_max = step->i_max;
+  int q_max = step->q_max;
+  bool has_multi_q_max = step->has_multi_q_max;
+
+  int src = list[i_next];
+  int dst;
+
+  if (p[src][h[src]] <= q_max) {
+    for (int i = i_next + 1;; i++) {
       int s = list[i];
-      if (i != i_next && h[s] < n_tiers) {
-        i_max = i;
-        q_max = q[s][h[s]];
+      if (h[s] < n_tiers && p[src][h[src]] <= q[s][h[s]]) {
+        dst = s;
         break;
       }
     }
-
-    bool has_multi_q_max = false;
-    if (q_min < q_max) {
-      for (int i = i_max - 1;; i--) {
+    if (seed != NULL) {
+      int n_ties = 1;
+      for (int i = rank[dst] + 1;
+           i < n_stacks && q[list[i]][h[list[i]]] == q[dst][h[dst]]; i++) {
         int s = list[i];
-        if (q[s][h[s]] < q_max) {
-          break;
+        if (h[s] < n_tiers && break_tie(seed, &n_ties)) {
+          dst = s;
         }
-        if (h[s] < n_tiers) {
-          has_multi_q_max = true;
-          break;
+      }
+    }
+
+    if (h[dst] < n_tiers - 1) {
+      int s_pre = -1;
+      int n_ties = 0;
+      for (int i = 0; i < rank[dst]; i++) {
+        int s = list[i];
+        if (s != src && b[s][h[s]] > 0 && p[src][h[src]] <= p[s][h[s]] &&
+            p[s][h[s]] <= q[dst][h[dst]]) {
+          if (s_pre == -1 || p[s_pre][h[s_pre]] < p[s][h[s]]) {
+            s_pre = s;
+            n_ties = 1;
+          } else if (p[s_pre][h[s_pre]] == p[s][h[s]] &&
+                     break_tie(seed, &n_ties)) {
+            s_pre = s;
+          }
         }
       }
+      if (s_pre != -1) {
+        src = s_pre;
+      }
+    }
+  } else {
+    if (len + state->n_bad == max_len) {
+      return false;
     }
 
-    int src = list[i_next];
-    int dst;
+    int i_opt = -1;
+    int dir_opt = 1;
+    for (int dir = 1, i = i_max;; i += dir) {
+      if (i == n_stacks || (i > i_max && q[list[i]][h[list[i]]] > q_max)) {
+        i = i_max + (dir = -1);
+      }
+      int s = list[i];
+      if (q[s][h[s]] == q_min) {
+        break;
+      }
+      if (b[s][h[s]] == 0 && p[src][h[src]] <= q[s][h[s] - 1] &&
+          (i != i_max || has_multi_q_max)) {
+        i_opt = i;
+        dir_opt = dir;
+        break;
+      }
+    }
+    if (seed != NULL && i_opt != -1) {
+      int n_ties = 1;
+      int q_opt = q[list[i_opt]][h[list[i_opt]]];
+      for (int i = i_opt + dir_opt;
+           i >= 0 && i < n_stacks && q[list[i]][h[list[i]]] == q_opt;
+           i += dir_opt) {
+        int s = list[i];
+        if (b[s][h[s]] == 0 && p[src][h[src]] <= q[s][h[s] - 1] &&
+            (i != i_max || has_multi_q_max) && break_tie(seed, &n_ties)) {
+          i_opt = i;
+        }
+      }
+    }
 
-    if (p[src][h[src]] <= q_max) {
-      for (int i = i_next + 1;; i++) {
+    if (i_opt != -1) {
+      src = list[i_opt];
+      for (int dir = -1, i = i_opt + dir;; i += dir) {
+        if (i < i_opt && q[list[i]][h[list[i]]] < p[src][h[src]]) {
+          i = i_opt + (dir = 1);
+        }
         int s = list[i];
-        if (h[s] < n_tiers && p[src][h[src]] <= q[s][h[s]]) {
+        if (h[s] < n_tiers) {
           dst = s;
           break;
         }
@@ -93,12 +226,18 @@ int jzw(state_t *state, move_t *path, int len, int max_len) {
 
       if (h[dst] < n_tiers - 1) {
         int s_pre = -1;
+        int n_ties = 0;
         for (int i = 0; i < rank[dst]; i++) {
           int s = list[i];
           if (s != src && b[s][h[s]] > 0 && p[src][h[src]] <= p[s][h[s]] &&
-              p[s][h[s]] <= q[dst][h[dst]] &&
-              (s_pre == -1 || p[s_pre][h[s_pre]] < p[s][h[s]])) {
-            s_pre = s;
+              p[s][h[s]] <= q[dst][h[dst]]) {
+            if (s_pre == -1 || p[s_pre][h[s_pre]] < p[s][h[s]]) {
+              s_pre = s;
+              n_ties = 1;
+            } else if (p[s_pre][h[s_pre]] == p[s][h[s]] &&
+                       break_tie(seed, &n_ties)) {
+              s_pre = s;
+            }
           }
         }
         if (s_pre != -1) {
@@ -106,92 +245,66 @@ int jzw(state_t *state, move_t *path, int len, int max_len) {
         }
       }
     } else {
-      if (len + state->n_bad == max_len) {
-        return INT_MAX;
-      }
-
-      int i_opt = -1;
-      for (int dir = 1, i = i_max;; i += dir) {
-        if (i == n_stacks || (i > i_max && q[list[i]][h[list[i]]] > q_max)) {
-          i = i_max + (dir = -1);
-        }
-        int s = list[i];
-        if (q[s][h[s]] == q_min) {
-          break;
-        }
-        if (b[s][h[s]] == 0 && p[src][h[src]] <= q[s][h[s] - 1] &&
-            (i != i_max || has_multi_q_max)) {
-          i_opt = i;
-          break;
-        }
-      }
-
-      if (i_opt != -1) {
-        src = list[i_opt];
-        for (int dir = -1, i = i_opt + dir;; i += dir) {
-          if (i < i_opt && q[list[i]][h[list[i]]] < p[src][h[src]]) {
-            i = i_opt + (dir = 1);
-          }
-          int s = list[i];
-          if (h[s] < n_tiers) {
-            dst = s;
+      dst = list[i_max];
+      if (h[dst] == n_tiers - 1) {
+        bool smallest = true;
+        for (int k = 1; k < b[src][h[src]]; k++) {
+          if (p[src][h[src] - k] < p[src][h[src]]) {
+            smallest = false;
             break;
           }
         }
-
-        if (h[dst] < n_tiers - 1) {
-          int s_pre = -1;
-          for (int i = 0; i < rank[dst]; i++) {
+        if (!smallest) {
+          for (int i = i_max - 1; i >= 0; i--) {
             int s = list[i];
-            if (s != src && b[s][h[s]] > 0 && p[src][h[src]] <= p[s][h[s]] &&
-                p[s][h[s]] <= q[dst][h[dst]] &&
-                (s_pre == -1 || p[s_pre][h[s_pre]] < p[s][h[s]])) {
-              s_pre = s;
-            }
-          }
-          if (s_pre != -1) {
-            src = s_pre;
-          }
-        }
-      } else {
-        dst = list[i_max];
-        if (h[dst] == n_tiers - 1) {
-          bool smallest = true;
-          for (int k = 1; k < b[src][h[src]]; k++) {
-            if (p[src][h[src] - k] < p[src][h[src]]) {
-              smallest = false;
+            if (s != src && h[s] < n_tiers) {
+              dst = s;
               break;
             }
           }
-          if (!smallest) {
-            for (int i = i_max - 1; i >= 0; i--) {
-              int s = list[i];
-              if (s != src && h[s] < n_tiers) {
-                dst = s;
-                break;
-              }
-            }
-          }
         }
       }
     }
+  }
 
+  move->p = p[src][h[src]];
+  move->s = src;
+  move->d = dst;
+  return true;
+}
+
+int jzw(state_t *state, move_t *path, int len, int max_len) {
+  return jzw_random(state, path, len, max_len, NULL);
+}
+
+int jzw_random(state_t *state, move_t *path, int len, int max_len,
+               unsigned *seed) {
+  if (len + state->n_bad > max_len) {
+    return INT_MAX;
+  }
+
+  step_t step;
+  move_t move;
+  while (state->n_bad > 0) {
+    if (!prepare_step(state, len, &step) ||
+        !jzw_step(state, &step, len, max_len, seed, &move)) {
+      return INT_MAX;
+    }
     if (path != NULL) {
-      path[len].p = p[src][h[src]];
-      path[len].s = src;
-      path[len].d = dst;
+      path[len] = move;
     }
-    relocate(state, src, dst, ++len);
+    relocate(state, move.s, move.d, ++len);
   }
 
   return len;
 }
 
-int sm2(state_t *state, move_t *path, int len, int max_len) {
-  if (len + state->n_bad > max_len) {
-    return INT_MAX;
-  }
+/*
+ * SM-2
+ */
 
+static bool sm2_step(state_t *state, step_t *step, int len, int max_len,
+                     unsigned *seed, move_t *move) {
   int n_stacks = state->n_stacks;
   int n_tiers = state->n_tiers;
   int *h = state->h;
@@ -200,166 +313,130 @@ int sm2(state_t *state, move_t *path, int len, int max_len) {
   int **p = state->p;
   int **q = state->q;
   int **b = state->b;
+  int q_min = step->q_min;
+  int i_next = step->i_next;
+  int i_max = step->i_max;
+  int q_max = step->q_max;
+  bool has_multi_q_max = step->has_multi_q_max;
 
-  while (state->n_bad > 0) {
-    while (is_retrievable(state)) {
-      retrieve(state, len);
-    }
+  int src = -1;
+  int dst = -1;
+  int best_diff = INT_MAX;
+  int n_ties = 0;
 
-    int q_min = q[list[0]][h[list[0]]];
-    int i_next = -1;
-    for (int i = 0; i < n_stacks; i++) {
-      int s = list[i];
-      if (q[s][h[s]] > q_min) {
-        break;
-      }
-      int n_empty_slots = (n_stacks - 1) * n_tiers - (state->n_blocks - h[s]);
-      if (b[s][h[s]] <= n_empty_slots) {
-        i_next = i;
-        break;
-      }
-    }
-    if (i_next == -1) {
-      return INT_MAX;
-    }
-
-    int i_max;
-    int q_max;
-    for (int i = n_stacks - 1;; i--) {
-      int s = list[i];
-      if (i != i_next && h[s] < n_tiers) {
-        i_max = i;
-        q_max = q[s][h[s]];
+  if (q_min < q_max) {
+    for (int i = 0; i < i_max; i++) {
+      int from = list[i];
+      if (h[from] == 0) {
         break;
       }
-    }
-
-    bool has_multi_q_max = false;
-    if (q_min < q_max) {
-      for (int i = i_max - 1;; i--) {
-        int s = list[i];
-        if (q[s][h[s]] < q_max) {
-          break;
-        }
-        if (h[s] < n_tiers) {
-          has_multi_q_max = true;
-          break;
+      if (b[from][h[from]] > 0 && p[from][h[from]] <= q_max) {
+        for (int j = i + 1;; j++) {
+          int to = list[j];
+          int diff = q[to][h[to]] - p[from][h[from]];
+          if (diff > best_diff || (diff == best_diff && seed == NULL)) {
+            break;
+          }
+          if (h[to] < n_tiers && diff >= 0) {
+            if (diff < best_diff) {
+              src = from;
+              dst = to;
+              best_diff = diff;
+              n_ties = 1;
+            } else if (break_tie(seed, &n_ties)) {
+              src = from;
+              dst = to;
+            }
+            break;
+          }
         }
       }
     }
+  }
 
-    int src = -1;
-    int dst = -1;
-    int best_diff = INT_MAX;
+  if (best_diff == INT_MAX) {
+    if (len + state->n_bad == max_len) {
+      return false;
+    }
 
     if (q_min < q_max) {
-      for (int i = 0; i < i_max; i++) {
+      for (int i = 0; i < n_stacks; i++) {
         int from = list[i];
-        if (h[from] == 0) {
+        if (q[from][h[from]] > q_max) {
           break;
         }
-        if (b[from][h[from]] > 0 && p[from][h[from]] <= q_max) {
-          for (int j = i + 1;; j++) {
-            int to = list[j];
-            int diff = q[to][h[to]] - p[from][h[from]];
-            if (diff >= best_diff) {
+        if (b[from][h[from]] == 0 && (i != i_max || has_multi_q_max)) {
+          int s_bad = -1;
+          int s_bad_alt = -1;
+          for (int j = 0; j < n_stacks; j++) {
+            int s = list[j];
+            if (q[s][h[s]] >= q[from][h[from] - 1]) {
               break;
             }
-            if (h[to] < n_tiers && diff >= 0) {
-              src = from;
-              dst = to;
-              best_diff = diff;
-              break;
+            int diff = q[from][h[from] - 1] - p[s][h[s]];
+            if (b[s][h[s]] > 0 && diff >= 0 && diff < best_diff) {
+              if (s_bad == -1 || p[s_bad][h[s_bad]] < p[s][h[s]]) {
+                s_bad_alt = s_bad;
+                s_bad = s;
+              } else if (s_bad_alt == -1 ||
+                         p[s_bad_alt][h[s_bad_alt]] < p[s][h[s]]) {
+                s_bad_alt = s;
+              }
             }
           }
-        }
-      }
-    }
-
-    if (best_diff == INT_MAX) {
-      if (len + state->n_bad == max_len) {
-        return INT_MAX;
-      }
 
-      if (q_min < q_max) {
-        for (int i = 0; i < n_stacks; i++) {
-          int from = list[i];
-          if (q[from][h[from]] > q_max) {
-            break;
-          }
-          if (b[from][h[from]] == 0 && (i != i_max || has_multi_q_max)) {
-            int s_bad = -1;
-            int s_bad_alt = -1;
-            for (int j = 0; j < n_stacks; j++) {
+          if (s_bad != -1) {
+            int to = -1;
+            for (int dir = -1, j = i + dir;; j += dir) {
+              if (dir == -1 && q[list[j]][h[list[j]]] < p[from][h[from]]) {
+                j = i + (dir = 1);
+              }
               int s = list[j];
-              if (q[s][h[s]] >= q[from][h[from] - 1]) {
+              int diff = q[from][h[from] - 1] - p[s_bad][h[s_bad]] +
+                         q[s][h[s]] - p[from][h[from]];
+              if (diff >= best_diff) {
                 break;
               }
-              int diff = q[from][h[from] - 1] - p[s][h[s]];
-              if (b[s][h[s]] > 0 && diff >= 0 && diff < best_diff) {
-                if (s_bad == -1 || p[s_bad][h[s_bad]] < p[s][h[s]]) {
-                  s_bad_alt = s_bad;
-                  s_bad = s;
-                } else if (s_bad_alt == -1 ||
-                           p[s_bad_alt][h[s_bad_alt]] < p[s][h[s]]) {
-                  s_bad_alt = s;
-                }
+              if (h[s] < n_tiers) {
+                to = s;
+                break;
               }
             }
 
-            if (s_bad != -1) {
-              int to = -1;
-              for (int dir = -1, j = i + dir;; j += dir) {
-                if (dir == -1 && q[list[j]][h[list[j]]] < p[from][h[from]]) {
-                  j = i + (dir = 1);
-                }
-                int s = list[j];
-                int diff = q[from][h[from] - 1] - p[s_bad][h[s_bad]] +
-                           q[s][h[s]] - p[from][h[from]];
-                if (diff >= best_diff) {
-                  break;
-                }
-                if (h[s] < n_tiers) {
-                  to = s;
-                  break;
+            if (to != -1) {
+              if (s_bad != to) {
+                src = from;
+                dst = to;
+                best_diff = q[from][h[from] - 1] - p[s_bad][h[s_bad]] +
+                            q[to][h[to]] - p[from][h[from]];
+              } else {
+                if (s_bad_alt != -1) {
+                  int diff = q[from][h[from] - 1] -
+                             p[s_bad_alt][h[s_bad_alt]] + q[to][h[to]] -
+                             p[from][h[from]];
+                  if (diff < best_diff) {
+                    src = from;
+                    dst = to;
+                    best_diff = diff;
+                  }
                 }
-              }
-
-              if (to != -1) {
-                if (s_bad != to) {
-                  src = from;
-                  dst = to;
-                  best_diff = q[from][h[from] - 1] - p[s_bad][h[s_bad]] +
-                              q[to][h[to]] - p[from][h[from]];
-                } else {
-                  if (s_bad_alt != -1) {
-                    int diff = q[from][h[from] - 1] -
-                               p[s_bad_alt][h[s_bad_alt]] + q[to][h[to]] -
-                               p[from][h[from]];
-                    if (diff < best_diff) {
-                      src = from;
-                      dst = to;
-                      best_diff = diff;
-                    }
+                for (int dir = (rank[to] < i ? -1 : 1), j = rank[to] + dir;
+                     j <= i_max; j += dir) {
+                  if (dir == -1 &&
+                      q[list[j]][h[list[j]]] < p[from][h[from]]) {
+                    j = i + (dir = 1);
+                  }
+                  int s = list[j];
+                  int diff = q[from][h[from] - 1] - p[s_bad][h[s_bad]] +
+                             q[s][h[s]] - p[from][h[from]];
+                  if (diff >= best_diff) {
+                    break;
                   }
-                  for (int dir = (rank[to] < i ? -1 : 1), j = rank[to] + dir;
-                       j <= i_max; j += dir) {
-                    if (dir == -1 &&
-                        q[list[j]][h[list[j]]] < p[from][h[from]]) {
-                      j = i + (dir = 1);
-                    }
-                    int s = list[j];
-                    int diff = q[from][h[from] - 1] - p[s_bad][h[s_bad]] +
-                               q[s][h[s]] - p[from][h[from]];
-                    if (diff >= best_diff) {
-                      break;
-                    }
-                    if (h[s] < n_tiers) {
-                      src = from;
-                      dst = s;
-                      best_diff = diff;
-                      break;
-                    }
+                  if (h[s] < n_tiers) {
+                    src = from;
+                    dst = s;
+                    best_diff = diff;
+                    break;
                   }
                 }
               }
@@ -367,20 +444,546 @@ int sm2(state_t *state, move_t *path, int len, int max_len) {
           }
         }
       }
+    }
+
+    if (src == -1) {
+      src = list[i_next];
+      dst = list[i_max];
+    }
+  }
+
+  move->p = p[src][h[src]];
+  move->s = src;
+  move->d = dst;
+  return true;
+}
 
-      if (src == -1) {
-        src = list[i_next];
-        dst = list[i_max];
+int sm2(state_t *state, move_t *path, int len, int max_len) {
+  return sm2_random(state, path, len, max_len, NULL);
+}
+
+int sm2_random(state_t *state, move_t *path, int len, int max_len,
+               unsigned *seed) {
+  if (len + state->n_bad > max_len) {
+    return INT_MAX;
+  }
+
+  step_t step;
+  move_t move;
+  while (state->n_bad > 0) {
+    if (!prepare_step(state, len, &step) ||
+        !sm2_step(state, &step, len, max_len, seed, &move)) {
+      return INT_MAX;
+    }
+    if (path != NULL) {
+      path[len] = move;
+    }
+    relocate(state, move.s, move.d, ++len);
+  }
+
+  return len;
+}
+
+/*
+ * Fused JZW and SM-2
+ */
+
+static int finish(state_t *state, move_t *path, int len, int max_len,
+                  move_t *move, bool by_jzw) {
+  if (path != NULL) {
+    path[len] = *move;
+  }
+  relocate(state, move->s, move->d, ++len);
+  return by_jzw ? jzw_random(state, path, len, max_len, NULL)
+                : sm2_random(state, path, len, max_len, NULL);
+}
+
+int jzw_sm2(state_t *state, state_t *temp_state, move_t *path,
+            move_t *temp_path, int len, int max_len, int *len_jzw,
+            int *len_sm2) {
+  *len_jzw = INT_MAX;
+  *len_sm2 = INT_MAX;
+  if (len + state->n_bad > max_len) {
+    return INT_MAX;
+  }
+
+  step_t step;
+  move_t move_jzw;
+  move_t move_sm2;
+  while (state->n_bad > 0) {
+    if (!prepare_step(state, len, &step)) {
+      return INT_MAX;
+    }
+    bool ok_jzw = jzw_step(state, &step, len, max_len, NULL, &move_jzw);
+    bool ok_sm2 = sm2_step(state, &step, len, max_len, NULL, &move_sm2);
+
+    if (!ok_jzw && !ok_sm2) {
+      return INT_MAX;
+    } else if (!ok_sm2) {
+      return *len_jzw = finish(state, path, len, max_len, &move_jzw, true);
+    } else if (!ok_jzw) {
+      return *len_sm2 = finish(state, path, len, max_len, &move_sm2, false);
+    } else if (move_jzw.s != move_sm2.s || move_jzw.d != move_sm2.d) {
+      /*
+       * Diverge: SM-2 only has to beat JZW from now on
+       */
+      copy_state(temp_state, state);
+      if (path != NULL) {
+        memcpy(temp_path, path, sizeof(move_t) * len);
+      }
+      *len_jzw = finish(state, path, len, max_len, &move_jzw, true);
+      int cap = *len_jzw == INT_MAX ? max_len : *len_jzw - 1;
+      if (len + temp_state->n_bad <= cap) {
+        *len_sm2 = finish(temp_state, path == NULL ? NULL : temp_path, len,
+                          cap, &move_sm2, false);
+      }
+      if (*len_sm2 == INT_MAX) {
+        return *len_jzw;
       }
+      if (path != NULL) {
+        memcpy(path, temp_path, sizeof(move_t) * *len_sm2);
+      }
+      return *len_sm2;
     }
 
     if (path != NULL) {
-      path[len].p = p[src][h[src]];
-      path[len].s = src;
-      path[len].d = dst;
+      path[len] = move_jzw;
     }
-    relocate(state, src, dst, ++len);
+    relocate(state, move_jzw.s, move_jzw.d, ++len);
   }
 
+  *len_jzw = len;
+  *len_sm2 = len;
   return len;
 }
+
+/*
+ * Multi-start
+ */
+
+typedef struct {
+  int id;                 // index of this worker
+  int n_workers;          // number of workers
+  int n_restarts;         // number of restarts
+  double end_time;        // wall-clock deadline
+  unsigned seed;          // random seed
+  state_t *state;         // initial state, shared by all workers
+  state_t *probe_state;   // for restarting
+  move_t *temp_path;      // for restarting
+  pthread_mutex_t *mutex; // for updating the best solution
+  int *best_len;          // length of the best solution
+  move_t *best_path;      // best solution
+} restart_worker_t;
+
+static unsigned mix_seed(unsigned seed, int r) {
+  unsigned x = seed ^ (unsigned)r * 0x9e3779b9u;
+  x = (x ^ (x >> 16)) * 0x85ebca6bu;
+  x = (x ^ (x >> 13)) * 0xc2b2ae35u;
+  x ^= x >> 16;
+  return x == 0 ? 1 : x;
+}
+
+static void *run_restarts(void *arg) {
+  restart_worker_t *worker = (restart_worker_t *)arg;
+  for (int r = worker->id; r < worker->n_restarts; r += worker->n_workers) {
+    if (get_wall_time() >= worker->end_time) {
+      break;
+    }
+
+    pthread_mutex_lock(worker->mutex);
+    int max_len = *worker->best_len - 1;
+    pthread_mutex_unlock(worker->mutex);
+
+    unsigned seed = mix_seed(worker->seed, r);
+    copy_state(worker->probe_state, worker->state);
+    int len = r % 2 == 0 ? jzw_random(worker->probe_state, worker->temp_path,
+                                      0, max_len, &seed)
+                         : sm2_random(worker->probe_state, worker->temp_path,
+                                      0, max_len, &seed);
+
+    if (len != INT_MAX) {
+      pthread_mutex_lock(worker->mutex);
+      if (*worker->best_len > len) {
+        *worker->best_len = len;
+        memcpy(worker->best_path, worker->temp_path, sizeof(move_t) * len);
+      }
+      pthread_mutex_unlock(worker->mutex);
+    }
+  }
+  return NULL;
+}
+
+int multi_start(state_t *state, move_t *path, int max_len, int n_restarts,
+                double end_time, int n_threads, unsigned seed) {
+  if (state->n_bad == 0 || state->n_bad > max_len || n_restarts <= 0 ||
+      get_wall_time() >= end_time) {
+    return INT_MAX;
+  }
+
+  int n_stacks = state->n_stacks;
+  int n_tiers = state->n_tiers;
+  int n_workers = n_threads < 1            ? 1
+                  : n_threads > n_restarts ? n_restarts
+                                           : n_threads;
+
+  pthread_mutex_t mutex;
+  pthread_mutex_init(&mutex, NULL);
+  int best_len = max_len + 1;
+  move_t *best_path = malloc(sizeof(move_t) * max_len);
+
+  restart_worker_t *workers = malloc(sizeof(restart_worker_t) * n_workers);
+  pthread_t *threads = malloc(sizeof(pthread_t) * n_workers);
+  bool *started = malloc(sizeof(bool) * n_workers);
+  for (int t = 0; t < n_workers; t++) {
+    workers[t].id = t;
+    workers[t].n_workers = n_workers;
+    workers[t].n_restarts = n_restarts;
+    workers[t].end_time = end_time;
+    workers[t].seed = seed;
+    workers[t].state = state;
+    workers[t].probe_state = malloc_state(n_stacks, n_tiers, true, true, false);
+    workers[t].temp_path = malloc(sizeof(move_t) * max_len);
+    workers[t].mutex = &mutex;
+    workers[t].best_len = &best_len;
+    workers[t].best_path = best_path;
+  }
+
+  for (int t = 1; t < n_workers; t++) {
+    started[t] =
+        pthread_create(&threads[t], NULL, run_restarts, &workers[t]) == 0;
+    if (!started[t]) {
+      run_restarts(&workers[t]);
+    }
+  }
+  run_restarts(&workers[0]);
+  for (int t = 1; t < n_workers; t++) {
+    if (started[t]) {
+      pthread_join(threads[t], NULL);
+    }
+  }
+
+  if (best_len <= max_len) {
+    memcpy(path, best_path, sizeof(move_t) * best_len);
+  }
+
+  for (int t = 0; t < n_workers; t++) {
+    free_state(workers[t].probe_state);
+    free(workers[t].temp_path);
+  }
+  free(started);
+  free(threads);
+  free(workers);
+  free(best_path);
+  pthread_mutex_destroy(&mutex);
+
+  return best_len <= max_len ? best_len : INT_MAX;
+}
+
+/*
+ * Beam search
+ */
+
+typedef struct {
+  int len;        // number of moves
+  move_t *path;   // moves from the root
+  state_t *state; // state after the moves and retrievals
+} beam_node_t;
+
+typedef struct {
+  int parent; // index of the parent node in the beam
+  int src;    // source stack
+  int dst;    // destination stack
+  int lb;     // lower bound of the total length
+  int ub;     // total length of the best completion or INT_MAX
+} candidate_t;
+
+typedef struct {
+  int id;               // index of this worker
+  int n_workers;        // number of workers
+  int size;             // number of nodes in the beam
+  int max_len;          // maximum allowed length
+  double end_time;      // wall-clock deadline
+  beam_node_t *beam;    // nodes to be expanded
+  candidate_t *cand;    // candidate slots, n_stacks * (n_stacks - 1) per node
+  int *n_cand;          // n_cand[i]: number of candidates of node i
+  state_t *child_state; // for expansion
+  state_t *probe_state; // for completion
+  int *array_s1;        // for lower bounding
+} beam_worker_t;
+
+static int compare_candidate(const void *a, const void *b) {
+  candidate_t *x = (candidate_t *)a;
+  candidate_t *y = (candidate_t *)b;
+  return x->ub != y->ub         ? (x->ub < y->ub ? -1 : 1)
+         : x->lb != y->lb       ? x->lb - y->lb
+         : x->parent != y->parent ? x->parent - y->parent
+         : x->src != y->src     ? x->src - y->src
+                                : x->dst - y->dst;
+}
+
+static void make_child(state_t *child_state, beam_node_t *node, int src,
+                       int dst) {
+  copy_state(child_state, node->state);
+  relocate(child_state, src, dst, node->len + 1);
+  while (is_retrievable(child_state)) {
+    retrieve(child_state, node->len + 1);
+  }
+}
+
+static void expand_node(beam_worker_t *worker, int i) {
+  int n_stacks = worker->beam[i].state->n_stacks;
+  int n_tiers = worker->beam[i].state->n_tiers;
+  int max_len = worker->max_len;
+  beam_node_t *node = &worker->beam[i];
+  state_t *child_state = worker->child_state;
+  state_t *probe_state = worker->probe_state;
+  candidate_t *cand = worker->cand + i * n_stacks * (n_stacks - 1);
+  int size = 0;
+
+  uint64_t *not_full = node->state->not_full;
+  for (int s = 0; s < n_stacks; s++) {
+    if (node->state->h[s] == 0 ||
+        node->state->n_blocks - node->state->h[s] == (n_stacks - 1) * n_tiers) {
+      continue;
+    }
+    for (int d = next_stack(not_full, 0, n_stacks); d < n_stacks;
+         d = next_stack(not_full, d + 1, n_stacks)) {
+      if (d == s) {
+        continue;
+      }
+
+      make_child(child_state, node, s, d);
+      int len = node->len + 1;
+      if (len + child_state->n_bad > max_len) {
+        continue;
+      }
+      int lb = len + lb_ts(child_state, max_len - len - child_state->n_bad,
+                           worker->array_s1);
+      if (lb > max_len) {
+        continue;
+      }
+
+      copy_state(probe_state, child_state);
+      int ub = jzw(probe_state, NULL, len, max_len);
+      copy_state(probe_state, child_state);
+      int ub_sm2 =
+          sm2(probe_state, NULL, len, ub == INT_MAX ? max_len : ub - 1);
+      if (ub_sm2 != INT_MAX) {
+        ub = ub_sm2;
+      }
+
+      cand[size].parent = i;
+      cand[size].src = s;
+      cand[size].dst = d;
+      cand[size].lb = lb;
+      cand[size].ub = ub;
+      size++;
+    }
+  }
+
+  worker->n_cand[i] = size;
+}
+
+static void *expand_beam(void *arg) {
+  beam_worker_t *worker = (beam_worker_t *)arg;
+  for (int i = worker->id; i < worker->size; i += worker->n_workers) {
+    if (get_wall_time() >= worker->end_time) {
+      worker->n_cand[i] = 0;
+      continue;
+    }
+    expand_node(worker, i);
+  }
+  return NULL;
+}
+
+int beam(state_t *state, move_t *path, int max_len, int width,
+         double end_time, int n_threads) {
+  if (state->n_bad == 0 || state->n_bad > max_len || width <= 0 ||
+      get_wall_time() >= end_time) {
+    return INT_MAX;
+  }
+
+  int n_stacks = state->n_stacks;
+  int n_tiers = state->n_tiers;
+  int n_branches = n_stacks * (n_stacks - 1);
+  if (n_threads < 1) {
+    n_threads = 1;
+  }
+
+  /*
+   * Two beams, swapped after every level, whose nodes are allocated when
+   * first filled so that a wide beam stopped early costs little
+   */
+  int path_cap = max_len;
+  beam_node_t *curr = malloc(sizeof(beam_node_t) * 2 * width);
+  beam_node_t *next = curr + width;
+  for (int i = 0; i < 2 * width; i++) {
+    curr[i].path = NULL;
+    curr[i].state = NULL;
+  }
+  curr[0].path = malloc(sizeof(move_t) * path_cap);
+  curr[0].state = malloc_state(n_stacks, n_tiers, true, true, false);
+  candidate_t *cand = malloc(sizeof(candidate_t) * width * n_branches);
+  int *n_cand = malloc(sizeof(int) * width);
+
+  beam_worker_t *workers = malloc(sizeof(beam_worker_t) * n_threads);
+  pthread_t *threads = malloc(sizeof(pthread_t) * n_threads);
+  bool *started = malloc(sizeof(bool) * n_threads);
+  for (int t = 0; t < n_threads; t++) {
+    workers[t].id = t;
+    workers[t].cand = cand;
+    workers[t].n_cand = n_cand;
+    workers[t].child_state = malloc_state(n_stacks, n_tiers, true, true, false);
+    workers[t].probe_state = malloc_state(n_stacks, n_tiers, true, true, false);
+    workers[t].array_s1 = malloc(sizeof(int) * lb_ts_temp_size(n_stacks));
+  }
+
+  move_t *temp_path = malloc(sizeof(move_t) * max_len);
+  int best_len = INT_MAX;
+
+  curr[0].len = 0;
+  copy_state(curr[0].state, state);
+  int size = 1;
+
+  while (size > 0) {
+    /*
+     * Expand all nodes in parallel
+     */
+    int n_workers = size < n_threads ? size : n_threads;
+    for (int t = 0; t < n_workers; t++) {
+      workers[t].n_workers = n_workers;
+      workers[t].size = size;
+      workers[t].max_len = max_len;
+      workers[t].end_time = end_time;
+      workers[t].beam = curr;
+    }
+    for (int t = 1; t < n_workers; t++) {
+      started[t] =
+          pthread_create(&threads[t], NULL, expand_beam, &workers[t]) == 0;
+      if (!started[t]) {
+        expand_beam(&workers[t]);
+      }
+    }
+    expand_beam(&workers[0]);
+    for (int t = 1; t < n_workers; t++) {
+      if (started[t]) {
+        pthread_join(threads[t], NULL);
+      }
+    }
+
+    /*
+     * Gather candidates
+     */
+    int n_total = 0;
+    for (int i = 0; i < size; i++) {
+      memmove(cand + n_total, cand + i * n_branches,
+              sizeof(candidate_t) * n_cand[i]);
+      n_total += n_cand[i];
+    }
+    if (n_total == 0) {
+      break;
+    }
+
+    /*
+     * Rank them, or past the deadline only find the best one
+     */
+    bool stopped = get_wall_time() >= end_time;
+    if (stopped) {
+      for (int k = 1; k < n_total; k++) {
+        if (compare_candidate(&cand[k], &cand[0]) < 0) {
+          candidate_t temp = cand[0];
+          cand[0] = cand[k];
+          cand[k] = temp;
+        }
+      }
+    } else {
+      qsort(cand, n_total, sizeof(candidate_t), compare_candidate);
+    }
+
+    /*
+     * Record the best completion
+     */
+    if (cand[0].ub <= max_len) {
+      beam_node_t *node = &curr[cand[0].parent];
+      state_t *child_state = workers[0].child_state;
+      state_t *probe_state = workers[0].probe_state;
+      make_child(child_state, node, cand[0].src, cand[0].dst);
+      memcpy(temp_path, node->path, sizeof(move_t) * node->len);
+      temp_path[node->len].p =
+          node->state->p[cand[0].src][node->state->h[cand[0].src]];
+      temp_path[node->len].s = cand[0].src;
+      temp_path[node->len].d = cand[0].dst;
+      copy_state(probe_state, child_state);
+      if (jzw(probe_state, temp_path, node->len + 1, cand[0].ub) !=
+          cand[0].ub) {
+        copy_state(probe_state, child_state);
+        sm2(probe_state, temp_path, node->len + 1, cand[0].ub);
+      }
+      best_len = cand[0].ub;
+      memcpy(path, temp_path, sizeof(move_t) * best_len);
+      max_len = best_len - 1;
+    }
+
+    /*
+     * Stop at the deadline, the nodes left unexpanded having been skipped
+     */
+    if (stopped || get_wall_time() >= end_time) {
+      break;
+    }
+
+    /*
+     * Select the next beam
+     */
+    int next_size = 0;
+    for (int k = 0; k < n_total && next_size < width; k++) {
+      if (cand[k].lb > max_len) {
+        continue;
+      }
+      beam_node_t *node = &curr[cand[k].parent];
+      beam_node_t *child = &next[next_size++];
+      if (child->state == NULL) {
+        child->path = malloc(sizeof(move_t) * path_cap);
+        child->state = malloc_state(n_stacks, n_tiers, true, true, false);
+      }
+      make_child(child->state, node, cand[k].src, cand[k].dst);
+      child->len = node->len + 1;
+      memcpy(child->path, node->path, sizeof(move_t) * node->len);
+      child->path[node->len].p =
+          node->state->p[cand[k].src][node->state->h[cand[k].src]];
+      child->path[node->len].s = cand[k].src;
+      child->path[node->len].d = cand[k].dst;
+    }
+
+    beam_node_t *temp = curr;
+    curr = next;
+    next = temp;
+    size = next_size;
+  }
+
+  /*
+   * Free temporary variables
+   */
+  free(temp_path);
+  for (int t = 0; t < n_threads; t++) {
+    free_state(workers[t].child_state);
+    free_state(workers[t].probe_state);
+    free(workers[t].array_s1);
+  }
+  free(started);
+  free(threads);
+  free(workers);
+  free(n_cand);
+  free(cand);
+  if (curr > next) {
+    curr = next;
+  }
+  for (int i = 0; i < 2 * width; i++) {
+    if (curr[i].state != NULL) {
+      free(curr[i].path);
+      free_state(curr[i].state);
+    }
+  }
+  free(curr);
+
+  return best_len;
+}
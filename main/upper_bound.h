@@ -21,6 +21,8 @@
 #include "move.h"
 #include "state.h"
 
+enum { JZW, SM2 };
+
 /**
  * Solve a state by the JZW heuristic. Be careful that the state will be
  * modified in place.
@@ -33,6 +35,20 @@
  */
 int jzw(state_t *state, move_t *path, int len, int max_len);
 
+/**
+ * Solve a state by the JZW heuristic with random tie-breaking. Be careful that
+ * the state will be modified in place.
+ *
+ * @param state the state
+ * @param path array of moves
+ * @param len current number of moves
+ * @param max_len maximum allowed length
+ * @param seed random seed, or NULL to break ties deterministically
+ * @return length of the heuristic solution or INT_MAX if failure occurs
+ */
+int jzw_random(state_t *state, move_t *path, int len, int max_len,
+               unsigned *seed);
+
 /**
  * Solve a state by the SM-2 heuristic. Be careful that the state will be
  * modified in place.
@@ -45,4 +61,72 @@ int jzw(state_t *state, move_t *path, int len, int max_len);
  */
 int sm2(state_t *state, move_t *path, int len, int max_len);
 
+/**
+ * Solve a state by the SM-2 heuristic with random tie-breaking. Be careful
+ * that the state will be modified in place.
+ *
+ * @param state the state
+ * @param path array of moves
+ * @param len current number of moves
+ * @param max_len maximum allowed length
+ * @param seed random seed, or NULL to break ties deterministically
+ * @return length of the heuristic solution or INT_MAX if failure occurs
+ */
+int sm2_random(state_t *state, move_t *path, int len, int max_len,
+               unsigned *seed);
+
+/**
+ * Solve a state by the JZW and SM-2 heuristics in a single pass, sharing the
+ * moves and the per-step analysis until the two heuristics diverge. After
+ * that, SM-2 is stopped as soon as it cannot beat JZW. The better solution is
+ * left in path. Be careful that the state will be modified in place.
+ *
+ * @param state the state
+ * @param temp_state temporary state for SM-2 after divergence
+ * @param path array of moves
+ * @param temp_path temporary array of moves for SM-2 after divergence
+ * @param len current number of moves
+ * @param max_len maximum allowed length
+ * @param len_jzw length of the JZW solution or INT_MAX if failure occurs
+ * @param len_sm2 length of the SM-2 solution or INT_MAX if failure occurs or
+ * it departs from the JZW solution without being shorter
+ * @return length of the better solution or INT_MAX if failure occurs
+ */
+int jzw_sm2(state_t *state, state_t *temp_state, move_t *path,
+            move_t *temp_path, int len, int max_len, int *len_jzw,
+            int *len_sm2);
+
+/**
+ * Solve a state by restarting randomized JZW and SM-2 heuristics on multiple
+ * threads, alternating the two heuristics. The state is left unchanged.
+ *
+ * @param state the state
+ * @param path array of moves
+ * @param max_len maximum allowed length
+ * @param n_restarts number of restarts
+ * @param end_time wall-clock deadline, as given by get_wall_time()
+ * @param n_threads number of worker threads
+ * @param seed random seed
+ * @return length of the best solution found or INT_MAX if failure occurs
+ */
+int multi_start(state_t *state, move_t *path, int max_len, int n_restarts,
+                double end_time, int n_threads, unsigned seed);
+
+/**
+ * Solve a state by beam search, where partial sequences are bounded by LB-TS
+ * and ranked by the length of their JZW and SM-2 completions. The search stops
+ * at the deadline with the best completion found so far. The state is left
+ * unchanged.
+ *
+ * @param state the state
+ * @param path array of moves
+ * @param max_len maximum allowed length
+ * @param width beam width
+ * @param end_time wall-clock deadline, as given by get_wall_time()
+ * @param n_threads number of worker threads
+ * @return length of the best solution found or INT_MAX if failure occurs
+ */
+int beam(state_t *state, move_t *path, int max_len, int width,
+         double end_time, int n_threads);
+
 #endif
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "verifier.h"
+#include <stdlib.h>
+
+static const char *status_names[] = {"valid", "illegal", "unfinished",
+                                     "unreadable"};
+
+bool verify_moves(state_t *state, instance_t *inst, move_t *path, int len,
+                  FILE *trace, verify_t *result) {
+  init_state(state, inst);
+  int n_retrievals = 0;
+  for (int i = 0;; i++) {
+    while (is_retrievable(state)) {
+      retrieve(state, i);
+      n_retrievals++;
+    }
+    if (trace != NULL) {
+      if (i > 0) {
+        fprintf(trace, "(%d: %d -> %d)\n", path[i - 1].p, path[i - 1].s,
+                path[i - 1].d);
+      }
+      print_state(trace, state);
+    }
+    if (i == len) {
+      result->status =
+          state->n_blocks == 0 ? VERIFY_VALID : VERIFY_UNFINISHED;
+      result->n_relocations = len;
+      break;
+    }
+
+    int s = path[i].s;
+    int d = path[i].d;
+    if (s < 0 || s >= state->n_stacks || d < 0 || d >= state->n_stacks ||
+        s == d || state->h[s] == 0 || state->p[s][state->h[s]] != path[i].p ||
+        state->h[d] == state->n_tiers) {
+      result->status = VERIFY_ILLEGAL;
+      result->n_relocations = i;
+      break;
+    }
+    relocate(state, s, d, i + 1);
+  }
+  result->n_retrievals = n_retrievals;
+  result->n_left = state->n_blocks;
+  return result->status == VERIFY_VALID;
+}
+
+long verify_batch(reader_t *reader, FILE *solutions, FILE *out, FILE *trace) {
+  state_t *state = NULL;
+  long n_invalid = 0;
+  instance_t *inst;
+  for (long id = 0;; id++) {
+    int status = read_next_instance(reader, &inst);
+    int c;
+    while ((c = fgetc(solutions)) == ' ' || c == '\t' || c == '\r' ||
+           c == '\n') {
+    }
+    if (status == 0 || c == EOF) {
+      if (status != 0 || c != EOF) {
+        n_invalid = -1; // instances and solutions do not match up
+      }
+      break;
+    }
+    ungetc(c, solutions);
+
+    verify_t result = {VERIFY_UNREADABLE, 0, 0, 0};
+    int len;
+    move_t *path = read_moves(solutions, &len);
+    if (path == NULL) {
+      while ((c = fgetc(solutions)) != '\n' && c != EOF) {
+      }
+    } else if (status == 1) {
+      if (state == NULL || state->n_stacks != inst->n_stacks ||
+          state->n_tiers != inst->n_tiers) {
+        if (state != NULL) {
+          free_state(state);
+        }
+        state = malloc_state(inst->n_stacks, inst->n_tiers, true, true, false);
+      }
+      verify_moves(state, inst, path, len, trace, &result);
+    }
+    free(path);
+
+    if (result.status != VERIFY_VALID) {
+      n_invalid++;
+    }
+    fprintf(out, "%ld %s %d %d\n", id, status_names[result.status],
+            result.n_relocations, result.n_retrievals);
+  }
+
+  if (state != NULL) {
+    free_state(state);
+  }
+  return n_invalid;
+}
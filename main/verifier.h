@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include "state.h"
+
+enum { VERIFY_VALID, VERIFY_ILLEGAL, VERIFY_UNFINISHED, VERIFY_UNREADABLE };
+
+typedef struct {
+  int status;        // VERIFY_VALID, VERIFY_ILLEGAL, ...
+  int n_relocations; // number of legal relocations replayed
+  int n_retrievals;  // number of retrievals performed
+  int n_left;        // number of blocks left in the bay
+} verify_t;
+
+/**
+ * Check that moves empty the bay of an instance, performing every possible
+ * retrieval before the first move and after each move. Replaying stops at
+ * the first illegal move, whose index is n_relocations.
+ *
+ * @param state space for the replay, of the size of the instance and with
+ * head and body
+ * @param inst the instance
+ * @param path array of moves
+ * @param len number of moves
+ * @param trace stream for the bay after each move, or NULL
+ * @param result set to the outcome of the replay
+ * @return true if the moves are a solution
+ */
+bool verify_moves(state_t *state, instance_t *inst, move_t *path, int len,
+                  FILE *trace, verify_t *result);
+
+/**
+ * Check one solution per instance, and print one line per instance: its
+ * position in the input, the status, the number of legal relocations and the
+ * number of retrievals
+ *
+ * @param reader instances
+ * @param solutions stream of move lists in the format of print_moves, one per
+ * instance in the same order
+ * @param out stream for the results
+ * @param trace stream for the bay after each move, or NULL
+ * @return number of instances whose solution is not valid, or -1 if the
+ * instances or the solutions run out before the other
+ */
+long verify_batch(reader_t *reader, FILE *solutions, FILE *out, FILE *trace);
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ucrp.h"
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(void) {
+  fprintf(stdout, "usage: main-verify -h\n");
+  fprintf(stdout, "usage: main-verify"
+                  " --input/-i input_file"
+                  " --solutions/-s solution_file"
+                  " [--trace/-T]\n");
+  fprintf(stdout, "\t--input/-i: text file with one or more instances\n");
+  fprintf(stdout, "\t--solutions/-s: one move list per instance in the"
+                  " output format of main-solve (- for stdin)\n");
+  fprintf(stdout, "\t--trace/-T: print the bay after each move\n");
+  fprintf(stdout, "output format:\n");
+  fprintf(stdout, "\tid valid|illegal|unfinished|unreadable n_relocations"
+                  " n_retrievals\n");
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+  char *opts = "hi:s:T";
+  struct option options[] = {{"help", no_argument, NULL, 'h'},
+                             {"input", required_argument, NULL, 'i'},
+                             {"solutions", required_argument, NULL, 's'},
+                             {"trace", no_argument, NULL, 'T'},
+                             {NULL, 0, NULL, 0}};
+
+  char *input = NULL;
+  char *solutions = NULL;
+  bool trace = false;
+
+  for (int opt; (opt = getopt_long(argc, argv, opts, options, NULL)) != -1;) {
+    switch (opt) {
+    case 'h':
+      usage();
+      return EXIT_SUCCESS;
+    case 'i':
+      input = optarg;
+      break;
+    case 's':
+      solutions = optarg;
+      break;
+    case 'T':
+      trace = true;
+      break;
+    default:
+      fprintf(stderr, "Unknown option: %c\n", opt);
+      return EXIT_FAILURE;
+    }
+  }
+  if (input == NULL || solutions == NULL) {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  FILE *fp = fopen(input, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Failed to open file: %s\n", input);
+    return EXIT_FAILURE;
+  }
+  FILE *sol_fp = strcmp(solutions, "-") == 0 ? stdin : fopen(solutions, "r");
+  if (sol_fp == NULL) {
+    fprintf(stderr, "Failed to open file: %s\n", solutions);
+    fclose(fp);
+    return EXIT_FAILURE;
+  }
+  setvbuf(stdout, NULL, _IOFBF, 1 << 20);
+
+  long n_invalid =
+      ucrp_verify_batch(fp, sol_fp, stdout, trace ? stdout : NULL);
+  fclose(fp);
+  if (sol_fp != stdin) {
+    fclose(sol_fp);
+  }
+
+  if (n_invalid < 0) {
+    fprintf(stderr, "Numbers of instances and solutions differ\n");
+  } else if (n_invalid > 0) {
+    fprintf(stderr, "%ld solutions are not valid\n", n_invalid);
+  }
+  return n_invalid == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "batch.h"
+#include "check.h"
+#include <string.h>
+
+static const char *text = "3 4 6\n"
+                          "2 3 1\n"
+                          "1 6\n"
+                          "3 2 5 4\n"
+                          "2 2 2\n"
+                          "1 2\n"
+                          "1 1\n";
+
+/*
+ * Write a batch of the text to a file, returning the number of instances
+ */
+static long write_text(const char *output) {
+  FILE *fp = fopen(output, "wb");
+  CHECK(fp != NULL);
+  reader_t *reader = open_memory_reader(text, strlen(text));
+  long n = write_batch(fp, reader);
+  close_reader(reader);
+  fclose(fp);
+  return n;
+}
+
+/*
+ * Overwrite one int of the first record
+ */
+static void patch_record(const char *output, int field, int value) {
+  batch_t *batch = open_batch((char *)output);
+  CHECK(batch != NULL);
+  long offset = (long)batch->offsets[0] + (long)sizeof(int) * field;
+  close_batch(batch);
+
+  FILE *fp = fopen(output, "r+b");
+  CHECK(fp != NULL);
+  CHECK(fseek(fp, offset, SEEK_SET) == 0);
+  CHECK(fwrite(&value, sizeof(int), 1, fp) == 1);
+  fclose(fp);
+}
+
+static void test_round_trip(const char *output) {
+  CHECK(write_text(output) == 2);
+  CHECK(is_batch_file((char *)output));
+  batch_t *batch = open_batch((char *)output);
+  CHECK(batch != NULL);
+  CHECK(batch->n_instances == 2);
+
+  reader_t *reader = open_memory_reader(text, strlen(text));
+  for (long i = 0; i < batch->n_instances; i++) {
+    instance_t *expected;
+    CHECK(read_next_instance(reader, &expected) == 1);
+    instance_t *inst = get_batch_instance(batch, i);
+    CHECK(inst != NULL);
+    CHECK(inst->n_stacks == expected->n_stacks);
+    CHECK(inst->n_tiers == expected->n_tiers);
+    CHECK(inst->n_blocks == expected->n_blocks);
+    CHECK(inst->max_prio == expected->max_prio);
+    for (int s = 0; s < inst->n_stacks; s++) {
+      CHECK(inst->h[s] == expected->h[s]);
+      for (int t = 1; t <= inst->h[s]; t++) {
+        CHECK(inst->p[s][t] == expected->p[s][t]);
+      }
+    }
+    free_instance(inst);
+  }
+  CHECK(get_batch_instance(batch, 2) == NULL);
+  close_reader(reader);
+  close_batch(batch);
+}
+
+static void test_corrupt(const char *output) {
+  /*
+   * Fields of the first record: n_stacks, n_tiers, n_blocks, max_prio, h[3],
+   * then p[s][0..4] from offset 7 + 5 * s
+   */
+  int fields[][2] = {
+      {0, 0},       {0, 1 << 20}, {1, 0},  {1, 1 << 30}, {2, 5},
+      {2, 7},       {3, 3},       {3, 7},  {4, 1000},    {4, -1},
+      {5, 5},       {7 + 1, 0},   {7 + 6, -4},
+  };
+  int n_fields = sizeof(fields) / sizeof(fields[0]);
+  for (int k = 0; k < n_fields; k++) {
+    CHECK(write_text(output) == 2);
+    patch_record(output, fields[k][0], fields[k][1]);
+    batch_t *batch = open_batch((char *)output);
+    CHECK(batch != NULL);
+    CHECK(get_batch_instance(batch, 0) == NULL);
+    instance_t *inst = get_batch_instance(batch, 1);
+    CHECK(inst != NULL);
+    free_instance(inst);
+    close_batch(batch);
+  }
+}
+
+int main(int argc, char **argv) {
+  const char *output = argc > 1 ? argv[1] : "batch.bin";
+  test_round_trip(output);
+  test_corrupt(output);
+  remove(output);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "ucrp.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_CELLS 64
+#define N_CHECKS 7
+#define PROFILE "calibration.profile"
+
+/*
+ * Random full bays with one free tier per stack
+ */
+static const int sizes[][2] = {{5, 5}, {6, 5}, {6, 6}, {7, 5}};
+
+static unsigned long seed = 4711;
+
+static int next_random(int n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (int)((seed >> 33) % (unsigned long)n);
+}
+
+static ucrp_instance_t *random_instance(int n_stacks, int n_tiers) {
+  int h[MAX_CELLS], p[MAX_CELLS] = {0}, prio[MAX_CELLS];
+  int n_blocks = n_stacks * (n_tiers - 1);
+  for (int i = 0; i < n_blocks; i++) {
+    prio[i] = i + 1;
+  }
+  for (int i = n_blocks - 1; i > 0; i--) {
+    int j = next_random(i + 1), tmp = prio[i];
+    prio[i] = prio[j];
+    prio[j] = tmp;
+  }
+  for (int s = 0, i = 0; s < n_stacks; s++) {
+    h[s] = n_tiers - 1;
+    for (int t = 0; t < h[s]; t++) {
+      p[s * n_tiers + t] = prio[i++];
+    }
+  }
+  return ucrp_new_instance(n_stacks, n_tiers, h, p);
+}
+
+/*
+ * Profiles that rank the checks in a given sequence: the three compiled into
+ * the search, the rules backwards, and random ones, which are searched with
+ * the sequence read at run time
+ */
+static const char *check_names[N_CHECKS] = {"EA", "TB", "IB", "SA",
+                                            "SB", "SD", "LB"};
+
+static const int sequences[][N_CHECKS] = {{0, 1, 2, 3, 4, 5, 6},
+                                          {2, 6, 1, 0, 3, 4, 5},
+                                          {6, 2, 1, 0, 3, 4, 5},
+                                          {6, 5, 4, 3, 2, 1, 0}};
+
+static void write_profile(const int *seq) {
+  FILE *fp = fopen(PROFILE, "w");
+  CHECK(fp != NULL);
+  for (int i = 0; i < N_CHECKS; i++) {
+    fprintf(fp, "%s 1000 %d 10000\n", check_names[seq[i]], 700 - 100 * i);
+  }
+  fprintf(fp, "-- 1000 0 0\n");
+  CHECK(fclose(fp) == 0);
+}
+
+static int count_lines(const char *path) {
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    return -1;
+  }
+  int n = 0;
+  for (int c; (c = getc(fp)) != EOF;) {
+    n += c == '\n';
+  }
+  fclose(fp);
+  return n;
+}
+
+/*
+ * Any order of the checks prunes the same branches, so every solve is to
+ * search the same nodes and return the same moves
+ */
+static ucrp_report_t *solve(ucrp_instance_t *inst, long calibration_nodes,
+                            const char *check_profile) {
+  ucrp_param_t *param = ucrp_new_param();
+  CHECK(param != NULL);
+  ucrp_param_set_progress(param, UCRP_LOG_QUIET, NULL, NULL, 1000000);
+  ucrp_param_set_threads(param, 1);
+  ucrp_param_set_calibration(param, calibration_nodes, check_profile);
+  ucrp_report_t *report = ucrp_solve(inst, param);
+  ucrp_free_param(param);
+  CHECK(report != NULL);
+  return report;
+}
+
+static void check_same(ucrp_report_t *report, ucrp_report_t *expected) {
+  CHECK(ucrp_report_lb(report) == ucrp_report_lb(expected));
+  CHECK(ucrp_report_ub(report) == ucrp_report_ub(expected));
+  CHECK(ucrp_report_nodes(report) == ucrp_report_nodes(expected));
+  CHECK(memcmp(ucrp_report_moves(report), ucrp_report_moves(expected),
+               sizeof(ucrp_move_t) * ucrp_report_ub(expected)) == 0);
+  ucrp_free_report(report);
+}
+
+int main(void) {
+  long n_nodes = 0;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    for (int r = 0; r < 4; r++) {
+      ucrp_instance_t *inst = random_instance(sizes[i][0], sizes[i][1]);
+      CHECK(inst != NULL);
+      ucrp_report_t *expected = solve(inst, 0, NULL);
+      n_nodes += ucrp_report_nodes(expected);
+
+      /*
+       * Calibrating on the first nodes, which records the profile once they
+       * are searched, and starting from the profile recorded
+       */
+      remove(PROFILE);
+      check_same(solve(inst, 20, NULL), expected);
+      check_same(solve(inst, 20, PROFILE), expected);
+      CHECK(count_lines(PROFILE) ==
+            (ucrp_report_nodes(expected) > 20 ? N_CHECKS + 1 : -1));
+      check_same(solve(inst, 0, PROFILE), expected);
+
+      /*
+       * Profiles for every kind of sequence
+       */
+      for (size_t k = 0; k < sizeof(sequences) / sizeof(sequences[0]); k++) {
+        write_profile(sequences[k]);
+        check_same(solve(inst, 0, PROFILE), expected);
+      }
+      int seq[N_CHECKS];
+      for (int c = 0; c < N_CHECKS; c++) {
+        seq[c] = c;
+      }
+      for (int c = N_CHECKS - 1; c > 0; c--) {
+        int j = next_random(c + 1), tmp = seq[c];
+        seq[c] = seq[j];
+        seq[j] = tmp;
+      }
+      write_profile(seq);
+      check_same(solve(inst, 0, PROFILE), expected);
+
+      ucrp_free_report(expected);
+      ucrp_free_instance(inst);
+    }
+  }
+  remove(PROFILE);
+  CHECK(n_nodes > 0);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "ucrp.h"
+
+#define N_ENGINES 4
+#define MAX_CELLS 64
+
+/*
+ * Random bays with one free tier per stack, small enough to solve at once
+ */
+static const int sizes[][2] = {{5, 5}, {6, 5}, {6, 6}, {7, 5}, {7, 6}};
+
+static unsigned long seed = 12345;
+
+static int next_random(int n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (int)((seed >> 33) % (unsigned long)n);
+}
+
+static ucrp_instance_t *random_instance(int n_stacks, int n_tiers) {
+  int h[MAX_CELLS], p[MAX_CELLS] = {0}, prio[MAX_CELLS];
+  int n_blocks = n_stacks * (n_tiers - 1);
+  for (int i = 0; i < n_blocks; i++) {
+    prio[i] = i + 1;
+  }
+  for (int i = n_blocks - 1; i > 0; i--) {
+    int j = next_random(i + 1), tmp = prio[i];
+    prio[i] = prio[j];
+    prio[j] = tmp;
+  }
+  for (int s = 0, i = 0; s < n_stacks; s++) {
+    h[s] = n_tiers - 1;
+    for (int t = 0; t < h[s]; t++) {
+      p[s * n_tiers + t] = prio[i++];
+    }
+  }
+  return ucrp_new_instance(n_stacks, n_tiers, h, p);
+}
+
+/*
+ * Solve with IDBB, A* and fringe search, the last one also with no node
+ * memory so that it falls back to iterative deepening
+ */
+static ucrp_report_t *solve(ucrp_instance_t *inst, int k) {
+  static const int engines[N_ENGINES] = {
+      UCRP_ENGINE_IDBB, UCRP_ENGINE_ASTAR, UCRP_ENGINE_FRINGE,
+      UCRP_ENGINE_FRINGE};
+  ucrp_param_t *param = ucrp_new_param();
+  CHECK(param != NULL);
+  ucrp_param_set_progress(param, UCRP_LOG_QUIET, NULL, NULL, 1000000);
+  ucrp_param_set_threads(param, 1);
+  ucrp_param_set_engine(param, engines[k], k == 3 ? 0 : 64);
+  ucrp_report_t *report = ucrp_solve(inst, param);
+  ucrp_free_param(param);
+  CHECK(report != NULL);
+  return report;
+}
+
+int main(void) {
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    for (int r = 0; r < 4; r++) {
+      ucrp_instance_t *inst = random_instance(sizes[i][0], sizes[i][1]);
+      CHECK(inst != NULL);
+      int optimum = -1;
+      for (int k = 0; k < N_ENGINES; k++) {
+        ucrp_report_t *report = solve(inst, k);
+        int ub = ucrp_report_ub(report);
+        CHECK(ucrp_report_lb(report) == ub);
+        CHECK(optimum < 0 || ub == optimum);
+        optimum = ub;
+        CHECK(ucrp_verify(inst, ucrp_report_moves(report), ub, NULL) ==
+              UCRP_VERIFY_VALID);
+        ucrp_free_report(report);
+      }
+      ucrp_free_instance(inst);
+    }
+  }
+  return EXIT_SUCCESS;
+}
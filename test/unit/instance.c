@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "instance.h"
+#include <limits.h>
+#include <string.h>
+
+/*
+ * Read all instances of a text, counting those read and those skipped
+ */
+static void read_all(const char *text, int *n_read, int *n_skipped) {
+  reader_t *reader = open_memory_reader(text, strlen(text));
+  instance_t *inst;
+  *n_read = 0;
+  *n_skipped = 0;
+  for (int status; (status = read_next_instance(reader, &inst)) != 0;) {
+    if (status > 0) {
+      (*n_read)++;
+    } else {
+      (*n_skipped)++;
+    }
+  }
+  close_reader(reader);
+}
+
+static void test_valid(void) {
+  const char *text = "# comment\n"
+                     "3 4 5\n"
+                     "2 3 1\n"
+                     "\n"
+                     "0\n"
+                     "3 2 5 4\r\n";
+  reader_t *reader = open_memory_reader(text, strlen(text));
+  instance_t *inst;
+  CHECK(read_next_instance(reader, &inst) == 1);
+  CHECK(inst->n_stacks == 3 && inst->n_tiers == 4 && inst->n_blocks == 5);
+  CHECK(inst->max_prio == 5);
+  CHECK(inst->h[0] == 2 && inst->h[1] == 0 && inst->h[2] == 3);
+  CHECK(inst->p[0][1] == 3 && inst->p[0][2] == 1);
+  CHECK(inst->p[2][1] == 2 && inst->p[2][2] == 5 && inst->p[2][3] == 4);
+  CHECK(read_next_instance(reader, &inst) == 0);
+  close_reader(reader);
+}
+
+static void test_malformed(void) {
+  int n_read;
+  int n_skipped;
+
+  // priority 0 is the empty slot of a state
+  read_all("2 2 2\n1 0\n1 1\n2 2 2\n1 2\n1 1\n", &n_read, &n_skipped);
+  CHECK(n_read == 1 && n_skipped == 1);
+
+  read_all("2 2 2\n1 -1\n1 1\n", &n_read, &n_skipped);
+  CHECK(n_read == 0 && n_skipped == 1);
+
+  // extra tokens on a stack line or the header line
+  read_all("2 2 2\n1 2 7\n1 1\n2 2 2\n1 2\n1 1\n", &n_read, &n_skipped);
+  CHECK(n_read == 1 && n_skipped == 1);
+  read_all("2 2 2 9\n1 2\n1 1\n2 2 2\n1 2\n1 1\n", &n_read, &n_skipped);
+  CHECK(n_read == 1 && n_skipped == 1);
+
+  // heights beyond the tiers and block counts that do not add up
+  read_all("2 2 3\n3 1 2 3\n0\n", &n_read, &n_skipped);
+  CHECK(n_read == 0 && n_skipped == 1);
+  read_all("2 2 3\n1 1\n1 2\n", &n_read, &n_skipped);
+  CHECK(n_read == 0 && n_skipped == 1);
+
+  // a bay too large to allocate
+  read_all("2147483647 2147483647 0\n", &n_read, &n_skipped);
+  CHECK(n_read == 0 && n_skipped == 1);
+  CHECK(malloc_instance(INT_MAX, INT_MAX) == NULL);
+  CHECK(malloc_instance(100000, 100000) == NULL);
+  CHECK(malloc_instance(0, 1) == NULL);
+}
+
+static void test_long_line(void) {
+  int n_tiers = 100000;
+  size_t cap = (size_t)n_tiers * 8 + 64;
+  char *text = malloc(cap);
+  int len = sprintf(text, "1 %d %d\n%d", n_tiers, n_tiers, n_tiers);
+  for (int t = 1; t <= n_tiers; t++) {
+    len += sprintf(text + len, " %d", n_tiers + 1 - t);
+  }
+  len += sprintf(text + len, "\n");
+
+  FILE *fp = tmpfile();
+  CHECK(fp != NULL);
+  CHECK(fwrite(text, 1, len, fp) == (size_t)len);
+  rewind(fp);
+  reader_t *reader = open_reader(fp);
+  instance_t *inst;
+  CHECK(read_next_instance(reader, &inst) == 1);
+  CHECK(inst->h[0] == n_tiers && inst->max_prio == n_tiers);
+  CHECK(inst->p[0][n_tiers] == 1);
+  close_reader(reader);
+  fclose(fp);
+  free(text);
+}
+
+static void test_round_trip(void) {
+  const char *text = "4 3 7\n3 7 1 4\n0\n2 2 6\n2 3 5\n";
+  reader_t *reader = open_memory_reader(text, strlen(text));
+  instance_t *inst;
+  CHECK(read_next_instance(reader, &inst) == 1);
+
+  FILE *fp = tmpfile();
+  CHECK(fp != NULL);
+  write_instance(fp, inst);
+  rewind(fp);
+  reader_t *copy_reader = open_reader(fp);
+  instance_t *copy;
+  CHECK(read_next_instance(copy_reader, &copy) == 1);
+  CHECK(copy->n_stacks == inst->n_stacks && copy->n_tiers == inst->n_tiers);
+  CHECK(copy->n_blocks == inst->n_blocks && copy->max_prio == inst->max_prio);
+  for (int s = 0; s < inst->n_stacks; s++) {
+    CHECK(copy->h[s] == inst->h[s]);
+    for (int t = 1; t <= inst->h[s]; t++) {
+      CHECK(copy->p[s][t] == inst->p[s][t]);
+    }
+  }
+  close_reader(copy_reader);
+  fclose(fp);
+  close_reader(reader);
+}
+
+int main(void) {
+  test_valid();
+  test_malformed();
+  test_long_line();
+  test_round_trip();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "param.h"
+#include "state.h"
+#include "ucrp.h"
+#include <string.h>
+
+#define MAX_CELLS 64
+
+/*
+ * Random bays with few distinct priorities, so that many stacks tie, and
+ * with some stacks left empty
+ */
+static const int sizes[][2] = {{4, 4}, {5, 4}, {6, 4}, {5, 5}, {6, 5}};
+
+static unsigned long seed = 4242;
+
+static int next_random(int n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (int)((seed >> 33) % (unsigned long)n);
+}
+
+static ucrp_instance_t *random_instance(int n_stacks, int n_tiers) {
+  int h[MAX_CELLS] = {0}, p[MAX_CELLS] = {0};
+  int n_filled = n_stacks - 1 - next_random(2);
+  int n_prios = 2 + next_random(n_filled * (n_tiers - 1) / 2);
+  for (int s = 0; s < n_filled; s++) {
+    h[s] = n_tiers - 1;
+    for (int t = 0; t < h[s]; t++) {
+      p[s * n_tiers + t] = 1 + next_random(n_prios);
+    }
+  }
+  for (int s = n_stacks - 1; s > 0; s--) {
+    int r = next_random(s + 1);
+    int tmp[MAX_CELLS];
+    memcpy(tmp, p + s * n_tiers, sizeof(int) * n_tiers);
+    memcpy(p + s * n_tiers, p + r * n_tiers, sizeof(int) * n_tiers);
+    memcpy(p + r * n_tiers, tmp, sizeof(int) * n_tiers);
+    int h_tmp = h[s];
+    h[s] = h[r];
+    h[r] = h_tmp;
+  }
+  return ucrp_new_instance(n_stacks, n_tiers, h, p);
+}
+
+/*
+ * Random relocations and retrievals on a state sorted on every change and on
+ * a lazy one, which are to find the same first stack after every change and
+ * the same list whenever the lazy one is sorted
+ */
+static void test_walk(ucrp_instance_t *inst) {
+  int n_stacks = inst->n_stacks;
+  int n_tiers = inst->n_tiers;
+  state_t *eager = malloc_state(n_stacks, n_tiers, true, true, true);
+  state_t *lazy = malloc_state(n_stacks, n_tiers, true, true, true);
+  set_lazy_order(lazy, true);
+  init_state(eager, inst);
+  init_state(lazy, inst);
+
+  for (int l = 1; l <= 200 && eager->n_blocks > 0; l++) {
+    if (is_retrievable(eager)) {
+      CHECK(is_retrievable(lazy));
+      CHECK(first_stack(lazy) == first_stack(eager));
+      retrieve(eager, l);
+      retrieve(lazy, l);
+    } else {
+      int s = next_random(n_stacks);
+      int d = next_random(n_stacks);
+      if (s == d || eager->h[s] == 0 || eager->h[d] == n_tiers) {
+        continue;
+      }
+      relocate(eager, s, d, l);
+      relocate(lazy, s, d, l);
+    }
+    CHECK(first_stack(lazy) == first_stack(eager));
+    if (next_random(4) == 0) {
+      order_stacks(lazy);
+      CHECK(memcmp(lazy->list, eager->list, sizeof(int) * n_stacks) == 0);
+      CHECK(memcmp(lazy->rank, eager->rank, sizeof(int) * n_stacks) == 0);
+    }
+  }
+  order_stacks(lazy);
+  CHECK(memcmp(lazy->list, eager->list, sizeof(int) * n_stacks) == 0);
+  CHECK(hash_state(lazy) == hash_state(eager));
+
+  free_state(eager);
+  free_state(lazy);
+}
+
+/*
+ * The solver with and without lazy ordering, which are to search the same
+ * nodes and return the same moves
+ */
+static ucrp_report_t *solve(ucrp_instance_t *inst, bool lazy_order) {
+  ucrp_param_t *param = ucrp_new_param();
+  CHECK(param != NULL);
+  ucrp_param_set_progress(param, UCRP_LOG_QUIET, NULL, NULL, 1000000);
+  ucrp_param_set_threads(param, 1);
+  param->lazy_order = lazy_order;
+  ucrp_report_t *report = ucrp_solve(inst, param);
+  ucrp_free_param(param);
+  CHECK(report != NULL);
+  return report;
+}
+
+static long test_solve(ucrp_instance_t *inst) {
+  ucrp_report_t *eager = solve(inst, false);
+  ucrp_report_t *lazy = solve(inst, true);
+  CHECK(ucrp_report_lb(lazy) == ucrp_report_lb(eager));
+  CHECK(ucrp_report_ub(lazy) == ucrp_report_ub(eager));
+  CHECK(ucrp_report_nodes(lazy) == ucrp_report_nodes(eager));
+  CHECK(memcmp(ucrp_report_moves(lazy), ucrp_report_moves(eager),
+               sizeof(ucrp_move_t) * ucrp_report_ub(eager)) == 0);
+  long n_nodes = ucrp_report_nodes(eager);
+  ucrp_free_report(eager);
+  ucrp_free_report(lazy);
+  return n_nodes;
+}
+
+int main(void) {
+  long n_nodes = 0;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    for (int r = 0; r < 20; r++) {
+      ucrp_instance_t *inst = random_instance(sizes[i][0], sizes[i][1]);
+      CHECK(inst != NULL);
+      test_walk(inst);
+      n_nodes += test_solve(inst);
+      ucrp_free_instance(inst);
+    }
+  }
+  CHECK(n_nodes > 0); // some bays are searched, not solved by the heuristics
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "logger.h"
+#include "param.h"
+#include "ucrp.h"
+#include <string.h>
+#include <sys/stat.h>
+
+#define MAX_CELLS 64
+#define MAX_LINE 1024
+
+static log_event_t make_event(const char *status, long n_nodes) {
+  log_event_t event = {status, 3, 5, 0.5, 0.25, 1.125, n_nodes, 7, 2, 9, 4};
+  return event;
+}
+
+static long file_size(FILE *fp) {
+  struct stat st;
+  CHECK(fstat(fileno(fp), &st) == 0);
+  return (long)st.st_size;
+}
+
+/*
+ * One line per event
+ */
+static void test_format(void) {
+  FILE *fp = tmpfile();
+  CHECK(fp != NULL);
+  log_event_t event = make_event("update", 100);
+  print_event(fp, &event);
+  rewind(fp);
+  char line[MAX_LINE];
+  CHECK(fgets(line, sizeof(line), fp) != NULL);
+  CHECK(strcmp(line, "[update] best_lb = 3 @ 0.500 / best_ub = 5 @ 0.250 / "
+                     "time = 1.125 / nodes = 100 / probe = 7 / skip = 2 / "
+                     "cache = 4/9\n") == 0);
+  CHECK(fgets(line, sizeof(line), fp) == NULL);
+  fclose(fp);
+}
+
+/*
+ * Events queued are printed in order by the background thread; flushing
+ * waits for them, and so does closing
+ */
+static void test_order(void) {
+  FILE *fp = tmpfile();
+  FILE *expected = tmpfile();
+  CHECK(fp != NULL && expected != NULL);
+  logger_t *logger = open_logger(fp, 1024);
+  for (long i = 0; i < 500; i++) {
+    log_event_t event = make_event("running", i);
+    log_event(logger, &event);
+    print_event(expected, &event);
+  }
+  fflush(expected);
+  flush_logger(logger);
+  CHECK(file_size(fp) == file_size(expected));
+
+  log_event_t event = make_event("end", 500);
+  log_event(logger, &event);
+  print_event(expected, &event);
+  close_logger(logger);
+  rewind(fp);
+  rewind(expected);
+  char line[MAX_LINE], expected_line[MAX_LINE];
+  while (fgets(expected_line, sizeof(expected_line), expected) != NULL) {
+    CHECK(fgets(line, sizeof(line), fp) != NULL);
+    CHECK(strcmp(line, expected_line) == 0);
+  }
+  CHECK(fgets(line, sizeof(line), fp) == NULL);
+  fclose(fp);
+  fclose(expected);
+}
+
+/*
+ * Events beyond the capacity are dropped rather than waited for, and
+ * counted, so that every event is either printed, in order, or counted
+ */
+static void test_drop(void) {
+  FILE *fp = tmpfile();
+  CHECK(fp != NULL);
+  logger_t *logger = open_logger(fp, 2);
+  for (long i = 0; i < 10000; i++) {
+    log_event_t event = make_event("running", i);
+    log_event(logger, &event);
+  }
+  close_logger(logger);
+
+  rewind(fp);
+  char line[MAX_LINE];
+  long n_printed = 0, n_dropped = 0, last = -1;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    long n;
+    if (sscanf(line, "[log] %ld events dropped", &n) == 1) {
+      n_dropped += n;
+    } else {
+      char *nodes = strstr(line, "nodes = ");
+      CHECK(nodes != NULL && sscanf(nodes, "nodes = %ld", &n) == 1);
+      CHECK(n > last);
+      last = n;
+      n_printed++;
+    }
+  }
+  CHECK(n_printed > 0);
+  CHECK(n_printed + n_dropped == 10000);
+  fclose(fp);
+}
+
+/*
+ * The solver logs its events to the logger of the parameters, and nothing
+ * in quiet mode
+ */
+static ucrp_instance_t *instance(void) {
+  static const int prios[] = {12, 3,  17, 8,  20, 1,  14, 6,  19, 10,
+                              2,  15, 7,  18, 4,  11, 16, 5,  13, 9};
+  int h[MAX_CELLS], p[MAX_CELLS] = {0};
+  for (int s = 0, i = 0; s < 5; s++) {
+    h[s] = 4;
+    for (int t = 0; t < h[s]; t++) {
+      p[s * 5 + t] = prios[i++];
+    }
+  }
+  return ucrp_new_instance(5, 5, h, p);
+}
+
+static FILE *solve(ucrp_instance_t *inst, int log_level) {
+  FILE *fp = tmpfile();
+  CHECK(fp != NULL);
+  ucrp_param_t *param = ucrp_new_param();
+  CHECK(param != NULL);
+  ucrp_param_set_progress(param, log_level, NULL, NULL, 1000000);
+  ucrp_param_set_threads(param, 1);
+  param->logger = open_logger(fp, 1024);
+  ucrp_report_t *report = ucrp_solve(inst, param);
+  CHECK(report != NULL);
+  close_logger(param->logger);
+  ucrp_free_report(report);
+  ucrp_free_param(param);
+  rewind(fp);
+  return fp;
+}
+
+static void test_solve(void) {
+  ucrp_instance_t *inst = instance();
+  CHECK(inst != NULL);
+
+  FILE *fp = solve(inst, UCRP_LOG_QUIET);
+  CHECK(file_size(fp) == 0);
+  fclose(fp);
+
+  fp = solve(inst, UCRP_LOG_NORMAL);
+  char line[MAX_LINE], last[MAX_LINE] = "";
+  CHECK(fgets(line, sizeof(line), fp) != NULL);
+  CHECK(strncmp(line, "[start] ", 8) == 0);
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    CHECK(strncmp(line, "[running] ", 10) != 0);
+    strcpy(last, line);
+  }
+  CHECK(strncmp(last, "[end] ", 6) == 0);
+  fclose(fp);
+
+  ucrp_free_instance(inst);
+}
+
+int main(void) {
+  test_format();
+  test_order();
+  test_drop();
+  test_solve();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "move.h"
+#include "report.h"
+#include "ucrp.h"
+#include <string.h>
+
+#define MAX_CELLS 64
+#define MAX_MOVES 200
+
+/*
+ * Read moves from a string through a temporary file
+ */
+static move_t *read_string(const char *s, int *len) {
+  FILE *fp = tmpfile();
+  CHECK(fp != NULL);
+  fputs(s, fp);
+  rewind(fp);
+  move_t *path = read_moves(fp, len);
+  fclose(fp);
+  return path;
+}
+
+static void test_read(void) {
+  /*
+   * What print_moves prints reads back the same, beyond the first buffer,
+   * and one list after another from a stream
+   */
+  move_t path[MAX_MOVES];
+  for (int i = 0; i < MAX_MOVES; i++) {
+    path[i] = (move_t){i * 7 + 1, i % 5, (i + 3) % 11};
+  }
+  FILE *fp = tmpfile();
+  CHECK(fp != NULL);
+  print_moves(fp, path, MAX_MOVES);
+  print_moves(fp, path + 1, 2);
+  print_moves(fp, path, 0);
+  rewind(fp);
+  int len = -1;
+  move_t *read = read_moves(fp, &len);
+  CHECK(read != NULL && len == MAX_MOVES);
+  CHECK(memcmp(read, path, sizeof(move_t) * MAX_MOVES) == 0);
+  free(read);
+  read = read_moves(fp, &len);
+  CHECK(read != NULL && len == 2);
+  CHECK(memcmp(read, path + 1, sizeof(move_t) * 2) == 0);
+  free(read);
+  read = read_moves(fp, &len);
+  CHECK(read != NULL && len == 0);
+  free(read);
+  CHECK(read_moves(fp, &len) == NULL);
+  fclose(fp);
+
+  /*
+   * Whitespace between tokens, but not inside them
+   */
+  read = read_string(" [ (12:0->3) ,\n\t(4 : 1 -> 0)\r\n]", &len);
+  CHECK(read != NULL && len == 2);
+  CHECK(read[0].p == 12 && read[0].s == 0 && read[0].d == 3);
+  CHECK(read[1].p == 4 && read[1].s == 1 && read[1].d == 0);
+  free(read);
+
+  static const char *malformed[] = {
+      "",
+      "?\n",
+      "(1: 0 -> 1)]",
+      "[(1: 0 -> 1)",
+      "[(1: 0 -> 1),]",
+      "[(1: 0 - > 1)]",
+      "[(1: 0 -> 1) (2: 1 -> 0)]",
+      "[(1: 0 -> 1)), (2: 1 -> 0)]",
+      "[(a: 0 -> 1)]",
+      "[(1: 0 -> )]",
+      "[(1 0 -> 1)]",
+      "[(3000000000: 0 -> 1)]",
+  };
+  for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+    CHECK(read_string(malformed[i], &len) == NULL);
+  }
+}
+
+/*
+ * A bay whose priorities exceed its number of cells, so that the solver
+ * searches their ranks and maps the incumbent to them
+ */
+static ucrp_instance_t *instance(void) {
+  static const int prios[] = {120, 30,  170, 80,  200, 10, 140,
+                              60,  190, 100, 20,  150, 70, 180,
+                              40,  110, 160, 50,  130, 90};
+  int h[MAX_CELLS], p[MAX_CELLS] = {0};
+  for (int s = 0, i = 0; s < 5; s++) {
+    h[s] = 4;
+    for (int t = 0; t < h[s]; t++) {
+      p[s * 5 + t] = prios[i++];
+    }
+  }
+  return ucrp_new_instance(5, 5, h, p);
+}
+
+static ucrp_report_t *solve(ucrp_instance_t *inst, const ucrp_move_t *moves,
+                            int len) {
+  ucrp_param_t *param = ucrp_new_param();
+  CHECK(param != NULL);
+  ucrp_param_set_progress(param, UCRP_LOG_QUIET, NULL, NULL, 1000000);
+  ucrp_param_set_threads(param, 1);
+  ucrp_param_set_initial_solution(param, moves, len);
+  ucrp_report_t *report = ucrp_solve(inst, param);
+  ucrp_free_param(param);
+  CHECK(report != NULL);
+  CHECK(report->best_lb == report->best_ub);
+  CHECK(ucrp_verify(inst, ucrp_report_moves(report), report->best_ub,
+                    NULL) == UCRP_VERIFY_VALID);
+  return report;
+}
+
+static void test_warm_start(void) {
+  ucrp_instance_t *inst = instance();
+  CHECK(inst != NULL);
+  ucrp_report_t *cold = solve(inst, NULL, 0);
+  int optimum = cold->best_ub;
+
+  /*
+   * A heuristic solution, or the optimum, is the initial upper bound
+   */
+  ucrp_report_t *heuristic = ucrp_solve_heuristic(inst, UCRP_SM2);
+  CHECK(heuristic != NULL);
+  int len = ucrp_report_ub(heuristic);
+  CHECK(len > optimum);
+  ucrp_report_t *warm = solve(inst, ucrp_report_moves(heuristic), len);
+  CHECK(warm->init_ub == len && warm->best_ub == optimum);
+  ucrp_free_report(warm);
+
+  warm = solve(inst, ucrp_report_moves(cold), optimum);
+  CHECK(warm->init_ub == optimum && warm->best_ub == optimum);
+  CHECK(memcmp(warm->best_sol, cold->best_sol, sizeof(move_t) * optimum) ==
+        0);
+  ucrp_free_report(warm);
+
+  /*
+   * Incumbents that do not solve the bay are ignored
+   */
+  ucrp_move_t moves[MAX_CELLS];
+  memcpy(moves, ucrp_report_moves(heuristic), sizeof(ucrp_move_t) * len);
+  warm = solve(inst, moves, len - 1);
+  CHECK(warm->init_ub == cold->init_ub && warm->best_ub == optimum);
+  ucrp_free_report(warm);
+  moves[0].p++;
+  warm = solve(inst, moves, len);
+  CHECK(warm->init_ub == cold->init_ub && warm->best_ub == optimum);
+  ucrp_free_report(warm);
+  moves[0].p--;
+  moves[0].d = 5;
+  warm = solve(inst, moves, len);
+  CHECK(warm->init_ub == cold->init_ub && warm->best_ub == optimum);
+  ucrp_free_report(warm);
+
+  ucrp_free_report(heuristic);
+  ucrp_free_report(cold);
+  ucrp_free_instance(inst);
+}
+
+int main(void) {
+  test_read();
+  test_warm_start();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "ucrp.h"
+
+/*
+ * A bay whose priorities exceed its cells, which is searched by rank
+ */
+static void test_sparse(void) {
+  static const int h[3] = {2, 1, 1};
+  static const int p[9] = {5, 1000000000, 0, 7, 0, 0, 9, 0, 0};
+  static const ucrp_move_t expected[2] = {{7, 1, 2}, {1000000000, 0, 1}};
+  ucrp_instance_t *inst = ucrp_new_instance(3, 3, h, p);
+  CHECK(inst != NULL);
+  ucrp_param_t *param = ucrp_new_param();
+  CHECK(param != NULL);
+  ucrp_param_set_progress(param, UCRP_LOG_QUIET, NULL, NULL, 1000000);
+  ucrp_solver_t *solver = ucrp_new_solver(3, 3);
+  CHECK(solver != NULL);
+  ucrp_report_t *report = ucrp_run_solver(solver, inst, param);
+  CHECK(report != NULL);
+  CHECK(ucrp_report_lb(report) == 2 && ucrp_report_ub(report) == 2);
+  const ucrp_move_t *moves = ucrp_report_moves(report);
+  for (int i = 0; i < 2; i++) {
+    CHECK(moves[i].p == expected[i].p && moves[i].s == expected[i].s &&
+          moves[i].d == expected[i].d);
+  }
+  ucrp_free_report(report);
+  ucrp_free_solver(solver);
+  ucrp_free_param(param);
+  ucrp_free_instance(inst);
+}
+
+/*
+ * Progress callback checking that the moves it is given solve the bay
+ */
+static bool check_progress(const ucrp_progress_t *progress, void *data) {
+  int ub = ucrp_progress_ub(progress);
+  CHECK(ucrp_verify(data, ucrp_progress_moves(progress), ub, NULL) ==
+        UCRP_VERIFY_VALID);
+  return false;
+}
+
+/*
+ * A bay that takes branching, scaled so that it is searched by rank, which
+ * must solve it as the bay itself, and report its own priorities in the
+ * progress and the moves
+ */
+static void test_scaled(void) {
+  static const int h[5] = {5, 5, 5, 5, 5};
+  static const int p[35] = {2,  22, 14, 20, 8,  0, 0, 9,  1,  19, 21, 5,
+                            0,  0, 7,  24, 3,  17, 6,  0, 0, 15, 18, 16,
+                            12, 11, 0, 0, 25, 4,  13, 10, 23, 0, 0};
+  int scaled[35];
+  for (int i = 0; i < 35; i++) {
+    scaled[i] = p[i] * 80000000;
+  }
+  ucrp_instance_t *inst = ucrp_new_instance(5, 7, h, p);
+  ucrp_instance_t *sparse = ucrp_new_instance(5, 7, h, scaled);
+  CHECK(inst != NULL && sparse != NULL);
+  ucrp_param_t *param = ucrp_new_param();
+  CHECK(param != NULL);
+  ucrp_param_set_threads(param, 1);
+  ucrp_param_set_progress(param, UCRP_LOG_QUIET, NULL, NULL, 1000000);
+  ucrp_report_t *report = ucrp_solve(inst, param);
+  ucrp_param_set_progress(param, UCRP_LOG_QUIET, check_progress, sparse, 100);
+  ucrp_report_t *sparse_report = ucrp_solve(sparse, param);
+  CHECK(report != NULL && sparse_report != NULL);
+  CHECK(ucrp_report_lb(report) == ucrp_report_ub(report));
+  CHECK(ucrp_report_ub(sparse_report) == ucrp_report_ub(report));
+  CHECK(ucrp_report_lb(sparse_report) == ucrp_report_lb(report));
+  CHECK(ucrp_report_nodes(sparse_report) == ucrp_report_nodes(report));
+  CHECK(ucrp_verify(sparse, ucrp_report_moves(sparse_report),
+                    ucrp_report_ub(sparse_report),
+                    NULL) == UCRP_VERIFY_VALID);
+  ucrp_free_report(sparse_report);
+  ucrp_free_report(report);
+  ucrp_free_param(param);
+  ucrp_free_instance(sparse);
+  ucrp_free_instance(inst);
+}
+
+int main(void) {
+  test_sparse();
+  test_scaled();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "probe_cache.h"
+#include "report.h"
+#include "ucrp.h"
+
+#define MAX_CELLS 64
+
+static bool is_unknown(const probe_entry_t *entry) {
+  return entry->min_len[0] == 0 && entry->min_len[1] == 0 &&
+         !entry->exact[0] && !entry->exact[1];
+}
+
+/*
+ * Hits keep what is known of a state, and a key mapping to an occupied slot
+ * replaces its entry rather than reading it
+ */
+static void test_entries(void) {
+  probe_cache_t *cache = malloc_probe_cache(1000);
+  CHECK(cache->size == 512);
+
+  /*
+   * A new cache knows nothing, whatever the key, including those it fills
+   * its slots with
+   */
+  for (int i = 0; i < cache->size; i++) {
+    CHECK(is_unknown(find_probe_entry(cache, ~(uint64_t)i)));
+  }
+  clear_probe_cache(cache);
+
+  /*
+   * Hit
+   */
+  uint64_t key = 0x123456789abcdefu;
+  probe_entry_t *entry = find_probe_entry(cache, key);
+  CHECK(is_unknown(entry));
+  entry->min_len[0] = 7;
+  entry->exact[0] = true;
+  entry->min_len[1] = 9;
+  CHECK(find_probe_entry(cache, key) == entry);
+  CHECK(entry->min_len[0] == 7 && entry->exact[0]);
+  CHECK(entry->min_len[1] == 9 && !entry->exact[1]);
+
+  /*
+   * Collision in the same slot, which evicts the first key
+   */
+  uint64_t other = key + (uint64_t)cache->size;
+  CHECK(find_probe_entry(cache, other) == entry);
+  CHECK(entry->key == other);
+  CHECK(is_unknown(entry));
+  entry->min_len[1] = 4;
+  CHECK(is_unknown(find_probe_entry(cache, key)));
+
+  /*
+   * Another slot is left alone
+   */
+  probe_entry_t *next = find_probe_entry(cache, key + 1);
+  CHECK(next != entry);
+  next->min_len[0] = 3;
+  CHECK(find_probe_entry(cache, key)->key == key);
+  CHECK(find_probe_entry(cache, key + 1)->min_len[0] == 3);
+
+  /*
+   * Clearing forgets every entry
+   */
+  clear_probe_cache(cache);
+  CHECK(is_unknown(find_probe_entry(cache, key + 1)));
+  free_probe_cache(cache);
+}
+
+/*
+ * The search with and without the cache, which only skips heuristics known
+ * to fail, so that both find the same bounds after the same nodes
+ */
+static const int sizes[][2] = {{5, 5}, {6, 5}, {6, 6}, {7, 5}};
+
+static unsigned long seed = 2024;
+
+static int next_random(int n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (int)((seed >> 33) % (unsigned long)n);
+}
+
+static ucrp_instance_t *random_instance(int n_stacks, int n_tiers) {
+  int h[MAX_CELLS], p[MAX_CELLS] = {0}, prio[MAX_CELLS];
+  int n_blocks = n_stacks * (n_tiers - 1);
+  for (int i = 0; i < n_blocks; i++) {
+    prio[i] = i + 1;
+  }
+  for (int i = n_blocks - 1; i > 0; i--) {
+    int j = next_random(i + 1), tmp = prio[i];
+    prio[i] = prio[j];
+    prio[j] = tmp;
+  }
+  for (int s = 0, i = 0; s < n_stacks; s++) {
+    h[s] = n_tiers - 1;
+    for (int t = 0; t < h[s]; t++) {
+      p[s * n_tiers + t] = prio[i++];
+    }
+  }
+  return ucrp_new_instance(n_stacks, n_tiers, h, p);
+}
+
+static ucrp_report_t *solve(ucrp_instance_t *inst, int cache_size) {
+  ucrp_param_t *param = ucrp_new_param();
+  CHECK(param != NULL);
+  ucrp_param_set_progress(param, UCRP_LOG_QUIET, NULL, NULL, 1000000);
+  ucrp_param_set_threads(param, 1);
+  ucrp_param_set_probe(param, UCRP_PROBE_ALWAYS, 1, cache_size);
+  ucrp_report_t *report = ucrp_solve(inst, param);
+  ucrp_free_param(param);
+  CHECK(report != NULL);
+  return report;
+}
+
+static void test_search(void) {
+  long n_lookup = 0;
+  long n_hit = 0;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    for (int r = 0; r < 5; r++) {
+      ucrp_instance_t *inst = random_instance(sizes[i][0], sizes[i][1]);
+      CHECK(inst != NULL);
+      ucrp_report_t *plain = solve(inst, 0);
+      ucrp_report_t *cached = solve(inst, 1 << 12);
+      CHECK(cached->best_lb == plain->best_lb);
+      CHECK(cached->best_ub == plain->best_ub);
+      CHECK(cached->n_nodes == plain->n_nodes);
+      CHECK(plain->n_cache_lookup == 0);
+      CHECK(cached->n_cache_lookup == plain->n_probe);
+      CHECK(cached->n_probe + cached->n_cache_hit == plain->n_probe);
+      n_lookup += cached->n_cache_lookup;
+      n_hit += cached->n_cache_hit;
+      ucrp_free_report(plain);
+      ucrp_free_report(cached);
+      ucrp_free_instance(inst);
+    }
+  }
+  CHECK(n_hit > 0 && n_hit < n_lookup);
+}
+
+int main(void) {
+  test_entries();
+  test_search();
+  return EXIT_SUCCESS;
+}
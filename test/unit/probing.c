@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "report.h"
+#include "ucrp.h"
+#include <limits.h>
+
+#define MAX_CELLS 64
+
+/*
+ * Random full bays with one free tier per stack, deep enough for the
+ * heuristics to miss at some depths
+ */
+static const int sizes[][2] = {{6, 5}, {6, 6}, {7, 5}};
+
+static unsigned long seed = 8086;
+
+static int next_random(int n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (int)((seed >> 33) % (unsigned long)n);
+}
+
+static ucrp_instance_t *random_instance(int n_stacks, int n_tiers) {
+  int h[MAX_CELLS], p[MAX_CELLS] = {0}, prio[MAX_CELLS];
+  int n_blocks = n_stacks * (n_tiers - 1);
+  for (int i = 0; i < n_blocks; i++) {
+    prio[i] = i + 1;
+  }
+  for (int i = n_blocks - 1; i > 0; i--) {
+    int j = next_random(i + 1), tmp = prio[i];
+    prio[i] = prio[j];
+    prio[j] = tmp;
+  }
+  for (int s = 0, i = 0; s < n_stacks; s++) {
+    h[s] = n_tiers - 1;
+    for (int t = 0; t < h[s]; t++) {
+      p[s * n_tiers + t] = prio[i++];
+    }
+  }
+  return ucrp_new_instance(n_stacks, n_tiers, h, p);
+}
+
+/*
+ * Solve without the probe cache, so that every probe is counted
+ */
+static ucrp_report_t *solve(ucrp_instance_t *inst, int policy,
+                            int threshold) {
+  ucrp_param_t *param = ucrp_new_param();
+  CHECK(param != NULL);
+  ucrp_param_set_progress(param, UCRP_LOG_QUIET, NULL, NULL, 1000000);
+  ucrp_param_set_threads(param, 1);
+  ucrp_param_set_probe(param, policy, threshold, 0);
+  ucrp_report_t *report = ucrp_solve(inst, param);
+  ucrp_free_param(param);
+  CHECK(report != NULL);
+  CHECK(report->best_lb == report->best_ub);
+  CHECK(ucrp_verify(inst, ucrp_report_moves(report), report->best_ub, NULL) ==
+        UCRP_VERIFY_VALID);
+  return report;
+}
+
+int main(void) {
+  long n_probe_always = 0;
+  long n_probe_adaptive = 0;
+  long n_skip = 0;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    for (int r = 0; r < 5; r++) {
+      ucrp_instance_t *inst = random_instance(sizes[i][0], sizes[i][1]);
+      CHECK(inst != NULL);
+
+      /*
+       * Probing always skips nothing, and neither does adaptive probing
+       * that never sees enough misses in a row to back off
+       */
+      ucrp_report_t *always = solve(inst, UCRP_PROBE_ALWAYS, 1);
+      CHECK(always->n_probe_skip == 0);
+      ucrp_report_t *patient = solve(inst, UCRP_PROBE_ADAPTIVE, INT_MAX);
+      CHECK(patient->n_probe_skip == 0);
+      CHECK(patient->n_probe == always->n_probe);
+      CHECK(patient->n_nodes == always->n_nodes);
+
+      /*
+       * Backing off after every miss skips probes but finds the same
+       * optimum
+       */
+      ucrp_report_t *adaptive = solve(inst, UCRP_PROBE_ADAPTIVE, 1);
+      CHECK(adaptive->best_ub == always->best_ub);
+      n_probe_always += always->n_probe;
+      n_probe_adaptive += adaptive->n_probe;
+      n_skip += adaptive->n_probe_skip;
+
+      ucrp_free_report(always);
+      ucrp_free_report(patient);
+      ucrp_free_report(adaptive);
+      ucrp_free_instance(inst);
+    }
+  }
+  CHECK(n_skip > 0);
+  CHECK(n_probe_adaptive < n_probe_always);
+  return EXIT_SUCCESS;
+}
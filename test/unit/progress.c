@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "ucrp.h"
+
+#define MAX_CELLS 64
+#define HEARTBEAT_NODES 100
+
+/*
+ * Random full bays with one free tier per stack
+ */
+static const int sizes[][2] = {{5, 5}, {6, 5}, {6, 6}, {7, 5}};
+
+static unsigned long seed = 777;
+
+static int next_random(int n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (int)((seed >> 33) % (unsigned long)n);
+}
+
+static ucrp_instance_t *random_instance(int n_stacks, int n_tiers) {
+  int h[MAX_CELLS], p[MAX_CELLS] = {0}, prio[MAX_CELLS];
+  int n_blocks = n_stacks * (n_tiers - 1);
+  for (int i = 0; i < n_blocks; i++) {
+    prio[i] = i + 1;
+  }
+  for (int i = n_blocks - 1; i > 0; i--) {
+    int j = next_random(i + 1), tmp = prio[i];
+    prio[i] = prio[j];
+    prio[j] = tmp;
+  }
+  for (int s = 0, i = 0; s < n_stacks; s++) {
+    h[s] = n_tiers - 1;
+    for (int t = 0; t < h[s]; t++) {
+      p[s * n_tiers + t] = prio[i++];
+    }
+  }
+  return ucrp_new_instance(n_stacks, n_tiers, h, p);
+}
+
+/*
+ * Events seen by the callback, which checks each one as it fires and stops
+ * the search at the first event of stop_type, if any
+ */
+typedef struct {
+  ucrp_instance_t *inst;
+  int stop_type;
+  int n_events[4];
+  int n_total;
+  int last_lb;
+  int last_ub;
+  long last_nodes;
+  double last_time;
+} events_t;
+
+static bool on_progress(const ucrp_progress_t *progress, void *data) {
+  events_t *events = data;
+  int type = ucrp_progress_type(progress);
+  int lb = ucrp_progress_lb(progress);
+  int ub = ucrp_progress_ub(progress);
+  CHECK(type >= UCRP_PROGRESS_START && type <= UCRP_PROGRESS_HEARTBEAT);
+  CHECK((type == UCRP_PROGRESS_START) == (events->n_total == 0));
+  CHECK(lb <= ub);
+  CHECK(events->n_total == 0 ||
+        (lb >= events->last_lb && ub <= events->last_ub));
+  CHECK(ucrp_progress_nodes(progress) >= events->last_nodes);
+  CHECK(ucrp_progress_time(progress) >= events->last_time);
+  CHECK(ucrp_verify(events->inst, ucrp_progress_moves(progress), ub, NULL) ==
+        UCRP_VERIFY_VALID);
+
+  events->n_events[type]++;
+  events->n_total++;
+  events->last_lb = lb;
+  events->last_ub = ub;
+  events->last_nodes = ucrp_progress_nodes(progress);
+  events->last_time = ucrp_progress_time(progress);
+  return type == events->stop_type;
+}
+
+static ucrp_report_t *solve(events_t *events) {
+  ucrp_param_t *param = ucrp_new_param();
+  CHECK(param != NULL);
+  ucrp_param_set_progress(param, UCRP_LOG_QUIET, on_progress, events,
+                          HEARTBEAT_NODES);
+  ucrp_param_set_threads(param, 1);
+  ucrp_report_t *report = ucrp_solve(events->inst, param);
+  ucrp_free_param(param);
+  CHECK(report != NULL);
+  return report;
+}
+
+int main(void) {
+  int n_searched = 0;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    for (int r = 0; r < 5; r++) {
+      ucrp_instance_t *inst = random_instance(sizes[i][0], sizes[i][1]);
+      CHECK(inst != NULL);
+
+      /*
+       * Every event up to the optimum, which the last one reports
+       */
+      events_t events = {inst, -1, {0}, 0, 0, 0, 0, 0};
+      ucrp_report_t *report = solve(&events);
+      long n_nodes = ucrp_report_nodes(report);
+      CHECK(events.n_events[UCRP_PROGRESS_START] == 1);
+      CHECK(ucrp_report_lb(report) == ucrp_report_ub(report));
+      CHECK(events.last_ub == ucrp_report_ub(report));
+      CHECK(events.n_events[UCRP_PROGRESS_HEARTBEAT] ==
+            n_nodes / HEARTBEAT_NODES);
+      n_searched += n_nodes > HEARTBEAT_NODES;
+      ucrp_free_report(report);
+
+      /*
+       * Stopping at the start reports the initial solution without a search
+       */
+      events_t stopped = {inst, UCRP_PROGRESS_START, {0}, 0, 0, 0, 0, 0};
+      report = solve(&stopped);
+      CHECK(stopped.n_total == 1);
+      CHECK(ucrp_report_nodes(report) == 0);
+      CHECK(ucrp_report_ub(report) == stopped.last_ub);
+      CHECK(ucrp_verify(inst, ucrp_report_moves(report),
+                        ucrp_report_ub(report), NULL) == UCRP_VERIFY_VALID);
+      ucrp_free_report(report);
+
+      /*
+       * Stopping at the first deepening skips the rest of the search
+       */
+      stopped = (events_t){inst, UCRP_PROGRESS_DEEPEN, {0}, 0, 0, 0, 0, 0};
+      report = solve(&stopped);
+      CHECK(stopped.n_events[UCRP_PROGRESS_DEEPEN] <= 1);
+      CHECK(ucrp_report_lb(report) == stopped.last_lb);
+      CHECK(ucrp_report_ub(report) == stopped.last_ub);
+      CHECK(ucrp_report_nodes(report) <= n_nodes);
+      ucrp_free_report(report);
+
+      ucrp_free_instance(inst);
+    }
+  }
+  CHECK(n_searched > 0);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "report.h"
+#include <string.h>
+
+#define MAX_LINE 1024
+
+/*
+ * Print through a temporary file, and read the output back
+ */
+static char output[4 * MAX_LINE];
+
+static const char *print(int format, long id, report_t *report) {
+  FILE *fp = tmpfile();
+  CHECK(fp != NULL);
+  print_report_header(fp, format);
+  print_report(fp, format, id, report);
+  rewind(fp);
+  size_t len = fread(output, 1, sizeof(output) - 1, fp);
+  output[len] = '\0';
+  fclose(fp);
+  return output;
+}
+
+static int count(const char *s, char c) {
+  int n = 0;
+  for (; *s != '\0'; s++) {
+    n += *s == c;
+  }
+  return n;
+}
+
+int main(void) {
+  move_t sol[] = {{3, 0, 2}, {5, 1, 0}};
+  report_t *feasible =
+      new_report(1, 4, 1, 2, sol, 0.25, 0.5, 1.5, 100, 20, 3, 12, 4);
+  report_t *optimal = new_report(2, 2, 2, 2, sol, 0, 0, 0.125, 0, 0, 0, 0, 0);
+
+  /*
+   * JSON: one object per line, without a header
+   */
+  CHECK(strcmp(print(OUTPUT_JSON, 7, feasible),
+               "{\"id\": 7, \"status\": \"feasible\", \"init_lb\": 1, "
+               "\"init_ub\": 4, \"best_lb\": 1, \"best_ub\": 2, "
+               "\"time_to_best_lb\": 0.250000, "
+               "\"time_to_best_ub\": 0.500000, \"time_used\": 1.500000, "
+               "\"n_nodes\": 100, \"n_probe\": 20, \"n_probe_skip\": 3, "
+               "\"n_cache_lookup\": 12, \"n_cache_hit\": 4, "
+               "\"solution\": [[3, 0, 2], [5, 1, 0]]}\n") == 0);
+  CHECK(strstr(print(OUTPUT_JSON, 0, optimal), "\"status\": \"optimal\"") !=
+        NULL);
+  CHECK(strcmp(print(OUTPUT_JSON, 3, NULL),
+               "{\"id\": 3, \"status\": \"infeasible\", \"init_lb\": null, "
+               "\"init_ub\": null, \"best_lb\": null, \"best_ub\": null, "
+               "\"time_to_best_lb\": null, \"time_to_best_ub\": null, "
+               "\"time_used\": null, \"n_nodes\": null, \"n_probe\": null, "
+               "\"n_probe_skip\": null, \"n_cache_lookup\": null, "
+               "\"n_cache_hit\": null, \"solution\": null}\n") == 0);
+
+  /*
+   * CSV: a header row, then rows with as many fields, empty if unknown
+   */
+  const char *header = "id,status,init_lb,init_ub,best_lb,best_ub,"
+                       "time_to_best_lb,time_to_best_ub,time_used,n_nodes,"
+                       "n_probe,n_probe_skip,n_cache_lookup,n_cache_hit,"
+                       "solution\n";
+  size_t header_len = strlen(header);
+  const char *csv = print(OUTPUT_CSV, 7, feasible);
+  CHECK(strncmp(csv, header, header_len) == 0);
+  CHECK(strcmp(csv + header_len, "7,feasible,1,4,1,2,0.250000,0.500000,"
+                                 "1.500000,100,20,3,12,4,3:0:2;5:1:0\n") == 0);
+  csv = print(OUTPUT_CSV, 3, NULL);
+  CHECK(strcmp(csv + header_len, "3,infeasible,,,,,,,,,,,,,\n") == 0);
+  CHECK(count(csv + header_len, ',') == count(header, ','));
+
+  free_report(feasible);
+  free_report(optimal);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "param.h"
+#include "result_cache.h"
+#include "ucrp.h"
+
+/*
+ * The second bay is the first with its stacks reversed and its priorities p
+ * relabelled to 3p + 7; the third one swaps two priorities of the first
+ */
+static const int heights[3][4] = {{3, 2, 0, 4}, {4, 0, 2, 3}, {3, 2, 0, 4}};
+static const int prios[3][16] = {
+    {2, 7, 4, 0, 9, 1, 0, 0, 0, 0, 0, 0, 3, 8, 6, 5},
+    {16, 31, 25, 22, 0, 0, 0, 0, 34, 10, 0, 0, 13, 28, 19, 0},
+    {2, 7, 4, 0, 9, 1, 0, 0, 0, 0, 0, 0, 3, 8, 5, 6},
+};
+
+static void remove_cache(const char *path) {
+  char index[4096];
+  snprintf(index, sizeof(index), "%s.idx", path);
+  remove(path);
+  remove(index);
+}
+
+int main(int argc, char **argv) {
+  char *path = argc > 1 ? argv[1] : "result_cache.bin";
+  remove_cache(path);
+
+  instance_t *inst[3];
+  for (int k = 0; k < 3; k++) {
+    inst[k] = ucrp_new_instance(4, 4, heights[k], prios[k]);
+    CHECK(inst[k] != NULL);
+  }
+
+  /*
+   * Solve the first instance and store its result
+   */
+  param_t param;
+  init_param(&param);
+  param.log_level = LOG_QUIET;
+  param.n_threads = 1;
+  report_t *report = ucrp_solve(inst[0], &param);
+  CHECK(report != NULL && report->best_lb == report->best_ub);
+  CHECK(report->best_ub > 0);
+
+  result_cache_t *cache = open_result_cache(path);
+  CHECK(cache != NULL);
+  CHECK(lookup_result(cache, inst[1]) == NULL);
+  CHECK(store_result(cache, inst[0], report));
+  close_result_cache(cache);
+
+  /*
+   * After reopening, the relabelled and permuted bay hits, with moves that
+   * solve it, while the bay of another order misses
+   */
+  cache = open_result_cache(path);
+  CHECK(cache != NULL);
+  report_t *cached = lookup_result(cache, inst[1]);
+  CHECK(cached != NULL);
+  CHECK(cached->best_lb == report->best_lb);
+  CHECK(cached->best_ub == report->best_ub);
+  CHECK(ucrp_verify(inst[1], (ucrp_move_t *)cached->best_sol, cached->best_ub,
+                    NULL) == UCRP_VERIFY_VALID);
+  CHECK(ucrp_verify(inst[1], (ucrp_move_t *)report->best_sol, report->best_ub,
+                    NULL) != UCRP_VERIFY_VALID);
+  CHECK(lookup_result(cache, inst[2]) == NULL);
+  close_result_cache(cache);
+
+  free_report(cached);
+  free_report(report);
+  for (int k = 0; k < 3; k++) {
+    ucrp_free_instance(inst[k]);
+  }
+  remove_cache(path);
+  return EXIT_SUCCESS;
+}
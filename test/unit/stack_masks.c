@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "state.h"
+#include "ucrp.h"
+
+#define MAX_CELLS 512
+
+/*
+ * Random bays of up to three words of stacks, about half full, with some
+ * stacks empty and some full
+ */
+static const int sizes[][2] = {{4, 4}, {10, 5}, {63, 3}, {64, 3},
+                               {65, 4}, {130, 3}};
+
+static unsigned long seed = 6502;
+
+static int next_random(int n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (int)((seed >> 33) % (unsigned long)n);
+}
+
+static ucrp_instance_t *random_instance(int n_stacks, int n_tiers) {
+  int h[MAX_CELLS], p[MAX_CELLS] = {0};
+  for (int s = 0; s < n_stacks; s++) {
+    h[s] = next_random(n_tiers + 1);
+    for (int t = 0; t < h[s]; t++) {
+      p[s * n_tiers + t] = 1 + next_random(2 * n_stacks);
+    }
+  }
+  return ucrp_new_instance(n_stacks, n_tiers, h, p);
+}
+
+/*
+ * The masks hold exactly the stacks that are not empty or not full, as
+ * next_stack finds them
+ */
+static void check_masks(state_t *state) {
+  int n_stacks = state->n_stacks;
+  for (int s = 0; s < n_stacks; s++) {
+    bool not_empty = (state->not_empty[s >> 6] >> (s & 63)) & 1;
+    bool not_full = (state->not_full[s >> 6] >> (s & 63)) & 1;
+    CHECK(not_empty == (state->h[s] > 0));
+    CHECK(not_full == (state->h[s] < state->n_tiers));
+  }
+  for (int s = next_stack(state->not_empty, 0, n_stacks), last = -1;
+       s < n_stacks; s = next_stack(state->not_empty, s + 1, n_stacks)) {
+    for (int e = last + 1; e < s; e++) {
+      CHECK(state->h[e] == 0);
+    }
+    CHECK(state->h[s] > 0);
+    last = s;
+  }
+  int n_not_full = 0;
+  for (int d = next_stack(state->not_full, 0, n_stacks); d < n_stacks;
+       d = next_stack(state->not_full, d + 1, n_stacks)) {
+    CHECK(state->h[d] < state->n_tiers);
+    n_not_full++;
+  }
+  for (int d = 0; d < n_stacks; d++) {
+    n_not_full -= state->h[d] < state->n_tiers;
+  }
+  CHECK(n_not_full == 0);
+  CHECK(next_stack(state->not_empty, n_stacks, n_stacks) == n_stacks);
+}
+
+/*
+ * Random relocations and retrievals, each followed by the masks of the state
+ * and of a copy
+ */
+static void test_walk(ucrp_instance_t *inst, int n_stacks, int n_tiers) {
+  state_t *state = malloc_state(n_stacks, n_tiers, true, true, true);
+  state_t *copy = malloc_state(n_stacks, n_tiers, true, true, true);
+  init_state(state, inst);
+  check_masks(state);
+
+  for (int l = 1; l <= 20 * n_stacks && state->n_blocks > 0; l++) {
+    if (is_retrievable(state) && next_random(2) == 0) {
+      retrieve(state, l);
+    } else {
+      int s = next_random(n_stacks);
+      int d = next_random(n_stacks);
+      if (s == d || state->h[s] == 0 || state->h[d] == n_tiers) {
+        continue;
+      }
+      relocate(state, s, d, l);
+    }
+    check_masks(state);
+    copy_state(copy, state);
+    check_masks(copy);
+  }
+  while (is_retrievable(state)) {
+    retrieve(state, 0);
+    check_masks(state);
+  }
+
+  free_state(state);
+  free_state(copy);
+}
+
+int main(void) {
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    for (int r = 0; r < 5; r++) {
+      ucrp_instance_t *inst = random_instance(sizes[i][0], sizes[i][1]);
+      CHECK(inst != NULL);
+      test_walk(inst, sizes[i][0], sizes[i][1]);
+      ucrp_free_instance(inst);
+    }
+  }
+  return EXIT_SUCCESS;
+}
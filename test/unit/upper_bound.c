@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "state.h"
+#include "timer.h"
+#include "ucrp.h"
+#include "upper_bound.h"
+#include <limits.h>
+#include <string.h>
+
+#define MAX_CELLS 64
+#define MAX_MOVES 256
+
+/*
+ * Random full bays with one free tier per stack, with distinct priorities or
+ * with as many as there are stacks, whose ties the randomized heuristics
+ * break at random
+ */
+static const int sizes[][2] = {{5, 5}, {6, 5}, {6, 6}, {7, 5}};
+
+static unsigned long seed = 31337;
+
+static int next_random(int n) {
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+  return (int)((seed >> 33) % (unsigned long)n);
+}
+
+static ucrp_instance_t *random_instance(int n_stacks, int n_tiers,
+                                        bool repeated) {
+  int h[MAX_CELLS], p[MAX_CELLS] = {0}, prio[MAX_CELLS];
+  int n_blocks = n_stacks * (n_tiers - 1);
+  for (int i = 0; i < n_blocks; i++) {
+    prio[i] = repeated ? 1 + i % n_stacks : i + 1;
+  }
+  for (int i = n_blocks - 1; i > 0; i--) {
+    int j = next_random(i + 1), tmp = prio[i];
+    prio[i] = prio[j];
+    prio[j] = tmp;
+  }
+  for (int s = 0, i = 0; s < n_stacks; s++) {
+    h[s] = n_tiers - 1;
+    for (int t = 0; t < h[s]; t++) {
+      p[s * n_tiers + t] = prio[i++];
+    }
+  }
+  return ucrp_new_instance(n_stacks, n_tiers, h, p);
+}
+
+/*
+ * Bays under test, with their root state after the first retrievals, the
+ * better of JZW and SM-2 and the optimum, or LB-TS if not solved
+ */
+typedef struct {
+  ucrp_instance_t *inst;
+  state_t *root;
+  state_t *probe;
+  int greedy;
+  int optimum;
+} bay_t;
+
+static void open_bay(bay_t *bay, int n_stacks, int n_tiers, bool repeated,
+                     bool solved) {
+  bay->inst = random_instance(n_stacks, n_tiers, repeated);
+  CHECK(bay->inst != NULL);
+  bay->root = malloc_state(n_stacks, n_tiers, true, true, false);
+  bay->probe = malloc_state(n_stacks, n_tiers, true, true, false);
+  init_state(bay->root, bay->inst);
+  while (is_retrievable(bay->root)) {
+    retrieve(bay->root, 0);
+  }
+  copy_state(bay->probe, bay->root);
+  int len_jzw = jzw(bay->probe, NULL, 0, INT_MAX);
+  copy_state(bay->probe, bay->root);
+  int len_sm2 = sm2(bay->probe, NULL, 0, INT_MAX);
+  bay->greedy = len_jzw < len_sm2 ? len_jzw : len_sm2;
+  CHECK(bay->greedy < MAX_MOVES);
+  if (!solved) {
+    bay->optimum = ucrp_lower_bound(bay->inst);
+    return;
+  }
+
+  ucrp_param_t *param = ucrp_new_param();
+  CHECK(param != NULL);
+  ucrp_param_set_progress(param, UCRP_LOG_QUIET, NULL, NULL, 1000000);
+  ucrp_param_set_threads(param, 1);
+  ucrp_report_t *report = ucrp_solve(bay->inst, param);
+  ucrp_free_param(param);
+  CHECK(report != NULL);
+  CHECK(ucrp_report_lb(report) == ucrp_report_ub(report));
+  bay->optimum = ucrp_report_ub(report);
+  ucrp_free_report(report);
+}
+
+static void close_bay(bay_t *bay) {
+  free_state(bay->root);
+  free_state(bay->probe);
+  ucrp_free_instance(bay->inst);
+}
+
+/*
+ * Check that a heuristic left the root as it was, and that its moves solve
+ * the bay
+ */
+static void check_solution(bay_t *bay, uint64_t hash, move_t *path,
+                           int len) {
+  CHECK(hash_state(bay->root) == hash);
+  CHECK(len >= bay->optimum && len < MAX_MOVES);
+  copy_state(bay->probe, bay->root);
+  CHECK(replay_moves(bay->probe, path, len) == len);
+  CHECK(bay->probe->n_blocks == 0);
+}
+
+/*
+ * Beam search never does worse than the greedy heuristics it extends, and
+ * finds nothing if the bound is below the optimum or the deadline has passed
+ */
+static int test_beam(bay_t *bay) {
+  move_t path[MAX_MOVES];
+  uint64_t hash = hash_state(bay->root);
+  double end_time = get_wall_time() + 60;
+  int widths[] = {1, 4, 32};
+  int len = INT_MAX;
+  for (int i = 0; i < 3; i++) {
+    len = beam(bay->root, path, bay->greedy, widths[i], end_time, 1);
+    CHECK(len <= bay->greedy);
+    check_solution(bay, hash, path, len);
+  }
+  CHECK(beam(bay->root, path, bay->greedy, 32, end_time, 3) == len);
+  check_solution(bay, hash, path, len);
+  CHECK(beam(bay->root, path, bay->optimum - 1, 32, end_time, 1) == INT_MAX);
+  CHECK(beam(bay->root, path, bay->greedy, 32, get_wall_time(), 1) ==
+        INT_MAX);
+  CHECK(hash_state(bay->root) == hash);
+  return len;
+}
+
+/*
+ * Randomized restarts break ties at random, and the null seed breaks them as
+ * the plain heuristics do; the best restart does not depend on the threads
+ * that run them
+ */
+static void test_multi_start(bay_t *bay) {
+  move_t path[MAX_MOVES];
+  uint64_t hash = hash_state(bay->root);
+  copy_state(bay->probe, bay->root);
+  int len_jzw = jzw(bay->probe, NULL, 0, INT_MAX);
+  copy_state(bay->probe, bay->root);
+  CHECK(jzw_random(bay->probe, NULL, 0, INT_MAX, NULL) == len_jzw);
+  copy_state(bay->probe, bay->root);
+  int len_sm2 = sm2(bay->probe, NULL, 0, INT_MAX);
+  copy_state(bay->probe, bay->root);
+  CHECK(sm2_random(bay->probe, NULL, 0, INT_MAX, NULL) == len_sm2);
+
+  double end_time = get_wall_time() + 60;
+  int max_len = MAX_MOVES - 1;
+  int len = multi_start(bay->root, path, max_len, 64, end_time, 1, 7);
+  check_solution(bay, hash, path, len);
+  CHECK(multi_start(bay->root, path, max_len, 64, end_time, 3, 7) == len);
+  check_solution(bay, hash, path, len);
+  CHECK(multi_start(bay->root, path, bay->optimum - 1, 64, end_time, 1, 7) ==
+        INT_MAX);
+  CHECK(multi_start(bay->root, path, max_len, 64, get_wall_time(), 1, 7) ==
+        INT_MAX);
+  CHECK(multi_start(bay->root, path, max_len, 0, end_time, 1, 7) == INT_MAX);
+  CHECK(hash_state(bay->root) == hash);
+}
+
+/*
+ * The fused pass gives the length of JZW, that of SM-2 if shorter or never
+ * apart from JZW, and the better solution after the moves made so far, on
+ * states along a random walk and under caps around that solution
+ */
+static void check_fused(bay_t *bay, state_t *state, move_t *path, int len,
+                        int max_len) {
+  move_t path_jzw[MAX_MOVES], path_sm2[MAX_MOVES], temp_path[MAX_MOVES];
+  memcpy(path_jzw, path, sizeof(move_t) * len);
+  memcpy(path_sm2, path, sizeof(move_t) * len);
+  copy_state(bay->probe, state);
+  int len_jzw = jzw(bay->probe, path_jzw, len, max_len);
+  copy_state(bay->probe, state);
+  int len_sm2 = sm2(bay->probe, path_sm2, len, max_len);
+  int best = len_sm2 < len_jzw ? len_sm2 : len_jzw;
+
+  state_t *fused = malloc_state(state->n_stacks, state->n_tiers, true, true,
+                                false);
+  state_t *temp = malloc_state(state->n_stacks, state->n_tiers, true, true,
+                               false);
+  copy_state(fused, state);
+  int fused_jzw = -1, fused_sm2 = -1;
+  CHECK(jzw_sm2(fused, temp, path, temp_path, len, max_len, &fused_jzw,
+                &fused_sm2) == best);
+  CHECK(fused_jzw == len_jzw);
+  bool same = len_sm2 == len_jzw && len_jzw != INT_MAX &&
+              memcmp(path_sm2, path_jzw, sizeof(move_t) * len_jzw) == 0;
+  CHECK(fused_sm2 == (len_sm2 < len_jzw || same ? len_sm2 : INT_MAX));
+  if (best != INT_MAX) {
+    CHECK(memcmp(path, len_sm2 < len_jzw ? path_sm2 : path_jzw,
+                 sizeof(move_t) * best) == 0);
+  }
+  free_state(fused);
+  free_state(temp);
+}
+
+static void test_fused(bay_t *bay) {
+  int n_stacks = bay->root->n_stacks;
+  state_t *state = malloc_state(n_stacks, bay->root->n_tiers, true, true,
+                                false);
+  copy_state(state, bay->root);
+  move_t path[MAX_MOVES];
+  for (int len = 0; state->n_blocks > 0 && len < bay->greedy; len++) {
+    check_fused(bay, state, path, len, INT_MAX);
+    check_fused(bay, state, path, len, bay->greedy);
+    check_fused(bay, state, path, len, bay->greedy - 1);
+    check_fused(bay, state, path, len, len);
+
+    int s, d;
+    do {
+      s = next_random(n_stacks);
+      d = next_random(n_stacks);
+    } while (s == d || state->h[s] == 0 || state->h[d] == state->n_tiers);
+    path[len] = (move_t){state->p[s][state->h[s]], s, d};
+    relocate(state, s, d, len + 1);
+    while (is_retrievable(state)) {
+      retrieve(state, len + 1);
+    }
+  }
+  free_state(state);
+}
+
+int main(void) {
+  int n_beam_better = 0;
+  int n_restart_better = 0;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    for (int r = 0; r < 4; r++) {
+      bay_t bay;
+      open_bay(&bay, sizes[i][0], sizes[i][1], r % 2 == 1, true);
+      n_beam_better += test_beam(&bay) < bay.greedy;
+      test_multi_start(&bay);
+      test_fused(&bay);
+      close_bay(&bay);
+    }
+  }
+
+  /*
+   * Restarts pay off on bays larger than those the greedy heuristics solve
+   * optimally
+   */
+  for (int r = 0; r < 32; r++) {
+    bay_t bay;
+    open_bay(&bay, 10, 6, true, false);
+    move_t path[MAX_MOVES];
+    double end_time = get_wall_time() + 60;
+    int len = multi_start(bay.root, path, bay.greedy, 64, end_time, 2, r);
+    CHECK(len <= bay.greedy);
+    check_solution(&bay, hash_state(bay.root), path, len);
+    n_restart_better += len < bay.greedy;
+    close_bay(&bay);
+  }
+  CHECK(n_beam_better > 0);
+  CHECK(n_restart_better > 0);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2023 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "check.h"
+#include "ucrp.h"
+#include "verifier.h"
+#include <string.h>
+
+/*
+ * Stack 0 holds 1 under 2, stack 1 holds 3 and stack 2 is empty, so that
+ * only 2 needs a relocation
+ */
+static const char *text = "3 2 3\n2 1 2\n1 3\n0\n";
+
+static instance_t *read_text(reader_t **reader) {
+  *reader = open_memory_reader(text, strlen(text));
+  instance_t *inst;
+  CHECK(read_next_instance(*reader, &inst) == 1);
+  return inst;
+}
+
+static verify_t verify(instance_t *inst, move_t *path, int len) {
+  state_t *state =
+      malloc_state(inst->n_stacks, inst->n_tiers, true, true, false);
+  verify_t result;
+  bool valid = verify_moves(state, inst, path, len, NULL, &result);
+  CHECK(valid == (result.status == VERIFY_VALID));
+  free_state(state);
+  return result;
+}
+
+static void test_valid(void) {
+  reader_t *reader;
+  instance_t *inst = read_text(&reader);
+  move_t path[] = {{2, 0, 2}};
+  verify_t result = verify(inst, path, 1);
+  CHECK(result.status == VERIFY_VALID);
+  CHECK(result.n_relocations == 1 && result.n_retrievals == 3);
+  CHECK(result.n_left == 0);
+  CHECK(ucrp_verify(inst, (ucrp_move_t *)path, 1, NULL) == UCRP_VERIFY_VALID);
+  close_reader(reader);
+}
+
+static void test_illegal(void) {
+  reader_t *reader;
+  instance_t *inst = read_text(&reader);
+  move_t illegal[][2] = {
+      {{2, 2, 0}, {2, 0, 2}}, // from the empty stack
+      {{1, 0, 2}, {2, 0, 2}}, // a block that is not on top
+      {{3, 1, 0}, {2, 0, 2}}, // onto the full stack
+      {{2, 0, 0}, {2, 0, 2}}, // onto its own stack
+      {{2, 0, 3}, {2, 0, 2}}, // to a stack out of the bay
+      {{2, 0, 2}, {3, 1, 3}}, // legal, then out of the bay
+  };
+  int n_cases = sizeof(illegal) / sizeof(illegal[0]);
+  for (int k = 0; k < n_cases; k++) {
+    verify_t result = verify(inst, illegal[k], 2);
+    CHECK(result.status == VERIFY_ILLEGAL);
+    CHECK(result.n_relocations == (k == n_cases - 1 ? 1 : 0));
+    CHECK(ucrp_verify(inst, (ucrp_move_t *)illegal[k], 2, NULL) ==
+          UCRP_VERIFY_ILLEGAL);
+  }
+  close_reader(reader);
+}
+
+static void test_unfinished(void) {
+  reader_t *reader;
+  instance_t *inst = read_text(&reader);
+  verify_t result = verify(inst, NULL, 0);
+  CHECK(result.status == VERIFY_UNFINISHED);
+  CHECK(result.n_relocations == 0 && result.n_retrievals == 0);
+  CHECK(result.n_left == 3);
+
+  // a legal move that leaves 1 under 2
+  move_t path[] = {{3, 1, 2}};
+  result = verify(inst, path, 1);
+  CHECK(result.status == VERIFY_UNFINISHED);
+  CHECK(result.n_relocations == 1 && result.n_left == 3);
+  CHECK(ucrp_verify(inst, NULL, 0, NULL) == UCRP_VERIFY_UNFINISHED);
+  close_reader(reader);
+}
+
+static void test_batch(void) {
+  FILE *instances = tmpfile();
+  FILE *solutions = tmpfile();
+  FILE *out = tmpfile();
+  CHECK(instances != NULL && solutions != NULL && out != NULL);
+  for (int k = 0; k < 3; k++) {
+    fputs(text, instances);
+  }
+  fputs("[(2: 0 -> 2)]\n[]\n[(3: 1 -> 0)]\n", solutions);
+  rewind(instances);
+  rewind(solutions);
+  CHECK(ucrp_verify_batch(instances, solutions, out, NULL) == 2);
+
+  char lines[3][64];
+  rewind(out);
+  for (int k = 0; k < 3; k++) {
+    CHECK(fgets(lines[k], sizeof(lines[k]), out) != NULL);
+  }
+  CHECK(strcmp(lines[0], "0 valid 1 3\n") == 0);
+  CHECK(strcmp(lines[1], "1 unfinished 0 0\n") == 0);
+  CHECK(strcmp(lines[2], "2 illegal 0 0\n") == 0);
+
+  // one solution short
+  FILE *fewer = tmpfile();
+  CHECK(fewer != NULL);
+  fputs("[(2: 0 -> 2)]\n[]\n", fewer);
+  rewind(instances);
+  rewind(fewer);
+  CHECK(ucrp_verify_batch(instances, fewer, out, NULL) == -1);
+
+  fclose(instances);
+  fclose(solutions);
+  fclose(fewer);
+  fclose(out);
+}
+
+int main(void) {
+  test_valid();
+  test_illegal();
+  test_unfinished();
+  test_batch();
+  return EXIT_SUCCESS;
+}